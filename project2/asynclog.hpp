@@ -0,0 +1,274 @@
+//
+//  asynclog.hpp
+//  project2
+//
+//  Debug printing that stays off the render thread.  logPrint() does not
+//    format anything: it claims a slot in a fixed ring of binary records,
+//    stores the format string's address (the record's format id, so it
+//    must be a string literal) and the raw arguments, and returns.  A
+//    thread of its own formats the records in order and writes them out,
+//    a batch at a time.  Any thread may log; claiming a slot is one
+//    compare-and-swap, and nobody ever waits on a lock.  When the ring is
+//    full the record is dropped and counted, and the log says how many
+//    went missing, rather than the caller waiting for room.
+//
+
+#ifndef asynclog_hpp
+#define asynclog_hpp
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <atomic>
+#include <chrono>
+#include <thread>
+#include <type_traits>
+
+
+// records in the ring, a power of two:
+const unsigned long LOG_RING_RECORDS = 4096;
+
+// most arguments one record can carry:
+const int LOG_MAX_ARGS = 8;
+
+// how long the log thread sleeps when there is nothing to write, in ms:
+const int LOG_IDLE_MS = 2;
+
+// bytes formatted before they are written out:
+const int LOG_BATCH_BYTES = 8192;
+
+
+enum LogArgType : unsigned char {
+    LOG_INT,
+    LOG_DOUBLE,
+    LOG_STRING          // must outlive the record, so a literal or a table entry
+};
+
+struct LogArg
+{
+    LogArgType  type;
+    union {
+        long        i;
+        double      d;
+        const char *s;
+    };
+};
+
+struct LogRecord
+{
+    std::atomic<unsigned long> sequence;    // == its position + 1 once written, + LOG_RING_RECORDS once free again
+    const char *format;
+    long        ns;                         // when it was logged, since logStart()
+    int         nargs;
+    LogArg      args[LOG_MAX_ARGS];
+};
+
+struct AsyncLog
+{
+    LogRecord   records[LOG_RING_RECORDS];
+    std::atomic<unsigned long> head;        // next position to claim
+    unsigned long tail;                     // next position to write, the log thread's own
+    std::atomic<long> dropped;              // records that found the ring full
+    long        reported;                   // ... and how many of those the log has owned up to
+    std::atomic<bool> running;
+    std::thread *thread;
+    FILE       *out;
+    std::chrono::steady_clock::time_point start;
+};
+
+AsyncLog DebugLog;
+
+
+template <typename T>
+static LogArg logArg(T v) {
+    LogArg a;
+    if constexpr (std::is_integral_v<T> || std::is_enum_v<T>) {
+        a.type = LOG_INT;
+        a.i = (long)v;
+    } else if constexpr (std::is_floating_point_v<T>) {
+        a.type = LOG_DOUBLE;
+        a.d = (double)v;
+    } else {
+        static_assert(std::is_convertible_v<T, const char *>, "logPrint() takes numbers and strings");
+        a.type = LOG_STRING;
+        a.s = v;
+    }
+    return a;
+}
+
+static void logEncode(LogArg *) {
+}
+
+template <typename T, typename... Rest>
+static void logEncode(LogArg *a, T first, Rest... rest) {
+    *a = logArg(first);
+    logEncode(a + 1, rest...);
+}
+
+
+// printf() one record into buf, a conversion at a time, each with its own argument:
+
+static int logFormat(LogRecord const &r, char *buf, int size) {
+    int n = 0, arg = 0;
+    for (const char *f = r.format; *f != '\0' && n < size - 1; ) {
+        if (*f != '%' || f[1] == '%') {
+            buf[n++] = *f;
+            f += *f == '%' ? 2 : 1;
+            continue;
+        }
+
+        // the flags, width and precision as given, the length left for us to choose:
+        char spec[32] = "%";
+        int len = 1;
+        for (f++; *f != '\0' && strchr("-+ #0123456789.", *f) != NULL && len < 24; f++)
+            spec[len++] = *f;
+        while (*f != '\0' && strchr("hlLqjzt", *f) != NULL)
+            f++;
+        char conversion = *f != '\0' ? *f++ : 's';
+
+        LogArg a = arg < r.nargs ? r.args[arg++] : logArg("?");
+        if (a.type == LOG_STRING || conversion == 's' || conversion == 'p') {
+            strcpy(spec + len, "s");
+            n += snprintf(buf + n, size - n, spec, a.type == LOG_STRING ? a.s : "?");
+        } else if (strchr("fFeEgGaA", conversion) != NULL) {
+            spec[len++] = conversion;
+            spec[len] = '\0';
+            n += snprintf(buf + n, size - n, spec, a.type == LOG_DOUBLE ? a.d : (double)a.i);
+        } else if (conversion == 'c') {
+            strcpy(spec + len, "c");
+            n += snprintf(buf + n, size - n, spec, (int)a.i);
+        } else {
+            spec[len++] = 'l';
+            spec[len++] = conversion;
+            spec[len] = '\0';
+            n += snprintf(buf + n, size - n, spec, a.type == LOG_INT ? a.i : (long)a.d);
+        }
+    }
+    n = n < size ? n : size - 1;
+    buf[n] = '\0';
+    return n;
+}
+
+
+// write out whatever has been logged; returns how many records that was:
+
+static int logDrain(AsyncLog &log) {
+    char batch[LOG_BATCH_BYTES];
+    int used = 0, records = 0;
+    for (;;) {
+        LogRecord &r = log.records[log.tail % LOG_RING_RECORDS];
+        if (r.sequence.load(std::memory_order_acquire) != log.tail + 1)
+            break;
+        char line[512];
+        int n = snprintf(line, sizeof line, "%9.3f ", r.ns * 1e-9);
+        n += logFormat(r, line + n, sizeof line - n);
+        r.sequence.store(log.tail + LOG_RING_RECORDS, std::memory_order_release);
+        log.tail++;
+        records++;
+
+        if (used + n > LOG_BATCH_BYTES) {
+            fwrite(batch, 1, used, log.out);
+            used = 0;
+        }
+        memcpy(batch + used, line, n);
+        used += n;
+    }
+
+    if (used > 0)
+        fwrite(batch, 1, used, log.out);
+    long dropped = log.dropped.load(std::memory_order_relaxed);
+    if (dropped > log.reported) {
+        fprintf(log.out, "Log: %ld records dropped, the ring was full\n", dropped - log.reported);
+        log.reported = dropped;
+    }
+    fflush(log.out);
+    return records;
+}
+
+static void logThread(AsyncLog *log) {
+    while (log->running.load(std::memory_order_acquire))
+        if (logDrain(*log) == 0)
+            std::this_thread::sleep_for(std::chrono::milliseconds(LOG_IDLE_MS));
+    logDrain(*log);
+}
+
+
+// write out what is left, and stop the thread:
+void logStop() {
+    AsyncLog &log = DebugLog;
+    if (log.thread == NULL)
+        return;
+    log.running.store(false, std::memory_order_release);
+    log.thread->join();
+    delete log.thread;
+    log.thread = NULL;
+}
+
+void logStart(FILE *out) {
+    AsyncLog &log = DebugLog;
+    if (log.thread != NULL)
+        return;
+    for (unsigned long i = 0; i < LOG_RING_RECORDS; i++)
+        log.records[i].sequence.store(i, std::memory_order_relaxed);
+    log.head.store(0, std::memory_order_relaxed);
+    log.tail = 0;
+    log.dropped.store(0, std::memory_order_relaxed);
+    log.reported = 0;
+    log.out = out;
+    log.start = std::chrono::steady_clock::now();
+    log.running.store(true, std::memory_order_release);
+    log.thread = new std::thread(logThread, &log);
+    atexit(logStop);        // so nothing logged just before exit() is lost
+}
+
+
+// printf()-like, but only numbers and long-lived strings, and it returns
+//    right away; false if the record had to be dropped
+
+template <typename... Args>
+bool logPrint(const char *format, Args... args) {
+    static_assert(sizeof...(Args) <= LOG_MAX_ARGS, "too many arguments for one log record");
+    AsyncLog &log = DebugLog;
+    auto now = std::chrono::steady_clock::now();
+
+    if (log.thread == NULL) {
+        // not started (or already stopped): the old way
+        LogRecord r;
+        r.format = format;
+        r.ns = 0;
+        r.nargs = sizeof...(Args);
+        logEncode(r.args, args...);
+        char line[512];
+        logFormat(r, line, sizeof line);
+        fputs(line, stderr);
+        return true;
+    }
+
+    unsigned long pos = log.head.load(std::memory_order_relaxed);
+    LogRecord *r;
+    for (;;) {
+        r = &log.records[pos % LOG_RING_RECORDS];
+        long diff = (long)(r->sequence.load(std::memory_order_acquire) - pos);
+        if (diff == 0) {
+            if (log.head.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed))
+                break;
+        } else if (diff < 0) {
+            // the log thread has not freed this slot yet: the ring is full
+            log.dropped.fetch_add(1, std::memory_order_relaxed);
+            return false;
+        } else {
+            pos = log.head.load(std::memory_order_relaxed);
+        }
+    }
+
+    r->format = format;
+    r->ns = std::chrono::duration_cast<std::chrono::nanoseconds>(now - log.start).count();
+    r->nargs = sizeof...(Args);
+    logEncode(r->args, args...);
+    r->sequence.store(pos + 1, std::memory_order_release);
+    return true;
+}
+
+
+#endif /* asynclog_hpp */
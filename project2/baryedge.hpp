@@ -0,0 +1,234 @@
+//
+//  baryedge.hpp
+//  project2
+//
+//  Solid hull and wireframe in a single pass: every triangle carries
+//    barycentric coordinates, and the fragment shader darkens the pixels
+//    near an edge using screen-space derivatives.  Edges that are not
+//    real mesh edges get masked off by pushing their coordinate away from 0.
+//    Edges in the list that are not the side of any triangle cannot be
+//    drawn that way, so they follow as ordinary GL_LINES.
+//
+
+#ifndef baryedge_hpp
+#define baryedge_hpp
+
+#include <math.h>
+#include <stdio.h>
+
+#include <unordered_set>
+#include <vector>
+
+#include "glproc.hpp"
+#include "mirror.hpp"
+
+
+// width of the drawn edges in pixels:
+const float BARY_EDGE_WIDTH = 1.2f;
+
+
+struct BaryVertex
+{
+    GLfloat x, y, z;
+    GLubyte bary[3];        // 1 at this corner, 0 at the others, +1 where the opposite edge is hidden
+    GLubyte shade;          // fake "lighting" from above, 0-255
+};
+
+
+struct BaryMesh
+{
+    std::vector<BaryVertex> verts;      // not indexed: 3 per triangle
+    int halfFirst, halfCount;           // drawn twice: as-is and reflected
+    int singleFirst, singleCount;
+    int halfClosed, singleClosed;       // vertices of each that come first from closed components
+    int hiddenEdges;                    // triangle sides that are not in the edge list
+    std::vector<GLfloat> looseLines;    // edges that are no triangle's side, GL_LINES of xyz
+
+    GLuint  vbo;
+    GLuint  program;
+    GLint   uWidth;
+};
+
+
+struct BaryEdgeKey
+{
+    MirrorPointKey a, b;
+    bool operator==(BaryEdgeKey const &o) const { return a == o.a && b == o.b; }
+};
+
+struct BaryEdgeHash
+{
+    size_t operator()(BaryEdgeKey const &k) const {
+        MirrorPointHash h;
+        return h(k.a) * 31u + h(k.b);
+    }
+};
+
+static BaryEdgeKey baryEdgeKey(struct point const &p, struct point const &q) {
+    MirrorPointKey a = mirrorKey(p), b = mirrorKey(q);
+    if (a.x > b.x || (a.x == b.x && (a.y > b.y || (a.y == b.y && a.z > b.z))))
+        std::swap(a, b);
+    return BaryEdgeKey{ a, b };
+}
+
+
+// edges are matched by position, so the mirror mesh and the original
+//    edge list do not have to share vertex numbers
+
+BaryMesh buildBaryMesh(MirrorMesh const &mm, struct point const *points, struct edge const *edges, int nedges) {
+    BaryMesh bm = {};
+
+    std::unordered_set<BaryEdgeKey, BaryEdgeHash> edgeSet, sides;
+    edgeSet.reserve(nedges);
+    for (int i = 0; i < nedges; i++)
+        edgeSet.insert(baryEdgeKey(points[edges[i].p0], points[edges[i].p1]));
+
+    auto addTris = [&](std::vector<struct tri> const &tris) {
+        for (struct tri const &t : tris) {
+            struct point const *p[3] = { &mm.points[t.p0], &mm.points[t.p1], &mm.points[t.p2] };
+
+            float u[3] = { p[1]->x-p[0]->x, p[1]->y-p[0]->y, p[1]->z-p[0]->z };
+            float v[3] = { p[2]->x-p[0]->x, p[2]->y-p[0]->y, p[2]->z-p[0]->z };
+            float n[3] = { u[1]*v[2]-u[2]*v[1], u[2]*v[0]-u[0]*v[2], u[0]*v[1]-u[1]*v[0] };
+            float len = sqrtf(n[0]*n[0] + n[1]*n[1] + n[2]*n[2]);
+            float shade = len > 0.f ? fminf(fabsf(n[1]) / len + .25f, 1.f) : 1.f;
+
+            // the side opposite corner k is hidden if it is not a real edge:
+            GLubyte hidden[3];
+            for (int k = 0; k < 3; k++) {
+                BaryEdgeKey side = baryEdgeKey(*p[(k+1)%3], *p[(k+2)%3]);
+                hidden[k] = edgeSet.count(side) == 0;
+                bm.hiddenEdges += hidden[k];
+                sides.insert(side);
+            }
+
+            for (int c = 0; c < 3; c++) {
+                BaryVertex bv;
+                bv.x = p[c]->x;
+                bv.y = p[c]->y;
+                bv.z = p[c]->z;
+                for (int k = 0; k < 3; k++)
+                    bv.bary[k] = (GLubyte)((k == c) + hidden[k]);
+                bv.shade = (GLubyte)lroundf(shade * 255.f);
+                bm.verts.push_back(bv);
+            }
+        }
+    };
+
+    bm.halfFirst = (int)bm.verts.size();
+    addTris(mm.halfTris);
+    bm.halfCount = (int)bm.verts.size() - bm.halfFirst;
+    bm.singleFirst = (int)bm.verts.size();
+    addTris(mm.singleTris);
+    bm.singleCount = (int)bm.verts.size() - bm.singleFirst;
+    bm.halfClosed = 3 * mm.halfClosed;
+    bm.singleClosed = 3 * mm.singleClosed;
+
+    // the sides of the reflected half are the reflections of these, so
+    //    an edge on the other side of the mirror is matched by its twin:
+    for (int i = 0; i < nedges; i++) {
+        struct point p = points[edges[i].p0], q = points[edges[i].p1];
+        if (sides.count(baryEdgeKey(p, q)) != 0)
+            continue;
+        if (mm.axis >= 0 &&
+            sides.count(baryEdgeKey(mirrorReflect(p, mm.axis, mm.center), mirrorReflect(q, mm.axis, mm.center))) != 0)
+            continue;
+        bm.looseLines.insert(bm.looseLines.end(), { p.x, p.y, p.z, q.x, q.y, q.z });
+    }
+
+    fprintf(stderr, "Barycentric edges: %zu vertices x %zu bytes, %d hidden triangle sides, %zu loose edges\n",
+            bm.verts.size(), sizeof(BaryVertex), bm.hiddenEdges, bm.looseLines.size() / 6);
+    return bm;
+}
+
+
+static char const *BARY_VERTEX_SHADER =
+    "#version 120\n"
+    "attribute vec3 aPosition;\n"
+    "attribute vec3 aBary;\n"
+    "attribute float aShade;\n"
+    "varying vec3 vBary;\n"
+    "varying float vShade;\n"
+    "void main() {\n"
+    "    gl_Position = gl_ModelViewProjectionMatrix * vec4(aPosition, 1.);\n"
+    "    vBary = aBary;\n"
+    "    vShade = aShade;\n"
+    "}\n";
+
+static char const *BARY_FRAGMENT_SHADER =
+    "#version 120\n"
+    "uniform float uWidth;\n"
+    "varying vec3 vBary;\n"
+    "varying float vShade;\n"
+    "void main() {\n"
+    "    vec3 a = smoothstep(vec3(0.), fwidth(vBary) * uWidth, vBary);\n"
+    "    float edge = 1. - min(min(a.x, a.y), a.z);\n"
+    "    gl_FragColor = mix(vec4(0., vShade, 0., 1.), vec4(1., 0., 0., 1.), edge);\n"
+    "}\n";
+
+
+bool uploadBaryMesh(BaryMesh &bm) {
+    if (GL.GenBuffers == NULL || GL.CreateProgram == NULL || GL.VertexAttribPointer == NULL)
+        return false;
+
+    char const *attribs[] = { "aPosition", "aBary", "aShade", NULL };
+    bm.program = createProgram(BARY_VERTEX_SHADER, BARY_FRAGMENT_SHADER, attribs);
+    if (bm.program == 0)
+        return false;
+    bm.uWidth = GL.GetUniformLocation(bm.program, "uWidth");
+
+    GL.GenBuffers(1, &bm.vbo);
+    GL.BindBuffer(GL_ARRAY_BUFFER, bm.vbo);
+    GL.BufferData(GL_ARRAY_BUFFER, bm.verts.size()*sizeof(BaryVertex), bm.verts.data(), GL_STATIC_DRAW);
+    GL.BindBuffer(GL_ARRAY_BUFFER, 0);
+    return true;
+}
+
+
+// the closed components' triangles and the loose edges, or the other triangles:
+
+void drawBaryMesh(BaryMesh const &bm, MirrorMesh const &mm, bool closed) {
+    int half = closed ? bm.halfFirst : bm.halfFirst + bm.halfClosed;
+    int halfCount = closed ? bm.halfClosed : bm.halfCount - bm.halfClosed;
+    int single = closed ? bm.singleFirst : bm.singleFirst + bm.singleClosed;
+    int singleCount = closed ? bm.singleClosed : bm.singleCount - bm.singleClosed;
+
+    GL.UseProgram(bm.program);
+    GL.Uniform1f(bm.uWidth, BARY_EDGE_WIDTH);
+
+    GL.BindBuffer(GL_ARRAY_BUFFER, bm.vbo);
+    GL.EnableVertexAttribArray(0);
+    GL.EnableVertexAttribArray(1);
+    GL.EnableVertexAttribArray(2);
+    GL.VertexAttribPointer(0, 3, GL_FLOAT,         GL_FALSE, sizeof(BaryVertex), (GLvoid const *)0);
+    GL.VertexAttribPointer(1, 3, GL_UNSIGNED_BYTE, GL_FALSE, sizeof(BaryVertex), (GLvoid const *)(3*sizeof(GLfloat)));
+    GL.VertexAttribPointer(2, 1, GL_UNSIGNED_BYTE, GL_TRUE,  sizeof(BaryVertex), (GLvoid const *)(3*sizeof(GLfloat) + 3));
+
+    glDrawArrays(GL_TRIANGLES, single, singleCount);
+    glDrawArrays(GL_TRIANGLES, half, halfCount);
+    if (mm.axis >= 0) {
+        glPushMatrix();
+        applyMirrorReflection(mm);
+        glFrontFace(GL_CW);
+        glDrawArrays(GL_TRIANGLES, half, halfCount);
+        glFrontFace(GL_CCW);
+        glPopMatrix();
+    }
+
+    GL.DisableVertexAttribArray(0);
+    GL.DisableVertexAttribArray(1);
+    GL.DisableVertexAttribArray(2);
+    GL.BindBuffer(GL_ARRAY_BUFFER, 0);
+    GL.UseProgram(0);
+
+    if (closed && !bm.looseLines.empty()) {
+        glColor3f(1., 0., 0.);
+        glEnableClientState(GL_VERTEX_ARRAY);
+        glVertexPointer(3, GL_FLOAT, 0, bm.looseLines.data());
+        glDrawArrays(GL_LINES, 0, (GLsizei)(bm.looseLines.size() / 3));
+        glDisableClientState(GL_VERTEX_ARRAY);
+    }
+}
+
+
+#endif /* baryedge_hpp */
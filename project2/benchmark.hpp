@@ -0,0 +1,96 @@
+//
+//  benchmark.hpp
+//  project2
+//
+//  Times a run of frames on the CPU (wall clock, after a glFinish) and,
+//    when the context has the queries, counts the samples that passed the
+//    depth test and the GPU time.
+//
+
+#ifndef benchmark_hpp
+#define benchmark_hpp
+
+#include <stdio.h>
+
+#include <chrono>
+
+#include "glproc.hpp"
+
+
+// frames drawn per benchmark case:
+const int BENCHMARK_FRAMES = 100;
+
+
+struct BenchmarkResult
+{
+    double  cpuMs;          // wall-clock ms per frame
+    double  gpuMs;          // GPU ms per frame, or -1 if there is no timer query
+    double  samples;        // samples passed per frame, or -1 if there is no occlusion query
+};
+
+
+// countSamples has to be false if the frames issue GL_SAMPLES_PASSED queries
+//    of their own, since those cannot nest
+
+BenchmarkResult runBenchmark(void (*drawFrame)(), int frames, bool countSamples) {
+    BenchmarkResult r = { 0., -1., -1. };
+
+    bool haveSamples = countSamples && GL.GenQueries != NULL && glVersionAtLeast(1, 5);
+    bool haveTime = haveSamples && GL.GetQueryObjectui64v != NULL &&
+                    (glVersionAtLeast(3, 3) || hasGLExtension("GL_ARB_timer_query") ||
+                     hasGLExtension("GL_EXT_timer_query"));
+
+    GLuint queries[2] = { 0, 0 };
+    if (haveSamples) {
+        GL.GenQueries(2, queries);
+        GL.BeginQuery(GL_SAMPLES_PASSED, queries[0]);
+        if (haveTime)
+            GL.BeginQuery(GL_TIME_ELAPSED, queries[1]);
+    }
+
+    glFinish();
+    auto start = std::chrono::steady_clock::now();
+    for (int i = 0; i < frames; i++)
+        drawFrame();
+    if (haveSamples) {
+        GL.EndQuery(GL_SAMPLES_PASSED);
+        if (haveTime)
+            GL.EndQuery(GL_TIME_ELAPSED);
+    }
+    glFinish();
+    auto stop = std::chrono::steady_clock::now();
+
+    r.cpuMs = std::chrono::duration<double, std::milli>(stop - start).count() / frames;
+    if (haveSamples) {
+        GLuint samples;
+        GL.GetQueryObjectuiv(queries[0], GL_QUERY_RESULT, &samples);
+        r.samples = (double)samples / frames;
+        if (haveTime) {
+            GLuint64 ns;
+            GL.GetQueryObjectui64v(queries[1], GL_QUERY_RESULT, &ns);
+            r.gpuMs = ns / 1.e6 / frames;
+        }
+        GL.DeleteQueries(2, queries);
+    }
+    return r;
+}
+
+
+void printBenchmarkHeader(char const *what) {
+    fprintf(stderr, "%-24s %10s %10s %14s\n", what, "cpu ms", "gpu ms", "samples");
+}
+
+void printBenchmarkResult(char const *name, BenchmarkResult const &r) {
+    fprintf(stderr, "%-24s %10.3f ", name, r.cpuMs);
+    if (r.gpuMs >= 0.)
+        fprintf(stderr, "%10.3f ", r.gpuMs);
+    else
+        fprintf(stderr, "%10s ", "-");
+    if (r.samples >= 0.)
+        fprintf(stderr, "%14.0f\n", r.samples);
+    else
+        fprintf(stderr, "%14s\n", "-");
+}
+
+
+#endif /* benchmark_hpp */
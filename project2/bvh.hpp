@@ -0,0 +1,477 @@
+//
+//  bvh.hpp
+//  project2
+//
+//  Bounding-volume hierarchy for ray queries (mouse picking):
+//    built top-down with the binned surface-area heuristic (big subtrees
+//    are built as jobs of their own), then collapsed into 4-wide nodes
+//    whose child boxes are stored one component per array so one ray is
+//    tested against all four at once.
+//    Primitives are triangles, discs (the spinning propellers), and boxes
+//    (whole aircraft, for the fleet's top-level tree in tlas.hpp).
+//
+
+#ifndef bvh_hpp
+#define bvh_hpp
+
+#include <float.h>
+#include <limits.h>
+#include <math.h>
+#include <stdio.h>
+
+#include <algorithm>
+#include <vector>
+
+#include "jobs.hpp"
+
+
+// primitives per leaf before we stop splitting:
+const int BVH_LEAF_SIZE = 4;
+
+// never make a leaf bigger than this, even if SAH says splitting isn't worth it:
+const int BVH_MAX_LEAF_SIZE = 16;
+
+// number of SAH bins per axis:
+const int BVH_BINS = 16;
+
+// subtrees with more primitives than this get built as a job of their own:
+const int BVH_PARALLEL_THRESHOLD = 1024;
+
+// traversal stack entries kept on the C stack; deeper trees get a heap one:
+const int BVH_TRAVERSAL_STACK = 64;
+
+
+enum BVHPrimType {
+    BVH_TRIANGLE,
+    BVH_DISC,
+    BVH_BOX
+};
+
+
+struct BVHPrimitive
+{
+    int     type;           // BVH_TRIANGLE, BVH_DISC or BVH_BOX
+    int     id;             // caller's number for this primitive
+    float   a[3], b[3], c[3];   // triangle: the corners; disc: center, unit normal, c[0] = radius;
+                                //    box: a = low corner, b = high corner (hit by the caller)
+};
+
+
+struct BVHBounds
+{
+    float lo[3], hi[3];
+
+    void reset() {
+        lo[0] = lo[1] = lo[2] = FLT_MAX;
+        hi[0] = hi[1] = hi[2] = -FLT_MAX;
+    }
+    void grow(float const p[3]) {
+        for (int k = 0; k < 3; k++) {
+            lo[k] = fminf(lo[k], p[k]);
+            hi[k] = fmaxf(hi[k], p[k]);
+        }
+    }
+    void grow(BVHBounds const &b) {
+        for (int k = 0; k < 3; k++) {
+            lo[k] = fminf(lo[k], b.lo[k]);
+            hi[k] = fmaxf(hi[k], b.hi[k]);
+        }
+    }
+    float area() const {
+        float d[3] = { hi[0]-lo[0], hi[1]-lo[1], hi[2]-lo[2] };
+        if (d[0] < 0.f || d[1] < 0.f || d[2] < 0.f)
+            return 0.f;
+        return 2.f * (d[0]*d[1] + d[1]*d[2] + d[2]*d[0]);
+    }
+};
+
+
+// four children per node; a child is an inner node (>= 0), a leaf (< 0,
+//    primitives -child-1 .. -child-1+count-1), or BVH_EMPTY
+
+const int BVH_EMPTY = INT_MIN;
+
+struct BVH4Node
+{
+    float minX[4], minY[4], minZ[4];
+    float maxX[4], maxY[4], maxZ[4];
+    int   child[4];
+    int   count[4];
+};
+
+
+struct BVH
+{
+    std::vector<BVHPrimitive> prims;    // in leaf order
+    std::vector<BVH4Node> nodes;        // nodes[0] is the root
+    BVHBounds bounds;
+    int depth;                          // levels of 4-wide nodes, 0 if there are none
+};
+
+
+struct BVHHit
+{
+    float   t;              // distance along the ray, FLT_MAX if nothing was hit
+    int     type;
+    int     id;
+};
+
+
+// MARK: - building
+
+static BVHBounds bvhPrimBounds(BVHPrimitive const &p) {
+    BVHBounds b;
+    b.reset();
+    if (p.type == BVH_TRIANGLE) {
+        b.grow(p.a);
+        b.grow(p.b);
+        b.grow(p.c);
+    } else if (p.type == BVH_BOX) {
+        b.grow(p.a);
+        b.grow(p.b);
+    } else {
+        // a disc of radius r with normal n reaches r*sqrt(1-n[k]^2) along axis k:
+        for (int k = 0; k < 3; k++) {
+            float e = p.c[0] * sqrtf(fmaxf(0.f, 1.f - p.b[k]*p.b[k]));
+            b.lo[k] = p.a[k] - e;
+            b.hi[k] = p.a[k] + e;
+        }
+    }
+    return b;
+}
+
+
+struct BVHBuildNode
+{
+    BVHBounds bounds;
+    BVHBuildNode *child[2];
+    int first, count;       // leaves only
+};
+
+
+struct BVHBuildPrim
+{
+    BVHBounds bounds;
+    float centroid[3];
+    int index;              // into the caller's primitive list
+};
+
+
+static BVHBuildNode *bvhBuildRecursive(BVHBuildPrim *prims, int first, int count) {
+    BVHBuildNode *node = new BVHBuildNode;
+    node->child[0] = node->child[1] = NULL;
+    node->first = first;
+    node->count = count;
+
+    BVHBounds cb;
+    node->bounds.reset();
+    cb.reset();
+    for (int i = first; i < first + count; i++) {
+        node->bounds.grow(prims[i].bounds);
+        cb.grow(prims[i].centroid);
+    }
+    if (count <= BVH_LEAF_SIZE)
+        return node;
+
+    // binned SAH: for each axis, sweep the bins from both ends
+
+    float bestCost = FLT_MAX;
+    int bestAxis = -1, bestSplit = 0;
+    for (int axis = 0; axis < 3; axis++) {
+        float extent = cb.hi[axis] - cb.lo[axis];
+        if (extent <= 0.f)
+            continue;
+
+        BVHBounds binBounds[BVH_BINS];
+        int binCount[BVH_BINS] = { 0 };
+        for (int b = 0; b < BVH_BINS; b++)
+            binBounds[b].reset();
+        for (int i = first; i < first + count; i++) {
+            int b = std::min(BVH_BINS - 1, (int)(BVH_BINS * (prims[i].centroid[axis] - cb.lo[axis]) / extent));
+            binCount[b]++;
+            binBounds[b].grow(prims[i].bounds);
+        }
+
+        float rightArea[BVH_BINS];
+        int rightCount[BVH_BINS];
+        BVHBounds acc;
+        acc.reset();
+        int n = 0;
+        for (int b = BVH_BINS - 1; b > 0; b--) {
+            acc.grow(binBounds[b]);
+            n += binCount[b];
+            rightArea[b] = acc.area();
+            rightCount[b] = n;
+        }
+
+        acc.reset();
+        n = 0;
+        for (int b = 0; b < BVH_BINS - 1; b++) {
+            acc.grow(binBounds[b]);
+            n += binCount[b];
+            float cost = n * acc.area() + rightCount[b + 1] * rightArea[b + 1];
+            if (n > 0 && rightCount[b + 1] > 0 && cost < bestCost) {
+                bestCost = cost;
+                bestAxis = axis;
+                bestSplit = b;
+            }
+        }
+    }
+
+    float leafCost = count * node->bounds.area();
+    if (bestAxis < 0 || (bestCost >= leafCost && count <= BVH_MAX_LEAF_SIZE))
+        return node;
+
+    float extent = cb.hi[bestAxis] - cb.lo[bestAxis];
+    BVHBuildPrim *mid = std::partition(prims + first, prims + first + count, [&](BVHBuildPrim const &p) {
+        int b = std::min(BVH_BINS - 1, (int)(BVH_BINS * (p.centroid[bestAxis] - cb.lo[bestAxis]) / extent));
+        return b <= bestSplit;
+    });
+    int nleft = (int)(mid - (prims + first));
+
+    if (count > BVH_PARALLEL_THRESHOLD) {
+        JobCounter left;
+        auto buildLeft = [&]() { node->child[0] = bvhBuildRecursive(prims, first, nleft); };
+        jobRun(left, buildLeft);
+        node->child[1] = bvhBuildRecursive(prims, first + nleft, count - nleft);
+        jobWait(left);
+    } else {
+        node->child[0] = bvhBuildRecursive(prims, first, nleft);
+        node->child[1] = bvhBuildRecursive(prims, first + nleft, count - nleft);
+    }
+    node->count = 0;
+    return node;
+}
+
+
+// turn a binary node into a 4-wide one by opening up the biggest inner children:
+
+static int bvhCollapse(BVH &bvh, BVHBuildNode const *node, int depth) {
+    bvh.depth = std::max(bvh.depth, depth);
+    BVHBuildNode const *kids[4] = { node->child[0], node->child[1], NULL, NULL };
+    int nkids = 2;
+    while (nkids < 4) {
+        int open = -1;
+        float biggest = -1.f;
+        for (int i = 0; i < nkids; i++) {
+            if (kids[i]->child[0] != NULL && kids[i]->bounds.area() > biggest) {
+                biggest = kids[i]->bounds.area();
+                open = i;
+            }
+        }
+        if (open < 0)
+            break;
+        BVHBuildNode const *k = kids[open];
+        kids[open] = k->child[0];
+        kids[nkids++] = k->child[1];
+    }
+
+    int index = (int)bvh.nodes.size();
+    bvh.nodes.emplace_back();
+    for (int i = 0; i < 4; i++) {
+        float lo[3] = { FLT_MAX, FLT_MAX, FLT_MAX }, hi[3] = { -FLT_MAX, -FLT_MAX, -FLT_MAX };
+        int child = BVH_EMPTY, count = 0;
+        if (i < nkids && (kids[i]->child[0] != NULL || kids[i]->count > 0)) {
+            for (int k = 0; k < 3; k++) {
+                lo[k] = kids[i]->bounds.lo[k];
+                hi[k] = kids[i]->bounds.hi[k];
+            }
+            if (kids[i]->child[0] != NULL) {
+                child = bvhCollapse(bvh, kids[i], depth + 1);
+            } else {
+                child = -kids[i]->first - 1;
+                count = kids[i]->count;
+            }
+        }
+        BVH4Node &n = bvh.nodes[index];     // re-fetch: the recursion may have grown the vector
+        n.minX[i] = lo[0]; n.minY[i] = lo[1]; n.minZ[i] = lo[2];
+        n.maxX[i] = hi[0]; n.maxY[i] = hi[1]; n.maxZ[i] = hi[2];
+        n.child[i] = child;
+        n.count[i] = count;
+    }
+    return index;
+}
+
+
+static void bvhFree(BVHBuildNode *node) {
+    if (node == NULL)
+        return;
+    bvhFree(node->child[0]);
+    bvhFree(node->child[1]);
+    delete node;
+}
+
+
+BVH buildBVH(std::vector<BVHPrimitive> const &prims) {
+    BVH bvh;
+    bvh.bounds.reset();
+    bvh.depth = 0;
+    if (prims.empty())
+        return bvh;
+
+    std::vector<BVHBuildPrim> build(prims.size());
+    for (size_t i = 0; i < prims.size(); i++) {
+        build[i].bounds = bvhPrimBounds(prims[i]);
+        for (int k = 0; k < 3; k++)
+            build[i].centroid[k] = (build[i].bounds.lo[k] + build[i].bounds.hi[k]) / 2.f;
+        build[i].index = (int)i;
+    }
+
+    BVHBuildNode *root = bvhBuildRecursive(build.data(), 0, (int)build.size());
+    bvh.bounds = root->bounds;
+
+    bvh.prims.resize(prims.size());
+    for (size_t i = 0; i < prims.size(); i++)
+        bvh.prims[i] = prims[build[i].index];
+
+    // the root always becomes an inner node, even if it is a single leaf:
+    if (root->child[0] == NULL) {
+        BVHBuildNode *leaf = root;
+        root = new BVHBuildNode;
+        root->bounds = leaf->bounds;
+        root->child[0] = leaf;
+        root->child[1] = new BVHBuildNode{ BVHBounds{ { FLT_MAX, FLT_MAX, FLT_MAX }, { -FLT_MAX, -FLT_MAX, -FLT_MAX } },
+                                           { NULL, NULL }, 0, 0 };
+    }
+    bvhCollapse(bvh, root, 1);
+    bvhFree(root);
+    return bvh;
+}
+
+
+// MARK: - ray queries
+
+static bool bvhIntersectTriangle(BVHPrimitive const &p, float const o[3], float const d[3], float &t) {
+    // Moller-Trumbore:
+    float e1[3] = { p.b[0]-p.a[0], p.b[1]-p.a[1], p.b[2]-p.a[2] };
+    float e2[3] = { p.c[0]-p.a[0], p.c[1]-p.a[1], p.c[2]-p.a[2] };
+    float q[3] = { d[1]*e2[2]-d[2]*e2[1], d[2]*e2[0]-d[0]*e2[2], d[0]*e2[1]-d[1]*e2[0] };
+    float det = e1[0]*q[0] + e1[1]*q[1] + e1[2]*q[2];
+    if (fabsf(det) < 1.e-12f)
+        return false;
+    float inv = 1.f / det;
+    float s[3] = { o[0]-p.a[0], o[1]-p.a[1], o[2]-p.a[2] };
+    float u = (s[0]*q[0] + s[1]*q[1] + s[2]*q[2]) * inv;
+    if (u < 0.f || u > 1.f)
+        return false;
+    float r[3] = { s[1]*e1[2]-s[2]*e1[1], s[2]*e1[0]-s[0]*e1[2], s[0]*e1[1]-s[1]*e1[0] };
+    float v = (d[0]*r[0] + d[1]*r[1] + d[2]*r[2]) * inv;
+    if (v < 0.f || u + v > 1.f)
+        return false;
+    t = (e2[0]*r[0] + e2[1]*r[1] + e2[2]*r[2]) * inv;
+    return t > 0.f;
+}
+
+static bool bvhIntersectDisc(BVHPrimitive const &p, float const o[3], float const d[3], float &t) {
+    float dn = d[0]*p.b[0] + d[1]*p.b[1] + d[2]*p.b[2];
+    if (fabsf(dn) < 1.e-12f)
+        return false;
+    t = ((p.a[0]-o[0])*p.b[0] + (p.a[1]-o[1])*p.b[1] + (p.a[2]-o[2])*p.b[2]) / dn;
+    if (t <= 0.f)
+        return false;
+    float h[3] = { o[0] + t*d[0] - p.a[0], o[1] + t*d[1] - p.a[1], o[2] + t*d[2] - p.a[2] };
+    return h[0]*h[0] + h[1]*h[1] + h[2]*h[2] <= p.c[0]*p.c[0];
+}
+
+
+// plain compares (not fminf/fmaxf, which have to care about NaN) so these
+//    become single min/max instructions:
+static inline float bvhMin(float a, float b) { return a < b ? a : b; }
+static inline float bvhMax(float a, float b) { return a > b ? a : b; }
+
+
+// walk the tree front to back along origin + t*dir, calling
+//    leafHit(prim, hit) for every primitive in a leaf the ray reaches;
+//    leafHit shortens hit.t when it finds something closer
+
+template <typename LeafHit>
+void traverseBVH(BVH const &bvh, float const origin[3], float const dir[3], BVHHit &hit, LeafHit leafHit) {
+    if (bvh.nodes.empty())
+        return;
+
+    float inv[3];
+    for (int k = 0; k < 3; k++)
+        inv[k] = dir[k] != 0.f ? 1.f / dir[k] : copysignf(FLT_MAX, dir[k]);
+
+    // each node popped pushes at most 4 children, so 3 more per level:
+    int fixed[BVH_TRAVERSAL_STACK];
+    std::vector<int> grown;
+    int *stack = fixed;
+    if (3 * bvh.depth + 1 > BVH_TRAVERSAL_STACK) {
+        grown.resize(3 * bvh.depth + 1);
+        stack = grown.data();
+    }
+    int sp = 0;
+    stack[sp++] = 0;
+    while (sp > 0) {
+        BVH4Node const &n = bvh.nodes[stack[--sp]];
+
+        // slab test against all four children at once:
+        float tnear[4];
+        int hits[4];
+        for (int i = 0; i < 4; i++) {
+            float tx0 = (n.minX[i] - origin[0]) * inv[0], tx1 = (n.maxX[i] - origin[0]) * inv[0];
+            float ty0 = (n.minY[i] - origin[1]) * inv[1], ty1 = (n.maxY[i] - origin[1]) * inv[1];
+            float tz0 = (n.minZ[i] - origin[2]) * inv[2], tz1 = (n.maxZ[i] - origin[2]) * inv[2];
+            float t0 = bvhMax(bvhMax(bvhMin(tx0, tx1), bvhMin(ty0, ty1)), bvhMax(bvhMin(tz0, tz1), 0.f));
+            float t1 = bvhMin(bvhMin(bvhMax(tx0, tx1), bvhMax(ty0, ty1)), bvhMin(bvhMax(tz0, tz1), hit.t));
+            tnear[i] = t0;
+            hits[i] = t0 <= t1;
+        }
+
+        // the children we hit, farthest first, so the nearest comes off the stack first:
+        int order[4], nhit = 0;
+        for (int i = 0; i < 4; i++) {
+            if (!hits[i] || n.child[i] == BVH_EMPTY)
+                continue;
+            int j = nhit++;
+            for (; j > 0 && tnear[order[j - 1]] < tnear[i]; j--)
+                order[j] = order[j - 1];
+            order[j] = i;
+        }
+        for (int j = 0; j < nhit; j++) {
+            int i = order[j];
+            if (n.child[i] >= 0) {
+                stack[sp++] = n.child[i];
+                continue;
+            }
+            int first = -n.child[i] - 1;
+            for (int p = first; p < first + n.count[i]; p++)
+                leafHit(bvh.prims[p], hit);
+        }
+    }
+}
+
+
+// nearest triangle or disc along origin + t*dir, t > 0:
+
+BVHHit intersectBVH(BVH const &bvh, float const origin[3], float const dir[3]) {
+    BVHHit hit = { FLT_MAX, -1, -1 };
+    traverseBVH(bvh, origin, dir, hit, [&](BVHPrimitive const &prim, BVHHit &h) {
+        float t;
+        bool ok = false;
+        if (prim.type == BVH_TRIANGLE)
+            ok = bvhIntersectTriangle(prim, origin, dir, t);
+        else if (prim.type == BVH_DISC)
+            ok = bvhIntersectDisc(prim, origin, dir, t);
+        if (ok && t < h.t) {
+            h.t = t;
+            h.type = prim.type;
+            h.id = prim.id;
+        }
+    });
+    return hit;
+}
+
+
+void reportBVH(BVH const &bvh, double buildMs) {
+    int leaves = 0;
+    for (BVH4Node const &n : bvh.nodes)
+        for (int i = 0; i < 4; i++)
+            leaves += n.child[i] < 0 && n.child[i] != BVH_EMPTY;
+    fprintf(stderr, "BVH: %zu primitives, %zu 4-wide nodes, %d leaves, built in %.2f ms\n",
+            bvh.prims.size(), bvh.nodes.size(), leaves, buildMs);
+}
+
+
+#endif /* bvh_hpp */
@@ -0,0 +1,246 @@
+//
+//  corerenderer.hpp
+//  project2
+//
+//  The GL side of the core-profile backend.  Every mesh is a VAO with its
+//    own vertex buffer (and an index buffer if it has one), drawn by one
+//    program.  The projection and view matrices go in a uniform buffer
+//    once a frame; each draw sets only its model matrix.  A mesh carries
+//    per-vertex colours or takes the constant colour coreColor() set, the
+//    way glColor3f() works for glBegin/glEnd.  Geometry that changes every
+//    frame (the uniform block, streamed vertices and indices) is copied
+//    into this frame's region of a StreamRing.
+//
+
+#ifndef corerenderer_hpp
+#define corerenderer_hpp
+
+#include <stdio.h>
+#include <string.h>
+
+#include "glproc.hpp"
+#include "streamring.hpp"
+
+
+// the uniform buffer binding point for CoreFrameBlock:
+const GLuint CORE_FRAME_BINDING = 0;
+
+// vertex attribute locations:
+const GLuint CORE_POSITION = 0;
+const GLuint CORE_COLOR = 1;
+
+
+static char const *CORE_VERTEX_SHADER =
+    "#version 330 core\n"
+    "layout(std140) uniform Frame {\n"
+    "    mat4 projection;\n"
+    "    mat4 view;\n"
+    "};\n"
+    "uniform mat4 model;\n"
+    "in vec3 position;\n"
+    "in vec3 color;\n"
+    "out vec3 vColor;\n"
+    "void main() {\n"
+    "    vColor = color;\n"
+    "    gl_Position = projection * (view * (model * vec4(position, 1.)));\n"
+    "}\n";
+
+static char const *CORE_FRAGMENT_SHADER =
+    "#version 330 core\n"
+    "in vec3 vColor;\n"
+    "out vec4 fragColor;\n"
+    "void main() {\n"
+    "    fragColor = vec4(vColor, 1.);\n"
+    "}\n";
+
+
+// the Frame block, std140:
+struct CoreFrameBlock
+{
+    GLfloat projection[16];
+    GLfloat view[16];
+};
+
+struct CoreMesh
+{
+    GLuint  vao, vbo, ibo;          // ibo is 0 if the mesh is drawn in order
+    GLintptr indexOffset;           // where in ibo its indices start
+    GLenum  mode;
+    GLsizei count;                  // vertices, or indices if there is an ibo
+};
+
+struct CoreRenderer
+{
+    bool    ready;
+    GLuint  program;
+    GLint   uModel;
+    GLuint  frameBuffer;            // the uniform buffer, if the ring is full
+    CoreFrameBlock frame;           // what is in it this frame
+    CoreMesh stream;                // for what is made fresh each time it is drawn
+    StreamRing ring;                // ... and where it is put
+    GLint   uniformAlignment;       // for a uniform block in the ring
+    GLfloat lineWidthMax;           // wide lines are gone from forward-compatible contexts
+};
+
+
+bool initCoreRenderer(CoreRenderer &cr) {
+    cr = CoreRenderer{};
+    if (GL.GenVertexArrays == NULL || GL.BindBufferBase == NULL || GL.UniformMatrix4fv == NULL)
+        return false;
+
+    char const *attribs[] = { "position", "color", NULL };
+    cr.program = createProgram(CORE_VERTEX_SHADER, CORE_FRAGMENT_SHADER, attribs);
+    if (cr.program == 0)
+        return false;
+    cr.uModel = GL.GetUniformLocation(cr.program, "model");
+    GL.UniformBlockBinding(cr.program, GL.GetUniformBlockIndex(cr.program, "Frame"), CORE_FRAME_BINDING);
+
+    GL.GenBuffers(1, &cr.frameBuffer);
+    GL.BindBuffer(GL_UNIFORM_BUFFER, cr.frameBuffer);
+    GL.BufferData(GL_UNIFORM_BUFFER, sizeof(CoreFrameBlock), NULL, GL_DYNAMIC_DRAW);
+    GL.BindBuffer(GL_UNIFORM_BUFFER, 0);
+
+    GL.GenVertexArrays(1, &cr.stream.vao);
+    GL.GenBuffers(1, &cr.stream.vbo);
+    initStreamRing(cr.ring, STREAM_RING_REGION);
+    glGetIntegerv(GL_UNIFORM_BUFFER_OFFSET_ALIGNMENT, &cr.uniformAlignment);
+
+    GLint flags = 0;
+    glGetIntegerv(GL_CONTEXT_FLAGS, &flags);
+    cr.lineWidthMax = (flags & GL_CONTEXT_FLAG_FORWARD_COMPATIBLE_BIT) ? 1.f : 1000.f;
+    cr.ready = true;
+    return true;
+}
+
+
+// point the mesh's VAO at its vertex buffer, from offset on: xyz, or xyz + rgb if colored
+static void coreVertexLayout(bool colored, GLintptr offset) {
+    GLsizei stride = (colored ? 6 : 3) * sizeof(GLfloat);
+    GL.EnableVertexAttribArray(CORE_POSITION);
+    GL.VertexAttribPointer(CORE_POSITION, 3, GL_FLOAT, GL_FALSE, stride, (void *)offset);
+    if (colored) {
+        GL.EnableVertexAttribArray(CORE_COLOR);
+        GL.VertexAttribPointer(CORE_COLOR, 3, GL_FLOAT, GL_FALSE, stride, (void *)(offset + 3 * sizeof(GLfloat)));
+    } else {
+        GL.DisableVertexAttribArray(CORE_COLOR);
+    }
+}
+
+// n vertices, drawn in order unless coreMeshIndices() is called:
+CoreMesh coreMesh(GLenum mode, GLfloat const *vertices, int n, bool colored) {
+    CoreMesh m = {};
+    m.mode = mode;
+    m.count = n;
+    GL.GenVertexArrays(1, &m.vao);
+    GL.GenBuffers(1, &m.vbo);
+    GL.BindVertexArray(m.vao);
+    GL.BindBuffer(GL_ARRAY_BUFFER, m.vbo);
+    GL.BufferData(GL_ARRAY_BUFFER, (GLsizeiptr)n * (colored ? 6 : 3) * sizeof(GLfloat), vertices, GL_STATIC_DRAW);
+    coreVertexLayout(colored, 0);
+    GL.BindVertexArray(0);
+    GL.BindBuffer(GL_ARRAY_BUFFER, 0);
+    return m;
+}
+
+// draw the mesh by these indices from now on
+void coreMeshIndices(CoreMesh &m, GLuint const *indices, int n, GLenum usage) {
+    if (m.ibo == 0)
+        GL.GenBuffers(1, &m.ibo);
+    m.indexOffset = 0;
+    GL.BindVertexArray(m.vao);
+    GL.BindBuffer(GL_ELEMENT_ARRAY_BUFFER, m.ibo);
+    GL.BufferData(GL_ELEMENT_ARRAY_BUFFER, (GLsizeiptr)n * sizeof(GLuint), indices, usage);
+    GL.BindVertexArray(0);
+    m.count = n;
+}
+
+// start the scene: the matrices for this frame, and our program
+void coreBeginScene(CoreRenderer &cr, GLfloat const projection[16], GLfloat const view[16]) {
+    memcpy(cr.frame.projection, projection, sizeof(cr.frame.projection));
+    memcpy(cr.frame.view, view, sizeof(cr.frame.view));
+    GLintptr offset = -1;
+    if (cr.ring.ready) {
+        streamBeginFrame(cr.ring);
+        offset = streamUpload(cr.ring, &cr.frame, sizeof(CoreFrameBlock), cr.uniformAlignment);
+    }
+    if (offset >= 0) {
+        GL.BindBufferRange(GL_UNIFORM_BUFFER, CORE_FRAME_BINDING, cr.ring.buffer, offset, sizeof(CoreFrameBlock));
+    } else {
+        GL.BindBuffer(GL_UNIFORM_BUFFER, cr.frameBuffer);
+        GL.BufferSubData(GL_UNIFORM_BUFFER, 0, sizeof(CoreFrameBlock), &cr.frame);
+        GL.BindBuffer(GL_UNIFORM_BUFFER, 0);
+        GL.BindBufferBase(GL_UNIFORM_BUFFER, CORE_FRAME_BINDING, cr.frameBuffer);
+    }
+    GL.UseProgram(cr.program);
+}
+
+void coreEndScene(CoreRenderer &cr) {
+    GL.BindVertexArray(0);
+    GL.UseProgram(0);
+    if (cr.ring.ready)
+        streamEndFrame(cr.ring);
+}
+
+
+// coreMeshIndices(m, indices, n, GL_STREAM_DRAW), for indices that are
+//    only drawn this frame: they go in the ring if there is room
+void coreStreamIndices(CoreRenderer &cr, CoreMesh &m, GLuint const *indices, int n) {
+    GLintptr offset = cr.ring.ready ? streamUpload(cr.ring, indices, (GLsizeiptr)n * sizeof(GLuint), sizeof(GLuint)) : -1;
+    if (offset < 0) {
+        if (m.ibo == cr.ring.buffer)
+            m.ibo = 0;
+        coreMeshIndices(m, indices, n, GL_STREAM_DRAW);
+        return;
+    }
+    if (m.ibo != 0 && m.ibo != cr.ring.buffer)
+        GL.DeleteBuffers(1, &m.ibo);
+    m.ibo = cr.ring.buffer;
+    m.indexOffset = offset;
+    m.count = n;
+    GL.BindVertexArray(m.vao);
+    GL.BindBuffer(GL_ELEMENT_ARRAY_BUFFER, m.ibo);
+    GL.BindVertexArray(0);
+}
+
+
+// the colour of everything drawn without per-vertex colours:
+void coreColor(GLfloat r, GLfloat g, GLfloat b) {
+    GL.VertexAttrib3f(CORE_COLOR, r, g, b);
+}
+
+void coreLineWidth(CoreRenderer const &cr, GLfloat width) {
+    glLineWidth(width < cr.lineWidthMax ? width : cr.lineWidthMax);
+}
+
+
+void coreDraw(CoreRenderer &cr, CoreMesh const &m, GLfloat const model[16]) {
+    GL.UniformMatrix4fv(cr.uModel, 1, GL_FALSE, model);
+    GL.BindVertexArray(m.vao);
+    if (m.ibo != 0)
+        glDrawElements(m.mode, m.count, GL_UNSIGNED_INT, (void *)m.indexOffset);
+    else
+        glDrawArrays(m.mode, 0, m.count);
+}
+
+// n vertices that are only drawn this once:
+void coreDrawStream(CoreRenderer &cr, GLenum mode, GLfloat const *vertices, int n, bool colored,
+                    GLfloat const model[16]) {
+    GLsizeiptr size = (GLsizeiptr)n * (colored ? 6 : 3) * sizeof(GLfloat);
+    GLintptr offset = cr.ring.ready ? streamUpload(cr.ring, vertices, size, sizeof(GLfloat)) : -1;
+    GL.BindVertexArray(cr.stream.vao);
+    if (offset >= 0) {
+        GL.BindBuffer(GL_ARRAY_BUFFER, cr.ring.buffer);
+    } else {
+        GL.BindBuffer(GL_ARRAY_BUFFER, cr.stream.vbo);
+        GL.BufferData(GL_ARRAY_BUFFER, size, vertices, GL_STREAM_DRAW);
+        offset = 0;
+    }
+    coreVertexLayout(colored, offset);
+    GL.BindBuffer(GL_ARRAY_BUFFER, 0);
+    cr.stream.mode = mode;
+    cr.stream.count = n;
+    coreDraw(cr, cr.stream, model);
+}
+
+
+#endif /* corerenderer_hpp */
@@ -0,0 +1,185 @@
+//
+//  dynres.hpp
+//  project2
+//
+//  Dynamic resolution: the 3D scene is drawn into an offscreen target at
+//    some fraction of the window's size and stretched back up with a
+//    linear blit.  A PID controller on the measured frame time (GPU time
+//    from timer queries read back a few frames late, or the CPU frame
+//    interval without them) picks the fraction to hold a time budget.
+//
+
+#ifndef dynres_hpp
+#define dynres_hpp
+
+#include <math.h>
+#include <stdio.h>
+
+#include <algorithm>
+
+#include "glproc.hpp"
+
+
+// frame time to aim for, in ms:
+const float DYNRES_TARGET_MS = 16.6f;
+
+// the fraction of the window's width and height we can go between:
+const float DYNRES_MIN_SCALE = 0.25f;
+const float DYNRES_MAX_SCALE = 1.f;
+
+// PID gains; the error is (target - measured) / target:
+const float DYNRES_KP = 0.3f;
+const float DYNRES_KI = 1.5f;           // per second
+const float DYNRES_KD = 0.001f;         // seconds
+
+// how much of each new frame time goes into the smoothed one the controller sees:
+const float DYNRES_SMOOTHING = 0.2f;
+
+// timer queries in flight:
+const int DYNRES_QUERIES = 4;
+
+
+struct DynamicResolution
+{
+    bool    ready;
+    GLuint  fbo, color, depth;
+    int     size[2];                // what the textures were made for: the window's viewport
+    int     width, height;          // what this frame is drawn at
+    float   scale;
+    float   frameMs;                // the last measurement
+    float   smoothMs;               // ... low-pass filtered
+    float   integral, lastError;
+    float   lastTime;               // seconds, of the last update
+    bool    gpuTimed;
+    GLuint  queries[DYNRES_QUERIES];
+    bool    pending[DYNRES_QUERIES];
+    int     next;                   // the query to issue next; the oldest pending one when full
+};
+
+
+bool initDynamicResolution(DynamicResolution &dr) {
+    dr = DynamicResolution{};
+    dr.scale = DYNRES_MAX_SCALE;
+    dr.integral = DYNRES_MAX_SCALE / DYNRES_KI;     // so the controller starts at full size
+    if (GL.GenFramebuffers == NULL || GL.BlitFramebuffer == NULL ||
+        !(glVersionAtLeast(3, 0) || hasGLExtension("GL_ARB_framebuffer_object")))
+        return false;
+
+    GL.GenFramebuffers(1, &dr.fbo);
+    glGenTextures(1, &dr.color);
+    glGenTextures(1, &dr.depth);
+    dr.gpuTimed = GL.GenQueries != NULL && GL.GetQueryObjectui64v != NULL &&
+                  (glVersionAtLeast(3, 3) || hasGLExtension("GL_ARB_timer_query"));
+    if (dr.gpuTimed)
+        GL.GenQueries(DYNRES_QUERIES, dr.queries);
+    dr.ready = true;
+    return true;
+}
+
+
+static void dynresResize(DynamicResolution &dr, int width, int height) {
+    glBindTexture(GL_TEXTURE_2D, dr.color);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8, width, height, 0, GL_RGBA, GL_UNSIGNED_BYTE, NULL);
+    glBindTexture(GL_TEXTURE_2D, dr.depth);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+    glTexImage2D(GL_TEXTURE_2D, 0, GL_DEPTH_COMPONENT24, width, height, 0, GL_DEPTH_COMPONENT, GL_UNSIGNED_INT, NULL);
+    glBindTexture(GL_TEXTURE_2D, 0);
+
+    GL.BindFramebuffer(GL_FRAMEBUFFER, dr.fbo);
+    GL.FramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, dr.color, 0);
+    GL.FramebufferTexture2D(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_TEXTURE_2D, dr.depth, 0);
+    if (GL.CheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE) {
+        fprintf(stderr, "Dynamic resolution: framebuffer is not complete, turning it off\n");
+        dr.ready = false;
+    }
+    GL.BindFramebuffer(GL_FRAMEBUFFER, 0);
+    dr.size[0] = width;
+    dr.size[1] = height;
+}
+
+
+// start drawing the scene offscreen, for a window viewport of width x height:
+//    the target only gets reallocated when that changes, and a smaller
+//    scale just uses its lower-left corner
+
+void beginDynamicResolution(DynamicResolution &dr, int width, int height) {
+    if (width != dr.size[0] || height != dr.size[1])
+        dynresResize(dr, width, height);
+    dr.width = std::max(1, (int)lroundf(width * dr.scale));
+    dr.height = std::max(1, (int)lroundf(height * dr.scale));
+
+    GL.BindFramebuffer(GL_FRAMEBUFFER, dr.fbo);
+    glViewport(0, 0, dr.width, dr.height);
+    if (dr.gpuTimed && !dr.pending[dr.next])
+        GL.BeginQuery(GL_TIME_ELAPSED, dr.queries[dr.next]);
+}
+
+
+// stretch what was drawn into the window's viewport:
+void endDynamicResolution(DynamicResolution &dr, GLint const viewport[4]) {
+    if (dr.gpuTimed && !dr.pending[dr.next]) {
+        GL.EndQuery(GL_TIME_ELAPSED);
+        dr.pending[dr.next] = true;
+        dr.next = (dr.next + 1) % DYNRES_QUERIES;
+    }
+
+    GL.BindFramebuffer(GL_READ_FRAMEBUFFER, dr.fbo);
+    GL.BindFramebuffer(GL_DRAW_FRAMEBUFFER, 0);
+    GL.BlitFramebuffer(0, 0, dr.width, dr.height,
+                       viewport[0], viewport[1], viewport[0] + viewport[2], viewport[1] + viewport[3],
+                       GL_COLOR_BUFFER_BIT, GL_LINEAR);
+    GL.BindFramebuffer(GL_FRAMEBUFFER, 0);
+    glViewport(viewport[0], viewport[1], viewport[2], viewport[3]);
+}
+
+
+// once a frame: take the newest frame time there is and move the scale toward the budget
+void updateDynamicResolution(DynamicResolution &dr, float now) {
+    float dt = now - dr.lastTime;
+    bool measured = false;
+    if (dr.gpuTimed) {
+        // oldest first, so the last one read is the newest:
+        for (int k = 0; k < DYNRES_QUERIES; k++) {
+            int q = (dr.next + k) % DYNRES_QUERIES;
+            if (!dr.pending[q])
+                continue;
+            GLuint available = 0;
+            GL.GetQueryObjectuiv(dr.queries[q], GL_QUERY_RESULT_AVAILABLE, &available);
+            if (!available)
+                break;
+            GLuint64 ns;
+            GL.GetQueryObjectui64v(dr.queries[q], GL_QUERY_RESULT, &ns);
+            dr.pending[q] = false;
+            dr.frameMs = ns / 1.e6f;
+            measured = true;
+        }
+    } else if (dr.lastTime > 0.f) {
+        dr.frameMs = 1000.f * dt;
+        measured = true;
+    }
+    dr.lastTime = now;
+    if (!measured || dt <= 0.f)
+        return;
+
+    dr.smoothMs = dr.smoothMs > 0.f ? dr.smoothMs + DYNRES_SMOOTHING * (dr.frameMs - dr.smoothMs) : dr.frameMs;
+    float error = (DYNRES_TARGET_MS - dr.smoothMs) / DYNRES_TARGET_MS;
+    float derivative = (error - dr.lastError) / dt;
+    dr.lastError = error;
+
+    // stop integrating while pinned at a limit, so it can come straight back off it:
+    float integral = dr.integral + error * dt;
+    float out = DYNRES_KP * error + DYNRES_KI * integral + DYNRES_KD * derivative;
+    if (out > DYNRES_MAX_SCALE)
+        out = DYNRES_MAX_SCALE;
+    else if (out < DYNRES_MIN_SCALE)
+        out = DYNRES_MIN_SCALE;
+    else
+        dr.integral = integral;
+    dr.scale = out;
+}
+
+
+#endif /* dynres_hpp */
@@ -0,0 +1,102 @@
+//
+//  edgechain.hpp
+//  project2
+//
+//  Greedily chains GL_LINES edges that share endpoints into line strips.
+//    The strips are stored back to back in one index list, separated by
+//    EDGECHAIN_RESTART, ready for primitive restart.
+//
+
+#ifndef edgechain_hpp
+#define edgechain_hpp
+
+#include <stdio.h>
+
+#include <vector>
+
+
+// separates one strip from the next:
+const int EDGECHAIN_RESTART = -1;
+
+
+struct EdgeChains
+{
+    std::vector<int> indices;   // strip, RESTART, strip, RESTART, ..., strip
+    int nstrips;
+    int nedges;                 // how many edges went in
+};
+
+
+EdgeChains chainEdges(std::vector<struct edge> const &edges, int npoints) {
+    EdgeChains ec;
+    ec.nstrips = 0;
+    ec.nedges = (int)edges.size();
+
+    // edges around each vertex (compressed rows):
+
+    std::vector<int> first(npoints + 1, 0), around(2*edges.size());
+    for (struct edge const &e : edges) {
+        first[e.p0 + 1]++;
+        first[e.p1 + 1]++;
+    }
+    for (int v = 0; v < npoints; v++)
+        first[v + 1] += first[v];
+    std::vector<int> fill(first.begin(), first.end() - 1);
+    for (int i = 0; i < (int)edges.size(); i++) {
+        around[fill[edges[i].p0]++] = i;
+        around[fill[edges[i].p1]++] = i;
+    }
+
+    std::vector<int> degree(npoints), next(first.begin(), first.end() - 1);
+    for (int v = 0; v < npoints; v++)
+        degree[v] = first[v + 1] - first[v];
+    std::vector<char> used(edges.size(), 0);
+
+    // walk from v along unused edges for as long as we can:
+
+    auto walk = [&](int v) {
+        if (ec.nstrips > 0)
+            ec.indices.push_back(EDGECHAIN_RESTART);
+        ec.nstrips++;
+        ec.indices.push_back(v);
+        for (;;) {
+            while (next[v] < first[v + 1] && used[around[next[v]]])
+                next[v]++;
+            if (next[v] == first[v + 1])
+                break;
+            int i = around[next[v]];
+            used[i] = 1;
+            int w = edges[i].p0 == v ? edges[i].p1 : edges[i].p0;
+            degree[v]--;
+            degree[w]--;
+            ec.indices.push_back(w);
+            v = w;
+        }
+    };
+
+    // a strip has to start or end at an odd vertex, so start there first:
+
+    for (int v = 0; v < npoints; v++) {
+        while (degree[v] % 2 == 1)
+            walk(v);
+    }
+    for (int v = 0; v < npoints; v++) {
+        while (degree[v] > 0)
+            walk(v);
+    }
+
+    return ec;
+}
+
+
+// print how many index references the strips save over GL_LINES:
+
+void reportEdgeChains(char const *name, EdgeChains const &ec) {
+    int lines = 2 * ec.nedges;
+    int strips = (int)ec.indices.size();
+    fprintf(stderr, "Edge chains (%s): %d edges -> %d strips, %d -> %d indices (%.0f%%)\n",
+            name, ec.nedges, ec.nstrips, lines, strips, lines > 0 ? 100. * strips / lines : 0.);
+}
+
+
+#endif /* edgechain_hpp */
@@ -0,0 +1,114 @@
+//
+//  fleet.hpp
+//  project2
+//
+//  A fleet of aircraft instances for stress-testing: instance 0 is the
+//    aircraft at the origin, the others fly circles on a grid around it.
+//
+
+#ifndef fleet_hpp
+#define fleet_hpp
+
+#include <math.h>
+
+#include <algorithm>
+#include <vector>
+
+#include "jobs.hpp"
+
+
+// fleet sizes offered in the Fleet menu:
+const int FLEET_SIZES[] = { 1, 16, 256, 1024 };
+const int FLEET_NSIZES = sizeof(FLEET_SIZES) / sizeof(FLEET_SIZES[0]);
+
+// distance between neighboring grid cells:
+const float FLEET_SPACING = 60.f;
+
+// radius of the circle each aircraft flies around its cell:
+const float FLEET_CIRCLE_RADIUS = 12.f;
+
+// seconds for one lap of the circle:
+const float FLEET_LAP_SECONDS = 20.f;
+
+// fewest aircraft per job when moving them:
+const int FLEET_UPDATE_GRAIN = 256;
+
+
+struct Instance
+{
+    float m[16];            // model to world, column-major like OpenGL
+    float inv[16];          // world to model
+};
+
+
+struct Fleet
+{
+    std::vector<Instance> instances;
+    std::vector<float> cellX, cellZ;    // center of the circle each one flies
+    std::vector<float> phase;           // fraction of a lap it starts at
+};
+
+
+// lay out n aircraft: the first at the origin, the rest in rings of grid cells around it
+
+void resizeFleet(Fleet &fleet, int n) {
+    fleet.instances.resize(n);
+    fleet.cellX.assign(n, 0.f);
+    fleet.cellZ.assign(n, 0.f);
+    fleet.phase.assign(n, 0.f);
+
+    int side = 1;
+    while (side*side < n)
+        side += 2;
+    std::vector<std::pair<int, int>> cells;
+    for (int gx = -side/2; gx <= side/2; gx++)
+        for (int gz = -side/2; gz <= side/2; gz++)
+            cells.push_back({ gx, gz });
+    std::stable_sort(cells.begin(), cells.end(), [](std::pair<int, int> const &a, std::pair<int, int> const &b) {
+        return std::max(abs(a.first), abs(a.second)) < std::max(abs(b.first), abs(b.second));
+    });
+
+    for (int i = 1; i < n; i++) {
+        fleet.cellX[i] = cells[i].first * FLEET_SPACING;
+        fleet.cellZ[i] = cells[i].second * FLEET_SPACING;
+        fleet.phase[i] = (float)((i * 37) % 100) / 100.f;
+    }
+}
+
+
+// move everyone (but instance 0) along their circles:
+
+static void updateFleetRange(Fleet &fleet, float time, int first, int last) {
+    for (int i = first; i < last; i++) {
+        float x = 0.f, y = 0.f, z = 0.f, heading = 0.f;
+        if (i > 0) {
+            float a = 2.f * (float)M_PI * (time / FLEET_LAP_SECONDS + fleet.phase[i]);
+            x = fleet.cellX[i] + FLEET_CIRCLE_RADIUS * cosf(a);
+            y = 3.f * sinf(2.f * a);
+            z = fleet.cellZ[i] + FLEET_CIRCLE_RADIUS * sinf(a);
+            heading = -a;           // the nose (+Z) points along the circle
+        }
+
+        // translate(x, y, z) * rotate(heading about Y), and its inverse:
+        float c = cosf(heading), s = sinf(heading);
+        float *m = fleet.instances[i].m, *inv = fleet.instances[i].inv;
+        m[0] = c;   m[4] = 0.f; m[8]  = s;   m[12] = x;
+        m[1] = 0.f; m[5] = 1.f; m[9]  = 0.f; m[13] = y;
+        m[2] = -s;  m[6] = 0.f; m[10] = c;   m[14] = z;
+        m[3] = 0.f; m[7] = 0.f; m[11] = 0.f; m[15] = 1.f;
+
+        inv[0] = c;   inv[4] = 0.f; inv[8]  = -s;  inv[12] = -(c*x - s*z);
+        inv[1] = 0.f; inv[5] = 1.f; inv[9]  = 0.f; inv[13] = -y;
+        inv[2] = s;   inv[6] = 0.f; inv[10] = c;   inv[14] = -(s*x + c*z);
+        inv[3] = 0.f; inv[7] = 0.f; inv[11] = 0.f; inv[15] = 1.f;
+    }
+}
+
+void updateFleet(Fleet &fleet, float time) {
+    parallelFor(0, (int)fleet.instances.size(), FLEET_UPDATE_GRAIN, [&](int first, int last) {
+        updateFleetRange(fleet, time, first, last);
+    });
+}
+
+
+#endif /* fleet_hpp */
@@ -0,0 +1,177 @@
+//
+//  framepacer.hpp
+//  project2
+//
+//  Keeps the CPU at most inFlight frames ahead of the GPU.  Each frame gets
+//    a fence after it is swapped; before the next frame is drawn, the
+//    pacer waits on the oldest fence until no more than inFlight - 1 are
+//    still pending.  1 frame in flight is the lowest latency, 2 or 3 keep
+//    the GPU busy while the CPU works on the next frame.
+//  The input callbacks tell it when input arrives (or, for input that goes
+//    through the simulation thread, the snapshot that first shows it
+//    does).  A frame carries the
+//    time of the earliest input it is the first to show, and when its
+//    fence is seen to have passed, that time to now is its
+//    input-to-photon estimate (the scanout after it depends on the display
+//    and is not counted).
+//
+
+#ifndef framepacer_hpp
+#define framepacer_hpp
+
+#include <stdio.h>
+
+#include <chrono>
+
+#include "glproc.hpp"
+
+
+// most frames that may be in flight at once:
+const int PACER_MAX_FRAMES = 3;
+
+// longest to wait for a frame, in ns:
+const GLuint64 PACER_TIMEOUT = 1000000000;
+
+
+struct FramePacer
+{
+    bool    ready;                          // false if the context has no fences
+    int     inFlight;                       // frames allowed in flight, 0 to leave it to the driver (and not measure)
+    GLsync  fences[PACER_MAX_FRAMES];       // frames in flight, oldest at first
+    double  inputs[PACER_MAX_FRAMES];       // ... and the input each one shows, or -1
+    int     first, count;
+    double  pendingInput;                   // earliest input no frame has started on yet, or -1
+
+    // since the last pacerReport():
+    int     frames;
+    double  waitMs;                         // CPU time spent waiting for the GPU
+    int     latencies;                      // frames that showed input
+    double  latencyMs, latencyMaxMs;
+};
+
+
+static double pacerNow() {
+    return std::chrono::duration<double>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+
+bool initFramePacer(FramePacer &p, int inFlight) {
+    p = FramePacer{};
+    p.inFlight = inFlight;
+    p.pendingInput = -1.;
+    p.ready = GL.FenceSync != NULL && GL.ClientWaitSync != NULL && GL.DeleteSync != NULL &&
+              (glVersionAtLeast(3, 2) || hasGLExtension("GL_ARB_sync"));
+    if (!p.ready)
+        fprintf(stderr, "Frame pacing: no fences in this context, the driver decides\n");
+    else if (glCapturing()) {
+        // a replay would be handed fences that only meant something to us
+        fprintf(stderr, "Frame pacing: off while capturing, the driver decides\n");
+        p.ready = false;
+    }
+    return p.ready;
+}
+
+
+// from the input callbacks:
+void pacerInput(FramePacer &p) {
+    if (p.pendingInput < 0.)
+        p.pendingInput = pacerNow();
+}
+
+// ... or, for input that reaches the screen later than it came in, from
+//    whatever hands it to the frame about to be drawn, with when it came in:
+void pacerInputAt(FramePacer &p, double time) {
+    if (time >= 0. && (p.pendingInput < 0. || time < p.pendingInput))
+        p.pendingInput = time;
+}
+
+
+// the oldest frame is done:
+static void pacerRetire(FramePacer &p) {
+    GLsync &fence = p.fences[p.first];
+    GL.DeleteSync(fence);
+    fence = NULL;
+    double input = p.inputs[p.first];
+    if (input >= 0.) {
+        double ms = 1000. * (pacerNow() - input);
+        p.latencies++;
+        p.latencyMs += ms;
+        if (ms > p.latencyMaxMs)
+            p.latencyMaxMs = ms;
+    }
+    p.first = (p.first + 1) % PACER_MAX_FRAMES;
+    p.count--;
+}
+
+// is it?  Or, if wait, once it is:
+static bool pacerOldestDone(FramePacer &p, bool wait) {
+    GLenum r = GL.ClientWaitSync(p.fences[p.first], GL_SYNC_FLUSH_COMMANDS_BIT, wait ? PACER_TIMEOUT : 0);
+    return r == GL_ALREADY_SIGNALED || r == GL_CONDITION_SATISFIED || r == GL_WAIT_FAILED;
+}
+
+
+// before drawing a frame: retire what has finished, then wait until there
+//    is room for this one
+void pacerBeginFrame(FramePacer &p) {
+    if (!p.ready)
+        return;
+    while (p.count > 0 && pacerOldestDone(p, false))
+        pacerRetire(p);
+
+    if (p.inFlight > 0 && p.count >= p.inFlight) {
+        auto start = std::chrono::steady_clock::now();
+        while (p.count >= p.inFlight) {
+            pacerOldestDone(p, true);
+            pacerRetire(p);
+        }
+        p.waitMs += std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+    }
+}
+
+// after glutSwapBuffers():
+void pacerEndFrame(FramePacer &p) {
+    p.frames++;
+    if (!p.ready || p.inFlight == 0) {
+        p.pendingInput = -1.;
+        return;
+    }
+    int last = (p.first + p.count) % PACER_MAX_FRAMES;
+    p.fences[last] = GL.FenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+    p.inputs[last] = p.pendingInput;
+    p.pendingInput = -1.;
+    p.count++;
+}
+
+
+// before the GL goes away: the GPU is done with everything
+void pacerDrain(FramePacer &p) {
+    if (!p.ready || p.inFlight == 0) {
+        glFinish();
+        return;
+    }
+    while (p.count > 0) {
+        pacerOldestDone(p, true);
+        pacerRetire(p);
+    }
+}
+
+
+// with the stats, every second or so:
+void pacerReport(FramePacer &p, bool print) {
+    if (print && p.frames > 0) {
+        if (p.inFlight == 0)
+            fprintf(stderr, "Pacing: off");
+        else
+            fprintf(stderr, "Pacing: %d in flight, %.3f ms/frame waiting for the GPU", p.inFlight,
+                    p.waitMs / p.frames);
+        if (p.latencies > 0)
+            fprintf(stderr, ", input to photon %.2f ms (max %.2f) over %d frames",
+                    p.latencyMs / p.latencies, p.latencyMaxMs, p.latencies);
+        fprintf(stderr, "\n");
+    }
+    p.frames = p.latencies = 0;
+    p.waitMs = p.latencyMs = p.latencyMaxMs = 0.;
+}
+
+
+#endif /* framepacer_hpp */
@@ -0,0 +1,137 @@
+//
+//  frustum.hpp
+//  project2
+//
+//  View-frustum culling: the six planes come straight out of
+//    projection * modelview, and objects are tested by their precomputed
+//    bounding spheres (then boxes).  Many spheres at once are tested four
+//    to a vector (simd4.hpp).
+//
+
+#ifndef frustum_hpp
+#define frustum_hpp
+
+#include <math.h>
+#include <string.h>
+
+#include <vector>
+
+#include "bvh.hpp"
+#include "fleet.hpp"
+#include "simd4.hpp"
+
+
+struct Frustum
+{
+    float planes[6][4];     // a*x + b*y + c*z + d >= 0 inside; (a, b, c) is unit length
+};
+
+
+struct BoundingSphere
+{
+    float c[3];
+    float r;
+};
+
+
+// the frustum in the coordinates the modelview matrix starts from (column-major matrices):
+
+Frustum extractFrustum(GLdouble const projection[16], GLdouble const modelview[16]) {
+    double clip[16];
+    for (int c = 0; c < 4; c++)
+        for (int r = 0; r < 4; r++)
+            clip[4*c + r] = projection[r]    * modelview[4*c]     + projection[4 + r]  * modelview[4*c + 1] +
+                            projection[8 + r] * modelview[4*c + 2] + projection[12 + r] * modelview[4*c + 3];
+
+    // left, right, bottom, top, near, far: row 3 plus or minus rows 0, 1, 2
+    Frustum f;
+    for (int p = 0; p < 6; p++) {
+        int row = p / 2;
+        double sign = (p % 2 == 0) ? 1. : -1.;
+        double plane[4];
+        for (int c = 0; c < 4; c++)
+            plane[c] = clip[4*c + 3] + sign * clip[4*c + row];
+        double len = sqrt(plane[0]*plane[0] + plane[1]*plane[1] + plane[2]*plane[2]);
+        for (int c = 0; c < 4; c++)
+            f.planes[p][c] = (float)(plane[c] / len);
+    }
+    return f;
+}
+
+
+bool sphereInFrustum(Frustum const &f, BoundingSphere const &s) {
+    for (int p = 0; p < 6; p++) {
+        float const *pl = f.planes[p];
+        if (pl[0]*s.c[0] + pl[1]*s.c[1] + pl[2]*s.c[2] + pl[3] < -s.r)
+            return false;
+    }
+    return true;
+}
+
+
+// the box corner farthest along each plane's normal has to be inside:
+
+bool boxInFrustum(Frustum const &f, BVHBounds const &b) {
+    for (int p = 0; p < 6; p++) {
+        float const *pl = f.planes[p];
+        float x = pl[0] >= 0.f ? b.hi[0] : b.lo[0];
+        float y = pl[1] >= 0.f ? b.hi[1] : b.lo[1];
+        float z = pl[2] >= 0.f ? b.hi[2] : b.lo[2];
+        if (pl[0]*x + pl[1]*y + pl[2]*z + pl[3] < 0.f)
+            return false;
+    }
+    return true;
+}
+
+
+// test n spheres (structure of arrays) four at a time;
+//    the indices of the ones that are at least partly inside go into visible
+
+void cullSpheres(Frustum const &f, float const *x, float const *y, float const *z, float const *r,
+                 int n, std::vector<int> &visible) {
+    visible.clear();
+    int i = 0;
+    for (; i + 4 <= n; i += 4) {
+        SimdFloat4 cx = simdLoad(x + i), cy = simdLoad(y + i), cz = simdLoad(z + i);
+        SimdFloat4 nr = simdNeg(simdLoad(r + i));
+        SimdMask4 inside = simdAllTrue();
+        for (int p = 0; p < 6; p++) {
+            float const *pl = f.planes[p];
+            SimdFloat4 d = simdAdd(simdAdd(simdMul(cx, simdSplat(pl[0])), simdMul(cy, simdSplat(pl[1]))),
+                                   simdAdd(simdMul(cz, simdSplat(pl[2])), simdSplat(pl[3])));
+            inside = simdAnd(inside, simdGE(d, nr));
+        }
+        int bits = simdBits(inside);
+        for (int k = 0; k < 4; k++)
+            if (bits & (1 << k))
+                visible.push_back(i + k);
+    }
+    for (; i < n; i++) {
+        BoundingSphere s = { { x[i], y[i], z[i] }, r[i] };
+        if (sphereInFrustum(f, s))
+            visible.push_back(i);
+    }
+}
+
+
+// the fleet instances whose copy of the model-space sphere s is in view
+//    (the transforms are rigid, so the radius does not change)
+
+void cullInstances(Frustum const &f, Fleet const &fleet, BoundingSphere const &s, std::vector<int> &visible) {
+    static std::vector<float> x, y, z, r;
+    int n = (int)fleet.instances.size();
+    x.resize(n);
+    y.resize(n);
+    z.resize(n);
+    r.assign(n, s.r);
+    for (int i = 0; i < n; i++) {
+        float const *m = fleet.instances[i].m;
+        x[i] = m[0]*s.c[0] + m[4]*s.c[1] + m[8]*s.c[2]  + m[12];
+        y[i] = m[1]*s.c[0] + m[5]*s.c[1] + m[9]*s.c[2]  + m[13];
+        z[i] = m[2]*s.c[0] + m[6]*s.c[1] + m[10]*s.c[2] + m[14];
+    }
+    cullSpheres(f, x.data(), y.data(), z.data(), r.data(), n, visible);
+}
+
+
+#endif /* frustum_hpp */
@@ -0,0 +1,362 @@
+//
+//  glcapture.hpp
+//  project2
+//
+//  Writes the GL call stream to a file so replay.cpp can run the same GL
+//    work again without the rest of the program.  Needs the GL_TRACE
+//    wrappers (it is included from gltrace.hpp).  Run with
+//    "-capture file [frames]" and every call is recorded, from when the GL
+//    table is loaded through the end of that many frames.  That includes
+//    InitLists(), so its buffer uploads and display lists are in the file.
+//
+//  The file is a GLCaptureHeader followed by records.  Each record is a
+//    16-bit call id, then the call's arguments as they are in memory.  The
+//    id is a GLTraceId, or GLC_FRAME at the end of each frame.
+//    - What a pointer argument points at is written out: a matrix, the
+//      vertices of a client array, shader source.
+//    - A pointer that is really an offset into a buffer object is written
+//      as a 64-bit number.
+//    - Object names are written as the program got them, and the replayer
+//      maps them to its own.  So are uniform locations and block indices.
+//
+
+#ifndef glcapture_hpp
+#define glcapture_hpp
+
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+
+
+const char GLC_MAGIC[8] = { 'G', 'L', 'C', 'A', 'P', 'T', '0', '1' };
+
+// the record that ends a frame:
+const uint16_t GLC_FRAME = 0xffff;
+
+// frames captured when the command line does not say:
+const int GL_CAPTURE_FRAMES = 100;
+
+
+struct GLCaptureHeader
+{
+    char     magic[8];
+    uint32_t ncalls;            // GLT_NCALLS of the program that wrote it
+    int32_t  width, height;     // the window's size
+    uint32_t frames;
+};
+
+
+// bytes per pixel of a glTexImage2D() upload, or per element of a client array:
+
+int glcTypeSize(GLenum type) {
+    switch (type) {
+        case GL_BYTE:  case GL_UNSIGNED_BYTE:   return 1;
+        case GL_SHORT: case GL_UNSIGNED_SHORT:  return 2;
+        case GL_DOUBLE:                         return 8;
+        default:                                return 4;
+    }
+}
+
+int glcPixelSize(GLenum format, GLenum type) {
+    int components = 4;
+    switch (format) {
+        case GL_RED: case GL_ALPHA: case GL_LUMINANCE: case GL_DEPTH_COMPONENT: components = 1; break;
+        case GL_RG:  case GL_LUMINANCE_ALPHA:   components = 2; break;
+        case GL_RGB: case GL_BGR:               components = 3; break;
+    }
+    return components * glcTypeSize(type);
+}
+
+
+#ifdef GL_TRACE
+
+#include <algorithm>
+#include <tuple>
+#include <type_traits>
+#include <unordered_map>
+
+
+struct GLCapture
+{
+    FILE    *file;
+    char const *path;
+    bool    recording;
+    int     framesWanted;
+    GLCaptureHeader header;
+    long    bytes;
+    bool    warned;                 // about something we could not capture
+
+    // what the draw calls need to know to find client-side arrays:
+    GLuint  arrayBuffer, elementBuffer;
+    GLuint  vertexArrayObject;      // the element buffer binding belongs to it
+    std::unordered_map<GLuint, GLuint> elementBuffers;  // ... of each one that has been bound
+    bool    vertexArray;            // GL_VERTEX_ARRAY is enabled
+    GLint   vertexSize;
+    GLenum  vertexType;
+    GLsizei vertexStride;
+    char const *vertexPointer;      // NULL when the vertex array is in a buffer
+};
+
+GLCapture GLCaptureState;
+
+
+// from the command line, before there is a window:
+void startGLCapture(char const *path, int frames) {
+    GLCapture &c = GLCaptureState;
+    c.file = fopen(path, "wb");
+    if (c.file == NULL) {
+        fprintf(stderr, "GL capture: cannot write %s\n", path);
+        return;
+    }
+    c.path = path;
+    c.framesWanted = frames;
+}
+
+// is everything being recorded?  Then what the replayer cannot see, like
+//    writes through a mapped buffer, had better be done another way
+bool glCapturing() {
+    return GLCaptureState.recording;
+}
+
+// once the GL table is loaded: from here on everything is recorded
+void captureBegin() {
+    GLCapture &c = GLCaptureState;
+    if (c.file == NULL)
+        return;
+    memcpy(c.header.magic, GLC_MAGIC, sizeof(GLC_MAGIC));
+    c.header.ncalls = GLT_NCALLS;
+    c.header.width = glutGet(GLUT_WINDOW_WIDTH);
+    c.header.height = glutGet(GLUT_WINDOW_HEIGHT);
+    fwrite(&c.header, sizeof(c.header), 1, c.file);
+    c.recording = true;
+    fprintf(stderr, "GL capture: recording %d frames to %s\n", c.framesWanted, c.path);
+}
+
+
+static void capturePut(void const *p, size_t n) {
+    fwrite(p, 1, n, GLCaptureState.file);
+    GLCaptureState.bytes += n;
+}
+
+template<typename T>
+static void captureArg(T v) {
+    if constexpr (std::is_pointer_v<T>) {
+        uint64_t offset = (uint64_t)(uintptr_t)v;
+        capturePut(&offset, sizeof(offset));
+    } else {
+        capturePut(&v, sizeof(v));
+    }
+}
+
+static void captureString(char const *s, int len) {
+    uint32_t n = len >= 0 ? len : (uint32_t)strlen(s);
+    captureArg(n);
+    capturePut(s, n);
+}
+
+static void captureWarn(char const *what) {
+    if (!GLCaptureState.warned)
+        fprintf(stderr, "GL capture: %s, the replay will differ\n", what);
+    GLCaptureState.warned = true;
+}
+
+
+// the first n elements of the client vertex array, packed, if it is in use;
+//    a 32-bit count and then the data
+static void captureClientVertices(long n) {
+    GLCapture &c = GLCaptureState;
+    uint32_t count = c.vertexArray && c.vertexPointer != NULL ? (uint32_t)n : 0;
+    captureArg(count);
+    int size = c.vertexSize * glcTypeSize(c.vertexType);
+    int stride = c.vertexStride != 0 ? c.vertexStride : size;
+    for (uint32_t i = 0; i < count; i++)
+        capturePut(c.vertexPointer + (size_t)i * stride, size);
+}
+
+template<typename T>
+static long captureMaxIndex(void const *indices, int count) {
+    long max = -1;
+    for (int i = 0; i < count; i++)
+        max = std::max(max, (long)((T const *)indices)[i]);
+    return max;
+}
+
+
+// called by each wrapper after the real call, with what it returned:
+
+template<int ID, typename... A>
+void glCaptureCall(long result, A... a) {
+    GLCapture &c = GLCaptureState;
+    if (!c.recording)
+        return;
+    uint16_t id = ID;
+    captureArg(id);
+    auto args = std::make_tuple(a...);
+
+    if constexpr (ID == GLT_Vertex3fv) {
+        capturePut(std::get<0>(args), 3 * sizeof(GLfloat));
+    } else if constexpr (ID == GLT_MultMatrixf) {
+        capturePut(std::get<0>(args), 16 * sizeof(GLfloat));
+    } else if constexpr (ID == GLT_GenBuffers || ID == GLT_DeleteBuffers || ID == GLT_GenQueries ||
+                         ID == GLT_DeleteQueries || ID == GLT_GenFramebuffers ||
+                         ID == GLT_DeleteFramebuffers || ID == GLT_GenTextures ||
+                         ID == GLT_GenVertexArrays || ID == GLT_DeleteVertexArrays) {
+        // n, then the n names
+        captureArg(std::get<0>(args));
+        capturePut(std::get<1>(args), std::get<0>(args) * sizeof(GLuint));
+    } else if constexpr (ID == GLT_GenLists || ID == GLT_CreateShader) {
+        captureArg(std::get<0>(args));
+        captureArg((GLuint)result);
+    } else if constexpr (ID == GLT_CreateProgram) {
+        captureArg((GLuint)result);
+    } else if constexpr (ID == GLT_BufferData) {
+        // target, size, usage, whether there is data, the data
+        captureArg(std::get<0>(args));
+        captureArg((int64_t)std::get<1>(args));
+        captureArg(std::get<3>(args));
+        uint8_t data = std::get<2>(args) != NULL;
+        captureArg(data);
+        if (data)
+            capturePut(std::get<2>(args), std::get<1>(args));
+    } else if constexpr (ID == GLT_BufferSubData) {
+        // target, offset, size, the data
+        captureArg(std::get<0>(args));
+        captureArg((int64_t)std::get<1>(args));
+        captureArg((int64_t)std::get<2>(args));
+        capturePut(std::get<3>(args), std::get<2>(args));
+    } else if constexpr (ID == GLT_UniformMatrix4fv) {
+        // location, count, transpose, the matrices
+        captureArg(std::get<0>(args));
+        captureArg(std::get<1>(args));
+        captureArg(std::get<2>(args));
+        capturePut(std::get<3>(args), std::get<1>(args) * 16 * sizeof(GLfloat));
+    } else if constexpr (ID == GLT_ShaderSource) {
+        // shader, count, then each string as a length and its characters
+        captureArg(std::get<0>(args));
+        captureArg(std::get<1>(args));
+        for (int i = 0; i < std::get<1>(args); i++)
+            captureString(std::get<2>(args)[i], std::get<3>(args) != NULL ? std::get<3>(args)[i] : -1);
+    } else if constexpr (ID == GLT_BindAttribLocation) {
+        captureArg(std::get<0>(args));
+        captureArg(std::get<1>(args));
+        captureString(std::get<2>(args), -1);
+    } else if constexpr (ID == GLT_GetUniformLocation || ID == GLT_GetUniformBlockIndex) {
+        captureArg(std::get<0>(args));
+        captureString(std::get<1>(args), -1);
+        captureArg((GLint)result);
+    } else if constexpr (ID == GLT_TexImage2D) {
+        // the eight numbers, whether there are pixels, the pixels
+        captureArg(std::get<0>(args));  captureArg(std::get<1>(args));
+        captureArg(std::get<2>(args));  captureArg(std::get<3>(args));
+        captureArg(std::get<4>(args));  captureArg(std::get<5>(args));
+        captureArg(std::get<6>(args));  captureArg(std::get<7>(args));
+        uint8_t data = std::get<8>(args) != NULL;
+        captureArg(data);
+        if (data)
+            capturePut(std::get<8>(args), (size_t)std::get<3>(args) * std::get<4>(args) *
+                       glcPixelSize(std::get<6>(args), std::get<7>(args)));
+    } else if constexpr (ID == GLT_VertexPointer) {
+        // size, type, stride, whether it is client memory; an offset if it is not
+        captureArg(std::get<0>(args));
+        captureArg(std::get<1>(args));
+        captureArg(std::get<2>(args));
+        uint8_t client = c.arrayBuffer == 0;
+        captureArg(client);
+        c.vertexSize = std::get<0>(args);
+        c.vertexType = std::get<1>(args);
+        c.vertexStride = std::get<2>(args);
+        c.vertexPointer = client ? (char const *)std::get<3>(args) : NULL;
+        if (!client)
+            captureArg(std::get<3>(args));
+    } else if constexpr (ID == GLT_ColorPointer) {
+        // the same, but only a buffer's colours come along
+        captureArg(std::get<0>(args));
+        captureArg(std::get<1>(args));
+        captureArg(std::get<2>(args));
+        uint8_t client = c.arrayBuffer == 0;
+        captureArg(client);
+        if (client)
+            captureWarn("a client-side colour array");
+        else
+            captureArg(std::get<3>(args));
+    } else if constexpr (ID == GLT_DrawArrays) {
+        (captureArg(a), ...);
+        captureClientVertices(std::get<1>(args) + std::get<2>(args));
+    } else if constexpr (ID == GLT_DrawElements) {
+        // mode, count, type, whether the indices are client memory, then
+        //    they or their offset, and the client vertices they reach
+        captureArg(std::get<0>(args));
+        captureArg(std::get<1>(args));
+        captureArg(std::get<2>(args));
+        uint8_t client = c.elementBuffer == 0;
+        captureArg(client);
+        long max = -1;
+        if (client) {
+            GLenum type = std::get<2>(args);
+            capturePut(std::get<3>(args), (size_t)std::get<1>(args) * glcTypeSize(type));
+            max = type == GL_UNSIGNED_BYTE  ? captureMaxIndex<GLubyte>(std::get<3>(args), std::get<1>(args)) :
+                  type == GL_UNSIGNED_SHORT ? captureMaxIndex<GLushort>(std::get<3>(args), std::get<1>(args)) :
+                                              captureMaxIndex<GLuint>(std::get<3>(args), std::get<1>(args));
+        } else {
+            captureArg(std::get<3>(args));
+            if (c.vertexArray && c.vertexPointer != NULL)
+                captureWarn("client vertices drawn with a buffer of indices");
+        }
+        captureClientVertices(max + 1);
+    } else {
+        (captureArg(a), ...);
+        if constexpr (ID == GLT_BindBuffer) {
+            GLenum target = std::get<0>(args);
+            if (target == GL_ARRAY_BUFFER)
+                c.arrayBuffer = std::get<1>(args);
+            else if (target == GL_ELEMENT_ARRAY_BUFFER)
+                c.elementBuffer = c.elementBuffers[c.vertexArrayObject] = std::get<1>(args);
+        } else if constexpr (ID == GLT_BindVertexArray) {
+            c.vertexArrayObject = std::get<0>(args);
+            c.elementBuffer = c.elementBuffers[c.vertexArrayObject];
+        } else if constexpr (ID == GLT_EnableClientState || ID == GLT_DisableClientState) {
+            if (std::get<0>(args) == GL_VERTEX_ARRAY)
+                c.vertexArray = ID == GLT_EnableClientState;
+        } else if constexpr (ID == GLT_VertexAttribPointer) {
+            if (c.arrayBuffer == 0)
+                captureWarn("a client-side vertex attribute array");
+        } else if constexpr (ID == GLT_MapBufferRange || ID == GLT_FenceSync) {
+            captureWarn("a mapped buffer or a fence");
+        }
+    }
+}
+
+
+// after each frame: when there have been enough, finish the file
+void captureEndFrame() {
+    GLCapture &c = GLCaptureState;
+    if (!c.recording)
+        return;
+    captureArg(GLC_FRAME);
+    if ((int)++c.header.frames < c.framesWanted)
+        return;
+
+    fseek(c.file, 0, SEEK_SET);
+    fwrite(&c.header, sizeof(c.header), 1, c.file);
+    fclose(c.file);
+    c.file = NULL;
+    c.recording = false;
+    fprintf(stderr, "GL capture: %u frames, %.1f MB in %s\n", c.header.frames, c.bytes / 1.e6, c.path);
+}
+
+
+#else
+
+
+void startGLCapture(char const *, int) {
+    fprintf(stderr, "GL capture: this build cannot capture, it needs -DGL_TRACE\n");
+}
+
+bool glCapturing() {
+    return false;
+}
+
+
+#endif /* GL_TRACE */
+
+#endif /* glcapture_hpp */
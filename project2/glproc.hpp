@@ -0,0 +1,205 @@
+//
+//  glproc.hpp
+//  project2
+//
+//  Table of the post-1.1 OpenGL entry points we use, looked up at runtime
+//  with glutGetProcAddress (a window must be open to do this).
+//  Call them as GL.GenBuffers(...), etc.
+//
+
+#ifndef glproc_hpp
+#define glproc_hpp
+
+#include <stdio.h>
+#include <string.h>
+
+#include "freeglut_ext.h"
+
+
+// type and name (without the "gl" prefix) of every entry point in the table:
+
+#define GL_PROC_LIST(X) \
+    X(PFNGLGENBUFFERSPROC,                  GenBuffers) \
+    X(PFNGLDELETEBUFFERSPROC,               DeleteBuffers) \
+    X(PFNGLBINDBUFFERPROC,                  BindBuffer) \
+    X(PFNGLBUFFERDATAPROC,                  BufferData) \
+    X(PFNGLCREATESHADERPROC,                CreateShader) \
+    X(PFNGLDELETESHADERPROC,                DeleteShader) \
+    X(PFNGLSHADERSOURCEPROC,                ShaderSource) \
+    X(PFNGLCOMPILESHADERPROC,               CompileShader) \
+    X(PFNGLGETSHADERIVPROC,                 GetShaderiv) \
+    X(PFNGLGETSHADERINFOLOGPROC,            GetShaderInfoLog) \
+    X(PFNGLCREATEPROGRAMPROC,               CreateProgram) \
+    X(PFNGLATTACHSHADERPROC,                AttachShader) \
+    X(PFNGLBINDATTRIBLOCATIONPROC,          BindAttribLocation) \
+    X(PFNGLLINKPROGRAMPROC,                 LinkProgram) \
+    X(PFNGLGETPROGRAMIVPROC,                GetProgramiv) \
+    X(PFNGLGETPROGRAMINFOLOGPROC,           GetProgramInfoLog) \
+    X(PFNGLUSEPROGRAMPROC,                  UseProgram) \
+    X(PFNGLGETUNIFORMLOCATIONPROC,          GetUniformLocation) \
+    X(PFNGLUNIFORM1IPROC,                   Uniform1i) \
+    X(PFNGLUNIFORM1FPROC,                   Uniform1f) \
+    X(PFNGLUNIFORM3FPROC,                   Uniform3f) \
+    X(PFNGLUNIFORM4FPROC,                   Uniform4f) \
+    X(PFNGLENABLEVERTEXATTRIBARRAYPROC,     EnableVertexAttribArray) \
+    X(PFNGLDISABLEVERTEXATTRIBARRAYPROC,    DisableVertexAttribArray) \
+    X(PFNGLVERTEXATTRIBPOINTERPROC,         VertexAttribPointer) \
+    X(PFNGLPRIMITIVERESTARTINDEXPROC,       PrimitiveRestartIndex) \
+    X(PFNGLGENQUERIESPROC,                  GenQueries) \
+    X(PFNGLDELETEQUERIESPROC,               DeleteQueries) \
+    X(PFNGLBEGINQUERYPROC,                  BeginQuery) \
+    X(PFNGLENDQUERYPROC,                    EndQuery) \
+    X(PFNGLGETQUERYOBJECTUIVPROC,           GetQueryObjectuiv) \
+    X(PFNGLGETQUERYOBJECTUI64VPROC,         GetQueryObjectui64v) \
+    X(PFNGLBEGINCONDITIONALRENDERPROC,      BeginConditionalRender) \
+    X(PFNGLENDCONDITIONALRENDERPROC,        EndConditionalRender) \
+    X(PFNGLACTIVETEXTUREPROC,               ActiveTexture) \
+    X(PFNGLGENFRAMEBUFFERSPROC,             GenFramebuffers) \
+    X(PFNGLDELETEFRAMEBUFFERSPROC,          DeleteFramebuffers) \
+    X(PFNGLBINDFRAMEBUFFERPROC,             BindFramebuffer) \
+    X(PFNGLFRAMEBUFFERTEXTURE2DPROC,        FramebufferTexture2D) \
+    X(PFNGLCHECKFRAMEBUFFERSTATUSPROC,      CheckFramebufferStatus) \
+    X(PFNGLBLITFRAMEBUFFERPROC,             BlitFramebuffer) \
+    X(PFNGLGENVERTEXARRAYSPROC,             GenVertexArrays) \
+    X(PFNGLDELETEVERTEXARRAYSPROC,          DeleteVertexArrays) \
+    X(PFNGLBINDVERTEXARRAYPROC,             BindVertexArray) \
+    X(PFNGLBUFFERSUBDATAPROC,               BufferSubData) \
+    X(PFNGLBINDBUFFERBASEPROC,              BindBufferBase) \
+    X(PFNGLGETUNIFORMBLOCKINDEXPROC,        GetUniformBlockIndex) \
+    X(PFNGLUNIFORMBLOCKBINDINGPROC,         UniformBlockBinding) \
+    X(PFNGLUNIFORMMATRIX4FVPROC,            UniformMatrix4fv) \
+    X(PFNGLVERTEXATTRIB3FPROC,              VertexAttrib3f) \
+    X(PFNGLGETSTRINGIPROC,                  GetStringi) \
+    X(PFNGLBUFFERSTORAGEPROC,               BufferStorage) \
+    X(PFNGLMAPBUFFERRANGEPROC,              MapBufferRange) \
+    X(PFNGLUNMAPBUFFERPROC,                 UnmapBuffer) \
+    X(PFNGLFENCESYNCPROC,                   FenceSync) \
+    X(PFNGLCLIENTWAITSYNCPROC,              ClientWaitSync) \
+    X(PFNGLDELETESYNCPROC,                  DeleteSync) \
+    X(PFNGLBINDBUFFERRANGEPROC,             BindBufferRange) \
+    X(PFNGLUNIFORM2FPROC,                   Uniform2f)
+
+
+struct GLProcTable
+{
+#define X(type, name)   type name;
+    GL_PROC_LIST(X)
+#undef X
+};
+
+GLProcTable GL;
+
+#include "gltrace.hpp"
+
+
+// look up every entry point; returns the number that could not be found:
+
+int loadGLProcs() {
+    int missing = 0;
+
+#define X(type, name) \
+    GL.name = (type) glutGetProcAddress("gl" #name); \
+    if (GL.name == NULL) missing++;
+    GL_PROC_LIST(X)
+#undef X
+    traceGLProcs();
+
+    if (missing > 0)
+        fprintf(stderr, "loadGLProcs: %d OpenGL entry points are not available\n", missing);
+    return missing;
+}
+
+
+// is the context at least this OpenGL version?
+
+bool glVersionAtLeast(int major, int minor) {
+    char const *version = (char const *) glGetString(GL_VERSION);
+    int maj = 0, min = 0;
+    if (version == NULL || sscanf(version, "%d.%d", &maj, &min) != 2)
+        return false;
+    return maj > major || (maj == major && min >= minor);
+}
+
+
+// is it a core-profile context, with none of the fixed-function calls?
+
+bool glCoreProfile() {
+    GLint profile = 0;
+    if (glVersionAtLeast(3, 2))
+        glGetIntegerv(GL_CONTEXT_PROFILE_MASK, &profile);
+    return (profile & GL_CONTEXT_CORE_PROFILE_BIT) != 0;
+}
+
+
+// does the current context advertise this extension?
+//    (a core profile only lists them one at a time)
+
+bool hasGLExtension(char const *name) {
+    if (GL.GetStringi != NULL && glCoreProfile()) {
+        GLint n = 0;
+        glGetIntegerv(GL_NUM_EXTENSIONS, &n);
+        for (int i = 0; i < n; i++)
+            if (strcmp((char const *) GL.GetStringi(GL_EXTENSIONS, i), name) == 0)
+                return true;
+        return false;
+    }
+
+    char const *ext = (char const *) glGetString(GL_EXTENSIONS);
+    if (ext == NULL)
+        return false;
+
+    size_t len = strlen(name);
+    for (char const *p = strstr(ext, name); p != NULL; p = strstr(p + len, name)) {
+        if ((p == ext || p[-1] == ' ') && (p[len] == ' ' || p[len] == '\0'))
+            return true;
+    }
+    return false;
+}
+
+
+// compile a vertex + fragment shader pair and link them into a program:
+//    attribs is a NULL-terminated list of attribute names bound to locations 0, 1, 2, ...
+//    returns 0 (and prints the log) on failure
+
+GLuint createProgram(char const *vertSource, char const *fragSource, char const *const *attribs) {
+    char log[1024];
+    GLint ok;
+
+    GLuint shaders[2];
+    GLenum types[2] = { GL_VERTEX_SHADER, GL_FRAGMENT_SHADER };
+    char const *sources[2] = { vertSource, fragSource };
+    for (int i = 0; i < 2; i++) {
+        shaders[i] = GL.CreateShader(types[i]);
+        GL.ShaderSource(shaders[i], 1, &sources[i], NULL);
+        GL.CompileShader(shaders[i]);
+        GL.GetShaderiv(shaders[i], GL_COMPILE_STATUS, &ok);
+        if (!ok) {
+            GL.GetShaderInfoLog(shaders[i], sizeof(log), NULL, log);
+            fprintf(stderr, "%s shader did not compile:\n%s\n", i == 0 ? "Vertex" : "Fragment", log);
+            GL.DeleteShader(shaders[0]);
+            if (i == 1)
+                GL.DeleteShader(shaders[1]);
+            return 0;
+        }
+    }
+
+    GLuint program = GL.CreateProgram();
+    GL.AttachShader(program, shaders[0]);
+    GL.AttachShader(program, shaders[1]);
+    for (int i = 0; attribs != NULL && attribs[i] != NULL; i++)
+        GL.BindAttribLocation(program, i, attribs[i]);
+    GL.LinkProgram(program);
+    GL.DeleteShader(shaders[0]);
+    GL.DeleteShader(shaders[1]);
+
+    GL.GetProgramiv(program, GL_LINK_STATUS, &ok);
+    if (!ok) {
+        GL.GetProgramInfoLog(program, sizeof(log), NULL, log);
+        fprintf(stderr, "Program did not link:\n%s\n", log);
+        return 0;
+    }
+    return program;
+}
+
+
+#endif /* glproc_hpp */
@@ -0,0 +1,124 @@
+//
+//  glstate.hpp
+//  project2
+//
+//  A shadow copy of the bits of fixed-function state that get set over
+//    and over every frame; a call that would not change anything is not
+//    passed on to GL.  Anything that changes the same state behind the
+//    cache's back (a display list that sets colours, say) has to call
+//    stateInvalidate...() after.
+//
+
+#ifndef glstate_hpp
+#define glstate_hpp
+
+#include <string.h>
+
+#include "glproc.hpp"
+
+
+// the capabilities stateEnable()/stateDisable() track:
+const GLenum STATE_CAPS[] = {
+    GL_DEPTH_TEST,
+    GL_NORMALIZE,
+    GL_CULL_FACE,
+    GL_POLYGON_OFFSET_FILL
+};
+const int STATE_NCAPS = sizeof(STATE_CAPS) / sizeof(STATE_CAPS[0]);
+
+
+struct GLStateCache
+{
+    bool    on = true;          // false: pass everything through (still counted)
+    unsigned known = 0;         // bit per STATE_CAPS entry: we know whether it is enabled
+    unsigned enabled = 0;
+    GLenum  matrixMode = 0, shadeModel = 0, drawBuffer = 0, depthFunc = 0;     // 0 = not known
+    bool    colorKnown = false;
+    GLfloat color[3] = {};
+    long    issued = 0, elided = 0;     // since the last stateResetCounts()
+};
+
+GLStateCache GLState;
+
+
+void stateInvalidate() {
+    GLState.known = 0;
+    GLState.matrixMode = GLState.shadeModel = GLState.drawBuffer = GLState.depthFunc = 0;
+    GLState.colorKnown = false;
+}
+
+void stateInvalidateColor() {
+    GLState.colorKnown = false;
+}
+
+void stateResetCounts() {
+    GLState.issued = GLState.elided = 0;
+}
+
+
+// true if the call has to go through; counts it either way:
+static bool stateChanged(bool same) {
+    if (same && GLState.on) {
+        GLState.elided++;
+        return false;
+    }
+    GLState.issued++;
+    return true;
+}
+
+static void stateSetCap(GLenum cap, bool enable) {
+    int bit = -1;
+    for (int i = 0; i < STATE_NCAPS; i++)
+        if (STATE_CAPS[i] == cap)
+            bit = i;
+    if (bit < 0) {
+        GLState.issued++;       // not one we track
+    } else {
+        unsigned mask = 1u << bit;
+        bool same = (GLState.known & mask) && ((GLState.enabled & mask) != 0) == enable;
+        if (!stateChanged(same))
+            return;
+        GLState.known |= mask;
+        GLState.enabled = enable ? GLState.enabled | mask : GLState.enabled & ~mask;
+    }
+    if (enable)
+        glEnable(cap);
+    else
+        glDisable(cap);
+}
+
+void stateEnable(GLenum cap)  { stateSetCap(cap, true); }
+void stateDisable(GLenum cap) { stateSetCap(cap, false); }
+
+
+void stateMatrixMode(GLenum mode) {
+    if (stateChanged(GLState.matrixMode == mode))
+        glMatrixMode(GLState.matrixMode = mode);
+}
+
+void stateShadeModel(GLenum mode) {
+    if (stateChanged(GLState.shadeModel == mode))
+        glShadeModel(GLState.shadeModel = mode);
+}
+
+void stateDrawBuffer(GLenum buffer) {
+    if (stateChanged(GLState.drawBuffer == buffer))
+        glDrawBuffer(GLState.drawBuffer = buffer);
+}
+
+void stateDepthFunc(GLenum func) {
+    if (stateChanged(GLState.depthFunc == func))
+        glDepthFunc(GLState.depthFunc = func);
+}
+
+void stateColor3f(GLfloat r, GLfloat g, GLfloat b) {
+    GLfloat c[3] = { r, g, b };
+    if (!stateChanged(GLState.colorKnown && memcmp(c, GLState.color, sizeof(c)) == 0))
+        return;
+    memcpy(GLState.color, c, sizeof(c));
+    GLState.colorKnown = true;
+    glColor3f(r, g, b);
+}
+
+
+#endif /* glstate_hpp */
@@ -0,0 +1,377 @@
+//
+//  gltrace.hpp
+//  project2
+//
+//  Optional GL call counting.  Build with -DGL_TRACE and every GL call goes
+//    through a table of function pointers: the GL 1.1 calls through GLCore
+//    (glBegin(...) is a macro for GLCore.Begin(...)), the rest through the
+//    GL table as before.  loadGLProcs() looks the real entry points up with
+//    glutGetProcAddress and swaps counting wrappers into both tables.  Each
+//    frame's calls per entry point, vertices, draw calls, state changes
+//    and buffer bytes go into the frame stats.
+//    Without GL_TRACE only the numbering of the entry points is left, and
+//    the calls are direct.
+//
+//  Vertices and draw calls made while a display list is being compiled
+//    are charged to the list, and to the frame each time it is called.
+//
+//  The same wrappers feed glcapture.hpp when a capture is running.
+//
+
+#ifndef gltrace_hpp
+#define gltrace_hpp
+
+#include "stats.hpp"
+
+
+// the GL 1.1 entry points we call, by name without the "gl" prefix:
+
+#define GL_CORE_LIST(X) \
+    X(Begin) X(End) X(Vertex2f) X(Vertex3f) X(Vertex3fv) \
+    X(NewList) X(EndList) X(GenLists) X(CallList) \
+    X(PushMatrix) X(PopMatrix) X(LoadIdentity) X(MultMatrixf) \
+    X(Rotatef) X(Translatef) X(Scalef) X(MatrixMode) \
+    X(Color3f) X(Enable) X(Disable) X(DepthFunc) X(DepthMask) X(ColorMask) \
+    X(ShadeModel) X(DrawBuffer) X(CullFace) X(FrontFace) X(PolygonOffset) \
+    X(LineWidth) X(Viewport) X(Clear) X(ClearColor) \
+    X(GenTextures) X(BindTexture) X(TexParameteri) X(TexImage2D) \
+    X(EnableClientState) X(DisableClientState) X(VertexPointer) \
+    X(DrawArrays) X(DrawElements) X(RasterPos3f) \
+    X(GetIntegerv) X(GetFloatv) X(GetDoublev) X(Finish) X(Flush) \
+    X(ColorPointer)
+
+// ... and the GLU calls that set matrices, since GLU's own GL calls go around us:
+#define GL_GLU_LIST(X) \
+    X(Perspective) X(LookAt) X(Ortho2D)
+
+
+// every entry point gets a number; these are also the call ids in a capture file,
+//    so new ones go at the end of their list
+
+enum GLTraceId {
+#define X(type, name)   GLT_##name,
+    GL_PROC_LIST(X)
+#undef X
+#define X(name)         GLT_##name,
+    GL_CORE_LIST(X)
+    GL_GLU_LIST(X)
+#undef X
+    GLT_NCALLS
+};
+
+char const *GLT_NAMES[] = {
+#define X(type, name)   "gl" #name,
+    GL_PROC_LIST(X)
+#undef X
+#define X(name)         "gl" #name,
+    GL_CORE_LIST(X)
+#undef X
+#define X(name)         "glu" #name,
+    GL_GLU_LIST(X)
+#undef X
+};
+
+
+#include "glcapture.hpp"
+
+
+#ifdef GL_TRACE
+
+#include <stdio.h>
+
+#include <algorithm>
+#include <tuple>
+#include <type_traits>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+
+// entry points shown in each report, busiest first:
+const int GL_TRACE_TOP = 12;
+
+
+struct GLTraceList
+{
+    long    vertices, draws;
+};
+
+struct GLTrace
+{
+    long    calls[GLT_NCALLS];          // this frame
+    long    vertices, draws, stateChanges, bufferBytes;
+    long    periodCalls[GLT_NCALLS];    // since the last report
+    int     periodFrames;
+    GLuint  compiling;                  // the display list being compiled, or 0
+    bool    executing;                  // ... with GL_COMPILE_AND_EXECUTE
+    std::unordered_map<GLuint, GLTraceList> lists;
+};
+
+GLTrace GLTraceCounts;
+
+
+struct GLCoreTable
+{
+#define X(name)     decltype(&::gl##name) name;
+    GL_CORE_LIST(X)
+#undef X
+#define X(name)     decltype(&::glu##name) name;
+    GL_GLU_LIST(X)
+#undef X
+};
+
+// direct calls until loadGLProcs() puts the wrappers in:
+GLCoreTable GLCore = {
+#define X(name)     &::gl##name,
+    GL_CORE_LIST(X)
+#undef X
+#define X(name)     &::glu##name,
+    GL_GLU_LIST(X)
+#undef X
+};
+
+
+static constexpr bool glTraceIsState(int id) {
+    switch (id) {
+        case GLT_Enable:            case GLT_Disable:           case GLT_MatrixMode:
+        case GLT_Color3f:           case GLT_DepthFunc:         case GLT_DepthMask:
+        case GLT_ColorMask:         case GLT_ShadeModel:        case GLT_DrawBuffer:
+        case GLT_CullFace:          case GLT_FrontFace:         case GLT_PolygonOffset:
+        case GLT_LineWidth:         case GLT_Viewport:          case GLT_ClearColor:
+        case GLT_BindTexture:       case GLT_TexParameteri:     case GLT_EnableClientState:
+        case GLT_DisableClientState:    case GLT_VertexPointer:
+        case GLT_UseProgram:        case GLT_BindBuffer:        case GLT_BindFramebuffer:
+        case GLT_ActiveTexture:     case GLT_Uniform1i:         case GLT_Uniform1f:
+        case GLT_Uniform3f:         case GLT_Uniform4f:         case GLT_PrimitiveRestartIndex:
+        case GLT_EnableVertexAttribArray:   case GLT_DisableVertexAttribArray:
+        case GLT_VertexAttribPointer:       case GLT_BindVertexArray:
+        case GLT_BindBufferBase:    case GLT_UniformMatrix4fv:  case GLT_VertexAttrib3f:
+        case GLT_BindBufferRange:   case GLT_Uniform2f:
+        case GLT_ColorPointer:
+            return true;
+        default:
+            return false;
+    }
+}
+
+
+// vertices and draws go to the list being compiled and, unless it is only
+//    being compiled, to this frame:
+
+static void glTraceWork(long vertices, long draws) {
+    GLTrace &t = GLTraceCounts;
+    if (t.compiling != 0) {
+        GLTraceList &list = t.lists[t.compiling];
+        list.vertices += vertices;
+        list.draws += draws;
+        if (!t.executing)
+            return;
+    }
+    t.vertices += vertices;
+    t.draws += draws;
+}
+
+
+template<int ID, typename... A>
+static void glTraceCall(A... a) {
+    GLTrace &t = GLTraceCounts;
+    t.calls[ID]++;
+    if constexpr (glTraceIsState(ID))
+        t.stateChanges++;
+
+    if constexpr (ID == GLT_Vertex2f || ID == GLT_Vertex3f || ID == GLT_Vertex3fv) {
+        glTraceWork(1, 0);
+    } else if constexpr (ID == GLT_Begin) {
+        glTraceWork(0, 1);
+    } else if constexpr (ID == GLT_DrawArrays) {
+        glTraceWork(std::get<2>(std::make_tuple(a...)), 1);
+    } else if constexpr (ID == GLT_DrawElements) {
+        glTraceWork(std::get<1>(std::make_tuple(a...)), 1);
+    } else if constexpr (ID == GLT_BufferData) {
+        t.bufferBytes += std::get<1>(std::make_tuple(a...));
+    } else if constexpr (ID == GLT_BufferSubData) {
+        t.bufferBytes += std::get<2>(std::make_tuple(a...));
+    } else if constexpr (ID == GLT_NewList) {
+        auto args = std::make_tuple(a...);
+        t.compiling = std::get<0>(args);
+        t.executing = std::get<1>(args) == GL_COMPILE_AND_EXECUTE;
+        t.lists[t.compiling] = GLTraceList{};
+    } else if constexpr (ID == GLT_EndList) {
+        t.compiling = 0;
+    } else if constexpr (ID == GLT_CallList) {
+        auto it = t.lists.find(std::get<0>(std::make_tuple(a...)));
+        if (it != t.lists.end())
+            glTraceWork(it->second.vertices, it->second.draws);
+    }
+}
+
+
+// the wrapper that goes in a table in place of entry point ID, of type F:
+
+template<int ID, typename F>
+struct GLTraced;
+
+template<int ID, typename R, typename... A>
+struct GLTraced<ID, R (GLAPIENTRY *)(A...)>
+{
+    static inline R (GLAPIENTRY *real)(A...);
+
+    static R GLAPIENTRY call(A... a) {
+        glTraceCall<ID>(a...);
+        if constexpr (std::is_void_v<R>) {
+            real(a...);
+            glCaptureCall<ID>(0, a...);
+        } else {
+            R r = real(a...);
+            glCaptureCall<ID>((long)r, a...);
+            return r;
+        }
+    }
+};
+
+
+// called by loadGLProcs() once the GL table is filled in:
+
+void traceGLProcs() {
+#define X(type, name) \
+    if (GL.name != NULL) { \
+        GLTraced<GLT_##name, type>::real = GL.name; \
+        GL.name = &GLTraced<GLT_##name, type>::call; \
+    }
+    GL_PROC_LIST(X)
+#undef X
+
+#define X(name) { \
+        typedef decltype(&::gl##name) type; \
+        type proc = (type) glutGetProcAddress("gl" #name); \
+        GLTraced<GLT_##name, type>::real = proc != NULL ? proc : GLCore.name; \
+        GLCore.name = &GLTraced<GLT_##name, type>::call; \
+    }
+    GL_CORE_LIST(X)
+#undef X
+
+    // not worth looking up: glXGetProcAddress hands back a stub for any "gl..." name
+#define X(name) { \
+        typedef decltype(&::glu##name) type; \
+        GLTraced<GLT_##name, type>::real = GLCore.name; \
+        GLCore.name = &GLTraced<GLT_##name, type>::call; \
+    }
+    GL_GLU_LIST(X)
+#undef X
+
+    fprintf(stderr, "GL trace: counting %d entry points\n", (int)GLT_NCALLS);
+    captureBegin();
+}
+
+
+// once a frame: the frame's totals go into the stats, and it starts over
+
+void traceEndFrame(Stats &s) {
+    GLTrace &t = GLTraceCounts;
+    long calls = 0;
+    for (int i = 0; i < GLT_NCALLS; i++) {
+        calls += t.calls[i];
+        t.periodCalls[i] += t.calls[i];
+        t.calls[i] = 0;
+    }
+    t.periodFrames++;
+
+    statsAdd(s, STAT_GL_CALLS, calls);
+    statsAdd(s, STAT_GL_DRAW_CALLS, t.draws);
+    statsAdd(s, STAT_GL_VERTICES, t.vertices);
+    statsAdd(s, STAT_GL_STATE_CHANGES, t.stateChanges);
+    statsAdd(s, STAT_GL_BUFFER_BYTES, t.bufferBytes);
+    t.draws = t.vertices = t.stateChanges = t.bufferBytes = 0;
+    captureEndFrame();
+}
+
+
+// when the stats report: the busiest entry points, in calls per frame
+
+void traceReport(bool print) {
+    GLTrace &t = GLTraceCounts;
+    if (print && t.periodFrames > 0) {
+        std::vector<std::pair<long, int>> busiest;
+        for (int i = 0; i < GLT_NCALLS; i++)
+            if (t.periodCalls[i] > 0)
+                busiest.push_back({ -t.periodCalls[i], i });
+        std::sort(busiest.begin(), busiest.end());
+
+        fprintf(stderr, "GL calls per frame:");
+        for (int j = 0; j < (int)busiest.size() && j < GL_TRACE_TOP; j++)
+            fprintf(stderr, " %s %.1f", GLT_NAMES[busiest[j].second],
+                    (double)-busiest[j].first / t.periodFrames);
+        fprintf(stderr, "\n");
+    }
+    for (int i = 0; i < GLT_NCALLS; i++)
+        t.periodCalls[i] = 0;
+    t.periodFrames = 0;
+}
+
+
+// everything from here on calls GL 1.1 through the table:
+
+#define glBegin(...)                GLCore.Begin(__VA_ARGS__)
+#define glEnd(...)                  GLCore.End(__VA_ARGS__)
+#define glVertex2f(...)             GLCore.Vertex2f(__VA_ARGS__)
+#define glVertex3f(...)             GLCore.Vertex3f(__VA_ARGS__)
+#define glVertex3fv(...)            GLCore.Vertex3fv(__VA_ARGS__)
+#define glNewList(...)              GLCore.NewList(__VA_ARGS__)
+#define glEndList(...)              GLCore.EndList(__VA_ARGS__)
+#define glGenLists(...)             GLCore.GenLists(__VA_ARGS__)
+#define glCallList(...)             GLCore.CallList(__VA_ARGS__)
+#define glPushMatrix(...)           GLCore.PushMatrix(__VA_ARGS__)
+#define glPopMatrix(...)            GLCore.PopMatrix(__VA_ARGS__)
+#define glLoadIdentity(...)         GLCore.LoadIdentity(__VA_ARGS__)
+#define glMultMatrixf(...)          GLCore.MultMatrixf(__VA_ARGS__)
+#define glRotatef(...)              GLCore.Rotatef(__VA_ARGS__)
+#define glTranslatef(...)           GLCore.Translatef(__VA_ARGS__)
+#define glScalef(...)               GLCore.Scalef(__VA_ARGS__)
+#define glMatrixMode(...)           GLCore.MatrixMode(__VA_ARGS__)
+#define glColor3f(...)              GLCore.Color3f(__VA_ARGS__)
+#define glEnable(...)               GLCore.Enable(__VA_ARGS__)
+#define glDisable(...)              GLCore.Disable(__VA_ARGS__)
+#define glDepthFunc(...)            GLCore.DepthFunc(__VA_ARGS__)
+#define glDepthMask(...)            GLCore.DepthMask(__VA_ARGS__)
+#define glColorMask(...)            GLCore.ColorMask(__VA_ARGS__)
+#define glShadeModel(...)           GLCore.ShadeModel(__VA_ARGS__)
+#define glDrawBuffer(...)           GLCore.DrawBuffer(__VA_ARGS__)
+#define glCullFace(...)             GLCore.CullFace(__VA_ARGS__)
+#define glFrontFace(...)            GLCore.FrontFace(__VA_ARGS__)
+#define glPolygonOffset(...)        GLCore.PolygonOffset(__VA_ARGS__)
+#define glLineWidth(...)            GLCore.LineWidth(__VA_ARGS__)
+#define glViewport(...)             GLCore.Viewport(__VA_ARGS__)
+#define glClear(...)                GLCore.Clear(__VA_ARGS__)
+#define glClearColor(...)           GLCore.ClearColor(__VA_ARGS__)
+#define glGenTextures(...)          GLCore.GenTextures(__VA_ARGS__)
+#define glBindTexture(...)          GLCore.BindTexture(__VA_ARGS__)
+#define glTexParameteri(...)        GLCore.TexParameteri(__VA_ARGS__)
+#define glTexImage2D(...)           GLCore.TexImage2D(__VA_ARGS__)
+#define glEnableClientState(...)    GLCore.EnableClientState(__VA_ARGS__)
+#define glDisableClientState(...)   GLCore.DisableClientState(__VA_ARGS__)
+#define glVertexPointer(...)        GLCore.VertexPointer(__VA_ARGS__)
+#define glDrawArrays(...)           GLCore.DrawArrays(__VA_ARGS__)
+#define glDrawElements(...)         GLCore.DrawElements(__VA_ARGS__)
+#define glRasterPos3f(...)          GLCore.RasterPos3f(__VA_ARGS__)
+#define glGetIntegerv(...)          GLCore.GetIntegerv(__VA_ARGS__)
+#define glGetFloatv(...)            GLCore.GetFloatv(__VA_ARGS__)
+#define glGetDoublev(...)           GLCore.GetDoublev(__VA_ARGS__)
+#define glFinish(...)               GLCore.Finish(__VA_ARGS__)
+#define glFlush(...)                GLCore.Flush(__VA_ARGS__)
+#define glColorPointer(...)         GLCore.ColorPointer(__VA_ARGS__)
+#define gluPerspective(...)         GLCore.Perspective(__VA_ARGS__)
+#define gluLookAt(...)              GLCore.LookAt(__VA_ARGS__)
+#define gluOrtho2D(...)             GLCore.Ortho2D(__VA_ARGS__)
+
+
+#else
+
+
+void traceGLProcs() { }
+void traceEndFrame(Stats &) { }
+void traceReport(bool) { }
+
+
+#endif /* GL_TRACE */
+
+#endif /* gltrace_hpp */
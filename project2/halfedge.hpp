@@ -0,0 +1,232 @@
+//
+//  halfedge.hpp
+//  project2
+//
+//  Half-edge adjacency for a triangle mesh, used to draw only the edges
+//    that matter: feature (crease and boundary) edges, found once from
+//    the dihedral angle, and silhouette edges, found every frame from
+//    which faces point toward the eye.  The silhouette is found in
+//    chunks on the job threads: the facing test four faces at a time,
+//    then each chunk of edges into a list of its own, and the lists put
+//    back to back.
+//
+
+#ifndef halfedge_hpp
+#define halfedge_hpp
+
+#include <math.h>
+#include <stdio.h>
+
+#include <algorithm>
+#include <unordered_map>
+#include <vector>
+
+#include "jobs.hpp"
+#include "simd4.hpp"
+
+
+// edges whose faces bend more than this many degrees are creases:
+const float FEATURE_ANGLE = 45.f;
+
+// faces or edges in a chunk of the silhouette search, a multiple of 4:
+const int SILHOUETTE_GRAIN = 1024;
+
+
+struct HalfEdge
+{
+    int vert;       // vertex this half-edge starts at
+    int next;       // next half-edge around the face
+    int twin;       // the matching half-edge of the neighboring face, or -1
+};
+
+
+struct HalfEdgeMesh
+{
+    std::vector<HalfEdge> halfEdges;    // 3 per face, face f owns 3f, 3f+1, 3f+2
+
+    // one entry per undirected edge that has two faces:
+    std::vector<int>  edgeFace0, edgeFace1;
+    std::vector<char> edgeFlip;         // != 0 if the two faces are wound the opposite way
+    std::vector<int>  edgeP0, edgeP1;
+
+    int nonManifold;                    // edges with more than two faces
+
+    // face planes, one array per component so the facing test goes four at a time:
+    std::vector<float> nx, ny, nz, d;
+    std::vector<unsigned char> facing;  // scratch for the silhouette test
+
+    std::vector<GLuint> featureIndices; // GL_LINES pairs, computed once
+    std::vector<GLuint> silhouetteIndices;  // GL_LINES pairs, recomputed per view
+    std::vector<std::vector<GLuint>> silhouetteChunks;  // ... what each chunk of edges found
+};
+
+
+HalfEdgeMesh buildHalfEdgeMesh(struct point const *points, struct tri const *tris, int ntris) {
+    HalfEdgeMesh hm;
+    hm.nonManifold = 0;
+    hm.halfEdges.resize(3*ntris);
+    hm.nx.resize(ntris);
+    hm.ny.resize(ntris);
+    hm.nz.resize(ntris);
+    hm.d.resize(ntris);
+    hm.facing.resize(ntris);
+
+    // half-edges and face planes:
+
+    for (int f = 0; f < ntris; f++) {
+        int v[3] = { tris[f].p0, tris[f].p1, tris[f].p2 };
+        for (int k = 0; k < 3; k++) {
+            HalfEdge &he = hm.halfEdges[3*f + k];
+            he.vert = v[k];
+            he.next = 3*f + (k + 1) % 3;
+            he.twin = -1;
+        }
+
+        struct point const &p0 = points[v[0]], &p1 = points[v[1]], &p2 = points[v[2]];
+        float u[3] = { p1.x-p0.x, p1.y-p0.y, p1.z-p0.z };
+        float w[3] = { p2.x-p0.x, p2.y-p0.y, p2.z-p0.z };
+        float n[3] = { u[1]*w[2]-u[2]*w[1], u[2]*w[0]-u[0]*w[2], u[0]*w[1]-u[1]*w[0] };
+        float len = sqrtf(n[0]*n[0] + n[1]*n[1] + n[2]*n[2]);
+        if (len > 0.f) {
+            n[0] /= len;
+            n[1] /= len;
+            n[2] /= len;
+        }
+        hm.nx[f] = n[0];
+        hm.ny[f] = n[1];
+        hm.nz[f] = n[2];
+        hm.d[f] = -(n[0]*p0.x + n[1]*p0.y + n[2]*p0.z);
+    }
+
+    // pair up the half-edges of each undirected edge; the winding does not
+    //    have to agree, so (a,b) can pair with (b,a) or with another (a,b)
+
+    std::unordered_map<unsigned long long, std::vector<int>> byEdge;
+    byEdge.reserve(3*ntris);
+    for (int h = 0; h < 3*ntris; h++) {
+        int a = hm.halfEdges[h].vert, b = hm.halfEdges[hm.halfEdges[h].next].vert;
+        if (a > b) std::swap(a, b);
+        byEdge[((unsigned long long)a << 32) | (unsigned)b].push_back(h);
+    }
+
+    float cosFeature = cosf(FEATURE_ANGLE * (float)M_PI / 180.f);
+    for (auto const &entry : byEdge) {
+        std::vector<int> const &hs = entry.second;
+        int a = (int)(entry.first >> 32), b = (int)(entry.first & 0xffffffff);
+
+        if (hs.size() != 2) {
+            // boundary or non-manifold: always a feature
+            if (hs.size() > 2)
+                hm.nonManifold++;
+            hm.featureIndices.push_back(a);
+            hm.featureIndices.push_back(b);
+            continue;
+        }
+
+        int h0 = hs[0], h1 = hs[1];
+        hm.halfEdges[h0].twin = h1;
+        hm.halfEdges[h1].twin = h0;
+
+        int f0 = h0 / 3, f1 = h1 / 3;
+        bool flip = hm.halfEdges[h0].vert == hm.halfEdges[h1].vert;
+        hm.edgeFace0.push_back(f0);
+        hm.edgeFace1.push_back(f1);
+        hm.edgeFlip.push_back(flip);
+        hm.edgeP0.push_back(a);
+        hm.edgeP1.push_back(b);
+
+        float c = hm.nx[f0]*hm.nx[f1] + hm.ny[f0]*hm.ny[f1] + hm.nz[f0]*hm.nz[f1];
+        if (flip)
+            c = -c;
+        if (c < cosFeature) {
+            hm.featureIndices.push_back(a);
+            hm.featureIndices.push_back(b);
+        }
+    }
+
+    fprintf(stderr, "Half-edge mesh: %d faces, %zu shared edges, %zu feature edges, %d non-manifold\n",
+            ntris, hm.edgeFace0.size(), hm.featureIndices.size()/2, hm.nonManifold);
+    return hm;
+}
+
+
+// find the silhouette edges as seen from an eye point given in model coordinates:
+
+void computeSilhouette(HalfEdgeMesh &hm, float const eye[3]) {
+    int nfaces = (int)hm.nx.size();
+    float const *nx = hm.nx.data(), *ny = hm.ny.data(), *nz = hm.nz.data(), *d = hm.d.data();
+    unsigned char *facing = hm.facing.data();
+    float ex = eye[0], ey = eye[1], ez = eye[2];
+
+    int faceChunks = (nfaces + SILHOUETTE_GRAIN - 1) / SILHOUETTE_GRAIN;
+    parallelFor(0, faceChunks, 1, [&](int first, int last) {
+        SimdFloat4 vx = simdSplat(ex), vy = simdSplat(ey), vz = simdSplat(ez), zero = simdSplat(0.f);
+        int end = std::min(nfaces, last * SILHOUETTE_GRAIN);
+        int f = first * SILHOUETTE_GRAIN;
+        for (; f + 4 <= end; f += 4) {
+            SimdFloat4 s = simdAdd(simdAdd(simdMul(simdLoad(nx + f), vx), simdMul(simdLoad(ny + f), vy)),
+                                   simdAdd(simdMul(simdLoad(nz + f), vz), simdLoad(d + f)));
+            int bits = simdBits(simdGT(s, zero));
+            for (int k = 0; k < 4; k++)
+                facing[f + k] = (bits >> k) & 1;
+        }
+        for (; f < end; f++)
+            facing[f] = nx[f]*ex + ny[f]*ey + nz[f]*ez + d[f] > 0.f;
+    });
+
+    int nedges = (int)hm.edgeFace0.size();
+    int edgeChunks = (nedges + SILHOUETTE_GRAIN - 1) / SILHOUETTE_GRAIN;
+    if ((int)hm.silhouetteChunks.size() < edgeChunks)
+        hm.silhouetteChunks.resize(edgeChunks);
+    parallelFor(0, edgeChunks, 1, [&](int first, int last) {
+        for (int c = first; c < last; c++) {
+            std::vector<GLuint> &out = hm.silhouetteChunks[c];
+            out.clear();
+            int end = std::min(nedges, (c + 1) * SILHOUETTE_GRAIN);
+            for (int e = c * SILHOUETTE_GRAIN; e < end; e++) {
+                // faces wound the opposite way face the eye when their test says they don't:
+                if ((facing[hm.edgeFace0[e]] ^ facing[hm.edgeFace1[e]] ^ hm.edgeFlip[e]) != 0) {
+                    out.push_back(hm.edgeP0[e]);
+                    out.push_back(hm.edgeP1[e]);
+                }
+            }
+        }
+    });
+
+    hm.silhouetteIndices.clear();
+    for (int c = 0; c < edgeChunks; c++)
+        hm.silhouetteIndices.insert(hm.silhouetteIndices.end(), hm.silhouetteChunks[c].begin(), hm.silhouetteChunks[c].end());
+}
+
+
+// the eye position in the coordinates a modelview matrix starts from:
+
+void eyeFromModelview(GLfloat const m[16], float eye[3]) {
+    // invert the upper 3x3 (column-major) and apply it to -translation:
+    float a = m[0], b = m[4], c = m[8];
+    float e = m[1], f = m[5], g = m[9];
+    float h = m[2], i = m[6], j = m[10];
+    float det = a*(f*j - g*i) - b*(e*j - g*h) + c*(e*i - f*h);
+    if (det == 0.f) {
+        eye[0] = eye[1] = eye[2] = 0.f;
+        return;
+    }
+    float inv[9] = {
+        (f*j - g*i)/det, (c*i - b*j)/det, (b*g - c*f)/det,
+        (g*h - e*j)/det, (a*j - c*h)/det, (c*e - a*g)/det,
+        (e*i - f*h)/det, (b*h - a*i)/det, (a*f - b*e)/det
+    };
+    float t[3] = { -m[12], -m[13], -m[14] };
+    for (int r = 0; r < 3; r++)
+        eye[r] = inv[3*r]*t[0] + inv[3*r + 1]*t[1] + inv[3*r + 2]*t[2];
+}
+
+// ... of the current one:
+void eyeInModelCoordinates(float eye[3]) {
+    GLfloat m[16];
+    glGetFloatv(GL_MODELVIEW_MATRIX, m);
+    eyeFromModelview(m, eye);
+}
+
+
+#endif /* halfedge_hpp */
@@ -0,0 +1,53 @@
+//
+//  inputqueue.hpp
+//  project2
+//
+//  Mouse motion collected between frames and applied once, just before the
+//    next frame is drawn, however many events came in.  Drags are summed
+//    by which buttons were down when they happened, so a button let go
+//    partway through still splits them right; for hovering, only where the
+//    mouse ended up matters.
+//
+
+#ifndef inputqueue_hpp
+#define inputqueue_hpp
+
+
+// every combination of the three mouse buttons:
+const int INPUT_BUTTON_SETS = 8;
+
+
+struct InputQueue
+{
+    int     dragX[INPUT_BUTTON_SETS];   // summed motion, by the buttons that were down
+    int     dragY[INPUT_BUTTON_SETS];
+    bool    hovered;                    // moved with no button down ...
+    int     hoverX, hoverY;             // ... to here
+    int     events;                     // motion events folded in
+};
+
+
+// true if this is the first event since the last inputTake():
+bool inputDrag(InputQueue &q, int buttons, int dx, int dy) {
+    q.dragX[buttons % INPUT_BUTTON_SETS] += dx;
+    q.dragY[buttons % INPUT_BUTTON_SETS] += dy;
+    return ++q.events == 1;
+}
+
+bool inputHover(InputQueue &q, int x, int y) {
+    q.hovered = true;
+    q.hoverX = x;
+    q.hoverY = y;
+    return ++q.events == 1;
+}
+
+
+// what has come in since last time, and start over:
+InputQueue inputTake(InputQueue &q) {
+    InputQueue taken = q;
+    q = InputQueue{};
+    return taken;
+}
+
+
+#endif /* inputqueue_hpp */
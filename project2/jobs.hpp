@@ -0,0 +1,441 @@
+//
+//  jobs.hpp
+//  project2
+//
+//  Work-stealing jobs, for everything that wants more than one core.  A
+//    few worker threads are started once; every thread that hands out
+//    jobs (the GL thread, the simulation, the workers themselves) gets a
+//    Chase-Lev deque of its own: it pushes and pops at the bottom without
+//    a lock, and any other thread with nothing to do steals from the top.
+//    - parallelFor() works through a range a grain at a time, and whenever
+//      its own deque has run empty (someone stole what was there) it
+//      offers the top half of what is left.  So a range is only cut up as
+//      far as there are idle threads to take the pieces, and no further
+//      than the grain, which is picked from the range and the number of
+//      threads if the caller does not give one.
+//    - jobRun() queues a single job that counts down a JobCounter when
+//      done, and jobWait() returns once a counter is down to zero.
+//    - A thread waiting for its jobs runs jobs itself meanwhile, its own
+//      first and then anyone's, so the GL thread works alongside the
+//      workers rather than sitting idle.
+//  Each thread's time spent running jobs, and how many it ran and stole,
+//    is printed with the stats, to show how evenly the work spreads.
+//
+
+#ifndef jobs_hpp
+#define jobs_hpp
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+
+
+// threads with a deque: the workers, plus every other one that hands out jobs
+const int JOB_MAX_THREADS = 64;
+
+// jobs one thread can have queued, a power of two:
+const long JOB_DEQUE_SIZE = 4096;
+
+// times an idle worker looks for something to steal before it sleeps ...
+const int JOB_IDLE_SPINS = 64;
+
+// ... and the longest it sleeps before looking again, in ms:
+const int JOB_SLEEP_MS = 10;
+
+// pieces per thread parallelFor() aims for when it picks the grain:
+const int JOB_PIECES_PER_THREAD = 8;
+
+
+struct JobCounter
+{
+    std::atomic<int> pending{ 0 };      // jobs not finished yet
+};
+
+struct Job
+{
+    void  (*fn)(void *ctx, int first, int last);
+    void   *ctx;
+    int     first, last;                // a range, for parallelFor()
+    int     grain;                      // ... run a piece this big at a time, or 0 if it is a single job
+    JobCounter *counter;
+};
+
+
+// Chase and Lev's deque, as Le, Pop, Cohen and Zappa Nardelli put it in C11
+//    atomics (but a fixed size: a push that does not fit fails, and the
+//    caller runs the job itself)
+
+struct JobDeque
+{
+    std::atomic<long> top, bottom;
+    std::atomic<Job *> slots[JOB_DEQUE_SIZE];
+};
+
+static bool dequePush(JobDeque &q, Job *job) {
+    long b = q.bottom.load(std::memory_order_relaxed);
+    long t = q.top.load(std::memory_order_acquire);
+    if (b - t >= JOB_DEQUE_SIZE)
+        return false;
+    q.slots[b & (JOB_DEQUE_SIZE - 1)].store(job, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+    q.bottom.store(b + 1, std::memory_order_relaxed);
+    return true;
+}
+
+// the owner's end:
+static Job *dequePop(JobDeque &q) {
+    long b = q.bottom.load(std::memory_order_relaxed) - 1;
+    q.bottom.store(b, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    long t = q.top.load(std::memory_order_relaxed);
+    if (t > b) {
+        q.bottom.store(b + 1, std::memory_order_relaxed);
+        return NULL;
+    }
+    Job *job = q.slots[b & (JOB_DEQUE_SIZE - 1)].load(std::memory_order_relaxed);
+    if (t == b) {
+        // the last one: a thief may be after it too
+        if (!q.top.compare_exchange_strong(t, t + 1, std::memory_order_seq_cst, std::memory_order_relaxed))
+            job = NULL;
+        q.bottom.store(b + 1, std::memory_order_relaxed);
+    }
+    return job;
+}
+
+// everyone else's:
+static Job *dequeSteal(JobDeque &q) {
+    long t = q.top.load(std::memory_order_acquire);
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    long b = q.bottom.load(std::memory_order_acquire);
+    if (t >= b)
+        return NULL;
+    Job *job = q.slots[t & (JOB_DEQUE_SIZE - 1)].load(std::memory_order_relaxed);
+    if (!q.top.compare_exchange_strong(t, t + 1, std::memory_order_seq_cst, std::memory_order_relaxed))
+        return NULL;
+    return job;
+}
+
+static bool dequeEmpty(JobDeque &q) {
+    return q.bottom.load(std::memory_order_relaxed) <= q.top.load(std::memory_order_acquire);
+}
+
+
+struct alignas(64) JobThread
+{
+    JobDeque deque;
+    std::atomic<bool> taken;
+    char    name[24];
+
+    // since the last jobReport():
+    std::atomic<long> busyNs, jobs, steals;
+};
+
+struct JobSystem
+{
+    JobThread threads[JOB_MAX_THREADS]; // the GL thread, then the workers, then whoever else
+    int     workers;
+    std::thread *pool;
+    std::atomic<bool> running;
+    std::atomic<int> highest;           // threads[] past this have never been taken
+
+    // for waking sleeping workers:
+    std::atomic<unsigned> pushes;
+    std::atomic<int> sleepers;
+    std::mutex mutex;
+    std::condition_variable wake;
+
+    std::chrono::steady_clock::time_point reported;
+};
+
+JobSystem Jobs;
+
+
+// which threads[] the calling thread has, given back when it exits:
+struct JobSlot
+{
+    int     index = -1;
+    ~JobSlot() {
+        if (index >= 0)
+            Jobs.threads[index].taken.store(false, std::memory_order_release);
+    }
+};
+
+static thread_local JobSlot JobSelf;
+
+// the calling thread's, taking a free one the first time; -1 if there is none
+//    left, and it runs its jobs itself
+
+static int jobSelf() {
+    if (JobSelf.index >= 0 || !Jobs.running.load(std::memory_order_acquire))
+        return JobSelf.index;
+    for (int i = Jobs.workers + 1; i < JOB_MAX_THREADS; i++) {
+        bool taken = false;
+        if (Jobs.threads[i].taken.compare_exchange_strong(taken, true)) {
+            JobSelf.index = i;
+            snprintf(Jobs.threads[i].name, sizeof(Jobs.threads[i].name), "thread %d", i);
+            int highest = Jobs.highest.load();
+            while (highest < i && !Jobs.highest.compare_exchange_weak(highest, i))
+                ;
+            break;
+        }
+    }
+    return JobSelf.index;
+}
+
+// what the calling thread is called in the report:
+void jobThreadName(char const *name) {
+    int self = jobSelf();
+    if (self >= 0)
+        snprintf(Jobs.threads[self].name, sizeof(Jobs.threads[self].name), "%s", name);
+}
+
+
+static bool jobPush(int self, Job *job) {
+    if (!dequePush(Jobs.threads[self].deque, job))
+        return false;
+    Jobs.pushes.fetch_add(1, std::memory_order_seq_cst);
+    if (Jobs.sleepers.load(std::memory_order_seq_cst) > 0) {
+        std::lock_guard<std::mutex> lock(Jobs.mutex);
+        Jobs.wake.notify_one();
+    }
+    return true;
+}
+
+// our own newest job, or else someone's oldest:
+static Job *jobFind(int self) {
+    Job *job = dequePop(Jobs.threads[self].deque);
+    if (job != NULL)
+        return job;
+
+    static thread_local unsigned victim;
+    int n = Jobs.highest.load(std::memory_order_relaxed) + 1;
+    for (int k = 0; k < n; k++) {
+        int i = (int)(victim++ % n);
+        if (i == self)
+            continue;
+        job = dequeSteal(Jobs.threads[i].deque);
+        if (job != NULL) {
+            Jobs.threads[self].steals.fetch_add(1, std::memory_order_relaxed);
+            return job;
+        }
+    }
+    return NULL;
+}
+
+// jobs run inside other jobs (while they wait for theirs) are already on the clock:
+static thread_local int JobDepth;
+
+static void jobExecute(int self, Job *job) {
+    auto start = std::chrono::steady_clock::now();
+    JobThread &me = Jobs.threads[self];
+    JobDepth++;
+    if (job->grain == 0) {
+        job->fn(job->ctx, job->first, job->last);
+    } else {
+        int first = job->first, last = job->last;
+        while (first < last) {
+            // nothing queued here for a thief to take: offer the top half of what is left
+            if (last - first >= 2 * job->grain && dequeEmpty(me.deque)) {
+                int mid = first + (last - first) / 2;
+                Job *rest = new Job(*job);
+                rest->first = mid;
+                rest->last = last;
+                job->counter->pending.fetch_add(1, std::memory_order_relaxed);
+                if (jobPush(self, rest)) {
+                    last = mid;
+                } else {
+                    job->counter->pending.fetch_sub(1, std::memory_order_relaxed);
+                    delete rest;
+                }
+            }
+            int step = std::min(job->grain, last - first);
+            job->fn(job->ctx, first, first + step);
+            first += step;
+        }
+    }
+    if (--JobDepth == 0)
+        me.busyNs.fetch_add(std::chrono::duration_cast<std::chrono::nanoseconds>(
+                            std::chrono::steady_clock::now() - start).count(), std::memory_order_relaxed);
+    me.jobs.fetch_add(1, std::memory_order_relaxed);
+    job->counter->pending.fetch_sub(1, std::memory_order_release);
+    delete job;
+}
+
+
+// return once every job counted by counter is done, running jobs meanwhile:
+void jobWait(JobCounter &counter) {
+    int self = jobSelf();
+    while (counter.pending.load(std::memory_order_acquire) > 0) {
+        Job *job = self >= 0 ? jobFind(self) : NULL;
+        if (job != NULL)
+            jobExecute(self, job);
+        else
+            std::this_thread::yield();
+    }
+}
+
+
+template <typename Fn>
+static void jobCall(void *ctx, int, int) {
+    (*(Fn *)ctx)();
+}
+
+// queue fn() to run on whichever thread gets to it first; fn must last
+//    until jobWait(counter) has returned
+
+template <typename Fn>
+void jobRun(JobCounter &counter, Fn &fn) {
+    int self = jobSelf();
+    if (Jobs.workers == 0 || self < 0) {
+        fn();
+        return;
+    }
+    Job *job = new Job{ jobCall<Fn>, (void *)&fn, 0, 0, 0, &counter };
+    counter.pending.fetch_add(1, std::memory_order_relaxed);
+    if (!jobPush(self, job)) {
+        counter.pending.fetch_sub(1, std::memory_order_relaxed);
+        delete job;
+        fn();
+    }
+}
+
+
+template <typename Fn>
+static void jobCallRange(void *ctx, int first, int last) {
+    (*(Fn const *)ctx)(first, last);
+}
+
+// fn(first, last) over pieces of [first, last), at least grain long (or 0 to
+//    pick), spread over whichever threads are free; returns when all are done
+
+template <typename Fn>
+void parallelFor(int first, int last, int grain, Fn const &fn) {
+    int self = jobSelf();
+    if (grain <= 0)
+        grain = std::max(1, (last - first) / (JOB_PIECES_PER_THREAD * (Jobs.workers + 1)));
+    if (Jobs.workers == 0 || self < 0 || last - first < 2 * grain) {
+        if (first < last)
+            fn(first, last);
+        return;
+    }
+
+    // start on it here; the rest of the range goes out as it is asked for
+    JobCounter counter;
+    counter.pending.store(1, std::memory_order_relaxed);
+    jobExecute(self, new Job{ jobCallRange<Fn>, (void *)&fn, first, last, grain, &counter });
+    jobWait(counter);
+}
+
+
+static void jobWorker(int self) {
+    JobSelf.index = self;
+    int idle = 0;
+    while (Jobs.running.load(std::memory_order_acquire)) {
+        unsigned pushes = Jobs.pushes.load(std::memory_order_seq_cst);
+        Job *job = jobFind(self);
+        if (job != NULL) {
+            jobExecute(self, job);
+            idle = 0;
+            continue;
+        }
+        if (++idle < JOB_IDLE_SPINS) {
+            std::this_thread::yield();
+            continue;
+        }
+
+        // nothing anywhere: sleep until something is pushed
+        std::unique_lock<std::mutex> lock(Jobs.mutex);
+        Jobs.sleepers.fetch_add(1, std::memory_order_seq_cst);
+        Jobs.wake.wait_for(lock, std::chrono::milliseconds(JOB_SLEEP_MS), [&] {
+            return Jobs.pushes.load(std::memory_order_seq_cst) != pushes || !Jobs.running.load();
+        });
+        Jobs.sleepers.fetch_sub(1, std::memory_order_relaxed);
+        idle = 0;
+    }
+}
+
+
+void stopJobs() {
+    if (Jobs.pool == NULL)
+        return;
+    Jobs.running.store(false, std::memory_order_release);
+    {
+        std::lock_guard<std::mutex> lock(Jobs.mutex);
+        Jobs.wake.notify_all();
+    }
+    for (int i = 0; i < Jobs.workers; i++)
+        Jobs.pool[i].join();
+    delete[] Jobs.pool;
+    Jobs.pool = NULL;
+    Jobs.workers = 0;
+}
+
+// the calling thread becomes the first of the threads[]; workers < 0 for
+//    one per core besides it
+
+void startJobs(int workers) {
+    if (Jobs.running.load())
+        return;
+    if (workers < 0)
+        workers = (int)std::thread::hardware_concurrency() - 1;
+    workers = std::max(0, std::min(workers, JOB_MAX_THREADS / 2));
+
+    Jobs.workers = workers;
+    Jobs.highest.store(workers);
+    Jobs.reported = std::chrono::steady_clock::now();
+    JobSelf.index = 0;
+    Jobs.threads[0].taken.store(true);
+    snprintf(Jobs.threads[0].name, sizeof(Jobs.threads[0].name), "main");
+    for (int i = 1; i <= workers; i++) {
+        Jobs.threads[i].taken.store(true);
+        snprintf(Jobs.threads[i].name, sizeof(Jobs.threads[i].name), "worker %d", i);
+    }
+    Jobs.running.store(true, std::memory_order_release);
+    Jobs.pool = new std::thread[workers];
+    for (int i = 0; i < workers; i++)
+        Jobs.pool[i] = std::thread(jobWorker, i + 1);
+    atexit(stopJobs);
+    fprintf(stderr, "Jobs: %d worker thread%s\n", workers, workers == 1 ? "" : "s");
+}
+
+
+// with the stats, every second or so: how busy each thread was with jobs
+//    since last time, and how far the busiest was from the average
+
+void jobReport(bool print) {
+    auto now = std::chrono::steady_clock::now();
+    double wallNs = std::chrono::duration<double, std::nano>(now - Jobs.reported).count();
+    Jobs.reported = now;
+
+    int n = Jobs.highest.load() + 1;
+    long busy[JOB_MAX_THREADS], jobs[JOB_MAX_THREADS], steals[JOB_MAX_THREADS];
+    long total = 0, most = 0, used = 0;
+    for (int i = 0; i < n; i++) {
+        busy[i] = Jobs.threads[i].busyNs.exchange(0, std::memory_order_relaxed);
+        jobs[i] = Jobs.threads[i].jobs.exchange(0, std::memory_order_relaxed);
+        steals[i] = Jobs.threads[i].steals.exchange(0, std::memory_order_relaxed);
+        total += busy[i];
+        most = std::max(most, busy[i]);
+        used += jobs[i] > 0;
+    }
+    if (!print || !Jobs.running.load() || total == 0 || wallNs <= 0.)
+        return;
+
+    fprintf(stderr, "Jobs:");
+    for (int i = 0; i < n; i++) {
+        if (jobs[i] == 0 && i > Jobs.workers)
+            continue;
+        fprintf(stderr, "%s %s %.1f%% (%ld jobs, %ld stolen)", i == 0 ? "" : ",", Jobs.threads[i].name,
+                100. * busy[i] / wallNs, jobs[i], steals[i]);
+    }
+    fprintf(stderr, "; busiest %.2fx the average\n", (double)most * used / total);
+}
+
+
+#endif /* jobs_hpp */
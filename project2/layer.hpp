@@ -0,0 +1,172 @@
+//
+//  layer.hpp
+//  project2
+//
+//  A cached layer of the scene: what does not move is drawn once into an
+//    offscreen framebuffer (colour and depth textures) and, for as long as
+//    the view and everything else in the key stay the same, just copied
+//    back each frame -- colour and depth both, so the moving objects drawn
+//    afterwards are still hidden behind it correctly.
+//  The layer is always drawn at the window's viewport size and stretched
+//    over whatever viewport it is copied into, so dynamic resolution
+//    changing the size every frame neither reallocates nor redraws it.
+//
+
+#ifndef layer_hpp
+#define layer_hpp
+
+#include <stdio.h>
+#include <string.h>
+
+#include <vector>
+
+#include "glproc.hpp"
+#include "glstate.hpp"
+
+
+struct CachedLayer
+{
+    bool    ready;              // the context can do this
+    bool    valid;              // the textures hold what the key describes
+    GLuint  fbo;
+    GLint   outer;              // the framebuffer bound when we started drawing the layer
+    GLuint  color, depth;       // textures
+    int     size[2];            // what the textures were made for, and the layer is drawn at
+    std::vector<char> key;      // whatever the layer's pixels depend on
+    GLuint  program;
+    GLint   uColor, uDepth;
+};
+
+
+static char const *LAYER_VERTEX_SHADER =
+    "#version 120\n"
+    "varying vec2 vUV;\n"
+    "void main() {\n"
+    "    gl_Position = gl_Vertex;\n"
+    "    vUV = gl_Vertex.xy * .5 + .5;\n"
+    "}\n";
+
+static char const *LAYER_FRAGMENT_SHADER =
+    "#version 120\n"
+    "uniform sampler2D uColor;\n"
+    "uniform sampler2D uDepth;\n"
+    "varying vec2 vUV;\n"
+    "void main() {\n"
+    "    gl_FragColor = texture2D(uColor, vUV);\n"
+    "    gl_FragDepth = texture2D(uDepth, vUV).r;\n"
+    "}\n";
+
+
+bool initCachedLayer(CachedLayer &layer) {
+    layer = CachedLayer{};
+    if (GL.GenFramebuffers == NULL || GL.ActiveTexture == NULL || GL.CreateProgram == NULL ||
+        !(glVersionAtLeast(3, 0) || hasGLExtension("GL_ARB_framebuffer_object")))
+        return false;
+
+    char const *attribs[] = { NULL };
+    layer.program = createProgram(LAYER_VERTEX_SHADER, LAYER_FRAGMENT_SHADER, attribs);
+    if (layer.program == 0)
+        return false;
+    layer.uColor = GL.GetUniformLocation(layer.program, "uColor");
+    layer.uDepth = GL.GetUniformLocation(layer.program, "uDepth");
+
+    GL.GenFramebuffers(1, &layer.fbo);
+    glGenTextures(1, &layer.color);
+    glGenTextures(1, &layer.depth);
+    layer.ready = true;
+    return true;
+}
+
+
+static void layerResize(CachedLayer &layer, int width, int height) {
+    GLuint textures[2] = { layer.color, layer.depth };
+    for (int i = 0; i < 2; i++) {
+        // shrunk to a smaller viewport, colour is averaged but depth has to be one of the texels:
+        glBindTexture(GL_TEXTURE_2D, textures[i]);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, i == 0 ? GL_LINEAR : GL_NEAREST);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+        if (i == 0)
+            glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8, width, height, 0, GL_RGBA, GL_UNSIGNED_BYTE, NULL);
+        else
+            glTexImage2D(GL_TEXTURE_2D, 0, GL_DEPTH_COMPONENT24, width, height, 0, GL_DEPTH_COMPONENT, GL_UNSIGNED_INT, NULL);
+    }
+    glBindTexture(GL_TEXTURE_2D, 0);
+
+    GLint outer;
+    glGetIntegerv(GL_FRAMEBUFFER_BINDING, &outer);
+    GL.BindFramebuffer(GL_FRAMEBUFFER, layer.fbo);
+    GL.FramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, layer.color, 0);
+    GL.FramebufferTexture2D(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_TEXTURE_2D, layer.depth, 0);
+    if (GL.CheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE) {
+        fprintf(stderr, "Cached layer: framebuffer is not complete, turning it off\n");
+        layer.ready = false;
+    }
+    GL.BindFramebuffer(GL_FRAMEBUFFER, outer);
+
+    layer.size[0] = width;
+    layer.size[1] = height;
+}
+
+
+// for a layer of size[0] x size[1]; returns true if the layer has to be
+//    redrawn: it is then bound, cleared and its viewport set, and the
+//    caller draws into it and calls endCachedLayer(); false if it is up
+//    to date, or if resizing it failed, which leaves layer.ready false and
+//    the caller drawing without it
+
+bool beginCachedLayer(CachedLayer &layer, int const size[2], void const *key, size_t keySize) {
+    if (size[0] != layer.size[0] || size[1] != layer.size[1]) {
+        layerResize(layer, size[0], size[1]);
+        layer.valid = false;
+        if (!layer.ready)
+            return false;
+    }
+    if (layer.valid && layer.key.size() == keySize && memcmp(layer.key.data(), key, keySize) == 0)
+        return false;
+
+    layer.key.assign((char const *)key, (char const *)key + keySize);
+    glGetIntegerv(GL_FRAMEBUFFER_BINDING, &layer.outer);
+    GL.BindFramebuffer(GL_FRAMEBUFFER, layer.fbo);
+    glViewport(0, 0, layer.size[0], layer.size[1]);
+    glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+    return true;
+}
+
+// back to wherever we were drawing, whose viewport was the one given:
+void endCachedLayer(CachedLayer &layer, GLint const viewport[4]) {
+    GL.BindFramebuffer(GL_FRAMEBUFFER, layer.outer);
+    glViewport(viewport[0], viewport[1], viewport[2], viewport[3]);
+    layer.valid = true;
+}
+
+
+// copy the colour and depth into the current viewport, scaled to fit it:
+void drawCachedLayer(CachedLayer const &layer) {
+    GL.UseProgram(layer.program);
+    GL.Uniform1i(layer.uColor, 0);
+    GL.Uniform1i(layer.uDepth, 1);
+    GL.ActiveTexture(GL_TEXTURE1);
+    glBindTexture(GL_TEXTURE_2D, layer.depth);
+    GL.ActiveTexture(GL_TEXTURE0);
+    glBindTexture(GL_TEXTURE_2D, layer.color);
+
+    stateDepthFunc(GL_ALWAYS);
+    glBegin(GL_QUADS);
+    glVertex2f(-1., -1.);
+    glVertex2f( 1., -1.);
+    glVertex2f( 1.,  1.);
+    glVertex2f(-1.,  1.);
+    glEnd();
+    stateDepthFunc(GL_LESS);
+
+    GL.ActiveTexture(GL_TEXTURE1);
+    glBindTexture(GL_TEXTURE_2D, 0);
+    GL.ActiveTexture(GL_TEXTURE0);
+    glBindTexture(GL_TEXTURE_2D, 0);
+    GL.UseProgram(0);
+}
+
+
+#endif /* layer_hpp */
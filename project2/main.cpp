@@ -15,6 +15,34 @@
 #include "glut.h"
 
 #include "cessna.hpp"
+#include "asynclog.hpp"
+#include "baryedge.hpp"
+#include "benchmark.hpp"
+#include "bvh.hpp"
+#include "corerenderer.hpp"
+#include "dynres.hpp"
+#include "edgechain.hpp"
+#include "fleet.hpp"
+#include "framepacer.hpp"
+#include "frustum.hpp"
+#include "glstate.hpp"
+#include "halfedge.hpp"
+#include "inputqueue.hpp"
+#include "jobs.hpp"
+#include "layer.hpp"
+#include "matrix.hpp"
+#include "meshrepair.hpp"
+#include "mirror.hpp"
+#include "occlusion.hpp"
+#include "pvs.hpp"
+#include "quantize.hpp"
+#include "renderer.hpp"
+#include "scenesim.hpp"
+#include "stats.hpp"
+#include "streamring.hpp"
+#include "tlas.hpp"
+
+#include <chrono>
 
 #pragma GCC diagnostic ignored "-Wdeprecated-declarations"
 
@@ -56,20 +84,108 @@ enum ViewPerspective {
 };
 
 
+// how to draw the cessna hull
+enum HullMode {
+    WIREFRAME,
+    SOLID,
+    FEATURE_EDGES,
+    SINGLE_PASS,
+    HIDDEN_LINE
+};
+
+const char *HULL_MODE_NAMES[] = {
+    "Wireframe",
+    "Solid",
+    "Feature Edges",
+    "Single Pass",
+    "Hidden Line"
+};
+
+
+// where the INSIDE camera sits:
+const float COCKPIT_EYE[3] = { 0., 1.8, 3. };
+
+
+// what to leave out of the scene:
+enum CullingMode {
+    CULLING_OFF,
+    CULLING_FRUSTUM,
+    CULLING_OCCLUSION
+};
+
+const char *CULLING_NAMES[] = {
+    "Off",
+    "Frustum",
+    "Frustum + Occlusion"
+};
+
+
+// the propellers, as parts that can be picked:
+enum Propeller {
+    NOSE_PROPELLER,
+    LEFT_PROPELLER,
+    RIGHT_PROPELLER
+};
+
+const char *PROPELLER_NAMES[] = {
+    "nose propeller",
+    "left propeller",
+    "right propeller"
+};
+
+// points in the outline of a picked propeller's disc:
+const int DISC_OUTLINE = 64;
+
+// the discs the spinning propellers sweep out, as placed in drawScene():
+//    center, normal, radius
+const float PROPELLER_DISCS[][7] = {
+    {   0., 0., 7.5,    0., 0., 1.,     5. },
+    { -10., 3., 0.,     0., 1., 0.,     3. },
+    {  10., 3., 0.,     0., 1., 0.,     3. }
+};
+
+
 // which button:
 enum ButtonVals {
     RESET,
     QUIT
 };
 
+// propeller size, centered at (0.,0.,0.) in the XY plane:
+const float PROPELLER_RADIUS = 1.0;
+const float PROPELLER_WIDTH  = 0.4;
+
+// ... as two triangles:
+const GLfloat PROPELLER_VERTICES[6][3] = {
+    {  PROPELLER_RADIUS,  PROPELLER_WIDTH/2.f, 0. }, { 0., 0., 0. }, {  PROPELLER_RADIUS, -PROPELLER_WIDTH/2.f, 0. },
+    { -PROPELLER_RADIUS, -PROPELLER_WIDTH/2.f, 0. }, { 0., 0., 0. }, { -PROPELLER_RADIUS,  PROPELLER_WIDTH/2.f, 0. }
+};
+
 // window background color (rgba):
 const GLfloat BACKCOLOR[] = { 0., 0., 0., 1. };
 
 
+// polygon offset for the hidden-line depth pass:
+const GLfloat HIDDEN_LINE_OFFSET_FACTOR = { 1. };
+const GLfloat HIDDEN_LINE_OFFSET_UNITS  = { 1. };
+
+
 // line width for the axes:
 const GLfloat AXES_WIDTH   = { 3. };
 
 
+// vertices in FunkyTargetThingy's spiral:
+const int SPIRAL_VERTICES = 400;
+
+// bounds for culling the objects that don't come from a mesh:
+//    the axes (length 1.5 plus the letters) and FunkyTargetThingy's spiral
+const BoundingSphere AXES_SPHERE   = { { 0., 0., 0. },  1.8 };
+const BoundingSphere SPIRAL_SPHERE = { { 0., 1., 15. }, 5.4 };
+
+// frames the CPU may be ahead of the GPU, to start with:
+const int FRAMES_IN_FLIGHT = 2;
+
+
 
 
 // non-constant global variables:
@@ -78,8 +194,26 @@ GLuint    AxesList;                // list to hold the axes
 int        AxesOn;                    // != 0 means to draw the axes
 int        DebugOn;                // != 0 means to print debugging info
 GLuint    BoxList;                // object display list
-GLuint  CessnaList;               // helicopter display list
+GLuint  CessnaList;               // helicopter display list: its closed components
+GLuint  CessnaOpenList;           // ... and the rest, which must not be culled
 GLuint  CessnaWireList;           // wireframe helicopter display list
+GLuint  CessnaHalfWireList;       // one mirror half of the wireframe
+GLuint  CessnaWireStripList;      // wireframe as chained line strips
+GLuint  CessnaHalfWireStripList;  // one mirror half of the line strips
+GLuint  CessnaCockpitList;        // the solid hull triangles visible from the cockpit
+GLuint  CessnaCockpitWireList;    // the wireframe edges visible from the cockpit
+PVS     CessnaCockpitPVS;         // what the INSIDE camera can see
+int     CessnaClosedTris;         // the first this many CESSNAtris are closed, and safe to cull
+MirrorMesh CessnaMirror;          // symmetry-compressed cessna mesh
+EdgeChains CessnaHalfChains;      // CessnaMirror.halfEdges as line strips
+EdgeChains CessnaSingleChains;    // CessnaMirror.singleEdges as line strips
+HalfEdgeMesh CessnaHalfEdges;     // adjacency for feature and silhouette edges
+BaryMesh CessnaBary;              // solid + wireframe in one pass
+BVH     CessnaBVH;                // hull triangles and propeller discs, in scene coordinates
+std::vector<struct point> CessnaScenePoints;    // CESSNApoints after applyCessnaPlacement()
+int     CessnaBaryReady;          // != 0 if CessnaBary is uploaded
+QuantMesh CessnaQuant;            // 16-bit quantized cessna mesh
+int     CessnaQuantReady;         // != 0 if CessnaQuant is uploaded
 GLuint  CessnaPropellerList;
 GLuint  BladeList;              // helicopter blade display list
 GLuint  ObjList;                // new object display list
@@ -87,11 +221,53 @@ int        MainWindow;                // window id for main graphics window
 float    Scale;                    // scaling factor
 int        WhichColor;                // index into Colors[ ]
 int     WhichViewPerspective;   // OUTSIDE or INSIDE
+int     WhichHullMode;          // one of the HullModes
+int     QuantizedOn;            // != 0 means to draw the quantized cessna
+int     StripsOn;               // != 0 means to draw the wireframe as line strips
 int        Xmouse, Ymouse;            // mouse values
+InputQueue MouseInput;          // mouse motion since the last frame
+int     SimulationOn;           // != 0 means input and animation run on their own thread
 float    Xrot, Yrot;                // rotation angles in degrees
 float   Time;                   // current time elapsed
 float   TimeCycle;              // current time in animation cycle
 bool    Frozen;                 // sets whether the scene is frozen
+GLdouble PickModelview[16];     // the scene matrices from the last drawScene()
+GLdouble PickProjection[16];
+GLint   PickViewport[4];
+int     PickedType;             // BVH_TRIANGLE or BVH_DISC under the mouse
+int     PickedId;               // triangle or Propeller, -1 if nothing
+int     PickedInstance;         // which aircraft in the fleet it is on
+int     WhichCulling;           // one of the CullingModes
+int     LayersOn;               // != 0 means to cache the still parts of the scene
+CachedLayer StaticLayer;        // the axes and the hull, while the view does not change
+int     DynamicResolutionOn;    // != 0 means to scale the scene to hold the frame time
+DynamicResolution SceneResolution;
+bool    SceneOffscreen;         // drawScene() is drawing into SceneResolution, not the window
+OcclusionCuller FleetOcclusion; // queries for CULLING_OCCLUSION
+int     StatsOn;                // != 0 means to print the frame stats every second
+FramePacer FramePacing;         // how far ahead of the GPU Display() may run
+Stats   FrameStats;             // counts for the current stats period
+Frustum ViewFrustum;            // from the matrices of the last drawScene()
+BVHBounds CessnaHullBox;        // hull, in scene coordinates
+BoundingSphere CessnaHullSphere;
+BoundingSphere CessnaSphere;    // hull and propellers, for fleet instances
+std::vector<int> VisibleInstances;  // fleet instances that passed culling this frame
+int     FleetSize;              // number of aircraft drawn, one of FLEET_SIZES
+Fleet   CessnaFleet;            // where each aircraft is this frame
+TLAS    CessnaTLAS;             // tree over the fleet, refit every frame
+StreamRing LegacyRing;          // what the legacy backend uploads each frame, if the context has buffers
+GLintptr LegacyPropellers;      // ... where this frame's propellers went in it, or -1
+std::vector<int> LegacyFleetPropellers; // the fleet instances whose propellers go in one batch
+CoreRenderer CoreScene;         // the core-profile backend's GL objects
+CoreMesh CoreCessnaSolid;       // the hull's closed components, per-vertex shades
+CoreMesh CoreCessnaOpen;        // ... and the rest, never culled
+CoreMesh CoreCessnaWire;
+CoreMesh CoreCessnaFeatures;    // CESSNApoints, by HalfEdgeMesh.featureIndices
+CoreMesh CoreCessnaSilhouette;  // ... by the silhouette indices, refilled each time
+CoreMesh CoreCockpitSolid;      // the hull's cockpit PVS
+CoreMesh CoreCockpitWire;
+CoreMesh CorePropeller;
+CoreMesh CoreAxes;
 
 
 
@@ -99,14 +275,66 @@ bool    Frozen;                 // sets whether the scene is frozen
 // MARK: - Function prototypes
 
 void    Animate();
+void    Benchmark();
 void    Display();
+void    drawScene();
 void    FunkyTargetThingy();
+void    applyCessnaPlacement();
 void    createCessnaWireframe();
-//void    CESSNAshade();
+void    createCessnaSolid();
+void    createCessnaQuantized();
+void    createCessnaBary();
+void    createCessnaCockpit();
+void    drawCessnaCockpit();
 void    createCessnaPropeller();
+void    drawCessna();
+void    drawCessnaFeatureEdges();
+void    drawCessnaHiddenLine();
+void    drawCessnaSolid();
+void    drawCessnaWire();
+void    drawPropellers(bool);
+bool    objectVisible(BoundingSphere const &, BVHBounds const *);
+void    computeCessnaBounds();
+void    drawFleet(void (*)(int));
+void    drawFleetInstance(int);
+void    drawFleetPropellers();
+void    placePropeller(int, GLfloat [16]);
+void    streamPropellers();
+void    drawLegacyScene();
+void    drawLegacyHUD(char const *);
+void    initLegacyLists();
+void    drawCoreScene();
+void    drawCoreCessna(GLfloat const [16]);
+void    drawCoreCockpit();
+void    drawCorePropellers(GLfloat const [16], bool);
+void    drawCoreFleetInstance(int);
+void    drawCorePicked();
+void    drawCoreSpiral();
+void    initCoreLists();
+void    drawStaticObjects();
+void    drawStaticLayer();
+void    setFleetSize(int);
+void    beginCessnaCulling();
+void    endCessnaCulling();
+void    cessnaPlacement(GLfloat [16]);
+float   cessnaTriShade(struct point const *, struct tri const &);
+void    shadeCessnaTri(struct point const *, struct tri const &);
+void    discOutline(int, GLfloat [][3], int);
+void    funkySpiral(GLfloat [][6]);
 void    DoAxesMenu(int);
 void    DoColorMenu(int);
 void    DoDebugMenu(int);
+void    DoCullingMenu(int);
+void    DoFleetMenu(int);
+void    DoLayersMenu(int);
+void    DoResolutionMenu(int);
+void    DoStatsMenu(int);
+void    DoStateCacheMenu(int);
+void    DoPacingMenu(int);
+void    DoHullMenu(int);
+void    DoQuantizedMenu(int);
+void    DoStripsMenu(int);
+void    DoSimulationMenu(int);
 void    DoMainMenu(int);
 void    DoRasterString(float, float, float, char const *);
 void    DoStrokeString(float, float, float, float, char const *);
@@ -117,25 +345,61 @@ void    InitMenus();
 void    Keyboard(unsigned char, int, int);
 void    MouseButton(int, int, int, int);
 void    MouseMotion(int, int);
+void    PassiveMotion(int, int);
+void    buildCessnaBVH();
+void    drawPicked();
+void    pickAt(int, int);
+bool    pickHit(PickView const &, Fleet const &, TLAS const *, int, int, bool, BVHHit *, int *);
+void    applyInput();
+void    applyDrag(InputQueue const &, float &, float &, float &);
+void    simulate(SceneSim &);
+void    startSimulation();
+void    stopSimulation();
+void    simControls();
+void    takeSnapshot();
+void    publishPickView();
 void    Reset();
 
 
 void    Axes(float);
+std::vector<GLfloat> axesLines(float);
 float   Dot(float v1[3], float v2[3]);
 void    Cross(float v1[3], float v2[3], float vout[3]);
 float   Unit(float vin[3], float vout[3]);
 
 
+// the scene backends, picked with "-renderer legacy|core":
+Renderer LEGACY_RENDERER = { "legacy fixed-function", 0, 0, false, initLegacyLists, drawLegacyScene, drawLegacyHUD };
+Renderer CORE_RENDERER   = { "core profile", 3, 3, true, initCoreLists, drawCoreScene, NULL };
+
+Renderer *SceneRenderer = &LEGACY_RENDERER;
+
+
 // MARK: - Function definitions
 
 // main program:
 int main(int argc, char *argv[]) {
 
     glutInit(&argc, argv);
+    logStart(stderr);
+    int workers = -1;
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "-capture") == 0 && i + 1 < argc) {
+            int frames = i + 2 < argc ? atoi(argv[i + 2]) : 0;
+            startGLCapture(argv[i + 1], frames > 0 ? frames : GL_CAPTURE_FRAMES);
+        } else if (strcmp(argv[i], "-renderer") == 0 && i + 1 < argc) {
+            SceneRenderer = strcmp(argv[i + 1], "core") == 0 ? &CORE_RENDERER : &LEGACY_RENDERER;
+        } else if (strcmp(argv[i], "-workers") == 0 && i + 1 < argc) {
+            workers = atoi(argv[i + 1]);
+        }
+    }
+    startJobs(workers);
     InitGraphics();
     InitLists();
     Reset();
     InitMenus();
+    SimulationOn = 1;
+    startSimulation();
     glutSetWindow(MainWindow);
     glutMainLoop();
 
@@ -146,17 +410,23 @@ int main(int argc, char *argv[]) {
 // the keyboard callback:
 void Keyboard(unsigned char c, int x, int y) {
     if (DebugOn)
-        fprintf( stderr, "Keyboard: '%c' (0x%0x)\n", c, c );
+        logPrint("Keyboard: '%c' (0x%0x)\n", c, c);
+    pacerInput(FramePacing);
     
     switch (c) {
         case 'q': case 'Q': case ESCAPE:
             DoMainMenu(QUIT);    // will not return here
             break;                // happy compiler
             
+        case 'b': case 'B':
+            Benchmark();
+            break;
+            
         case 'f': case 'F':
             Frozen = !Frozen;
             if (Frozen) glutIdleFunc(NULL);
             else glutIdleFunc(Animate);
+            simControls();
             break;
             
         default:
@@ -174,7 +444,8 @@ void MouseButton(int button, int state, int x, int y) {
     int b = 0;            // LEFT, MIDDLE, or RIGHT
     
     if (DebugOn)
-        fprintf(stderr, "MouseButton: %d, %d, %d, %d\n", button, state, x, y);
+        logPrint("MouseButton: %d, %d, %d, %d\n", button, state, x, y);
+    pacerInput(FramePacing);
     
     
     // get the proper button bit mask:
@@ -209,44 +480,152 @@ void MouseButton(int button, int state, int x, int y) {
 
 
 // called when the mouse moves while a button is down:
+//    only queued here; applyInput() sums them up once a frame
 void MouseMotion(int x, int y) {
-    if (DebugOn)
-        fprintf(stderr, "MouseMotion: %d, %d\n", x, y);
-    
-    
     int dx = x - Xmouse;        // change in mouse coords
     int dy = y - Ymouse;
     
-    if (ActiveButton & LEFT) {
-        Xrot += (ANGLE_FACTOR*dy);
-        Yrot += (ANGLE_FACTOR*dx);
+    Xmouse = x;            // new current position
+    Ymouse = y;
+    
+    // (through the simulation, the frame that first shows it is only known once a snapshot does)
+    if (SimulationOn) {
+        simDrag(Simulation, ActiveButton, dx, dy);
+        glutSetWindow(MainWindow);
+        glutPostRedisplay();
+    } else if (inputDrag(MouseInput, ActiveButton, dx, dy)) {
+        pacerInput(FramePacing);
+        glutSetWindow(MainWindow);
+        glutPostRedisplay();
+    }
+}
+
+
+
+// called when the mouse moves with no button down:
+void PassiveMotion(int x, int y) {
+    if (SimulationOn) {
+        simHover(Simulation, x, y);
+        glutSetWindow(MainWindow);
+        glutPostRedisplay();
+    } else if (inputHover(MouseInput, x, y)) {
+        glutSetWindow(MainWindow);
+        glutPostRedisplay();
     }
+}
+
+
+// the mouse motion since the last frame, as one update, as late as
+//    possible before the frame is drawn:
+void applyInput() {
+    InputQueue in = inputTake(MouseInput);
+    if (in.events == 0)
+        return;
+    if (DebugOn)
+        logPrint("Input: %d motion events\n", in.events);
     
+    applyDrag(in, Xrot, Yrot, Scale);
+    if (in.hovered)
+        pickAt(in.hoverX, in.hoverY);
     
-    if (ActiveButton & MIDDLE) {
-        Scale += SCALE_FACTOR * (float) (dx - dy);
+    statsAdd(FrameStats, STAT_INPUT_EVENTS, in.events);
+    statsAdd(FrameStats, STAT_INPUT_UPDATES, 1);
+}
+
+
+// turn and scale the scene by the drags in:
+void applyDrag(InputQueue const &in, float &xrot, float &yrot, float &scale) {
+    for (int buttons = 0; buttons < INPUT_BUTTON_SETS; buttons++) {
+        int dx = in.dragX[buttons];
+        int dy = in.dragY[buttons];
         
-        // keep object from turning inside-out or disappearing:
+        if (buttons & LEFT) {
+            xrot += (ANGLE_FACTOR*dy);
+            yrot += (ANGLE_FACTOR*dx);
+        }
         
-        if (Scale < SCALE_FACTOR_MINIMUM)
-            Scale = SCALE_FACTOR_MINIMUM;
+        if (buttons & MIDDLE) {
+            scale += SCALE_FACTOR * (float) (dx - dy);
+            
+            // keep object from turning inside-out or disappearing:
+            
+            if (scale < SCALE_FACTOR_MINIMUM)
+                scale = SCALE_FACTOR_MINIMUM;
+        }
     }
-    
-    Xmouse = x;            // new current position
-    Ymouse = y;
-    
-    glutSetWindow(MainWindow);
-    glutPostRedisplay();
+}
+
+
+// find what is under the mouse with a ray through the BVH (against the
+//    last frame's matrices):
+void pickAt(int x, int y) {
+    PickView view;
+    memcpy(view.modelview, PickModelview, sizeof(view.modelview));
+    memcpy(view.projection, PickProjection, sizeof(view.projection));
+    memcpy(view.viewport, PickViewport, sizeof(view.viewport));
+    view.height = glutGet(GLUT_WINDOW_HEIGHT);
+
+    BVHHit hit;
+    int instance;
+    if (!pickHit(view, CessnaFleet, FleetSize > 1 ? &CessnaTLAS : NULL, x, y, DebugOn, &hit, &instance))
+        return;
+    PickedType = hit.type;
+    PickedId = hit.id;
+    PickedInstance = instance;
+}
+
+// ... through the matrices of view, among the fleet if there is a tree
+//    over it; false if the mouse is nowhere in view:
+bool pickHit(PickView const &view, Fleet const &fleet, TLAS const *tlas, int x, int y, bool debug,
+             BVHHit *hit, int *instance) {
+    GLdouble nx, ny, nz, fx, fy, fz;
+    GLdouble wy = (GLdouble)(view.height - y);
+    if (!gluUnProject(x, wy, 0., view.modelview, view.projection, view.viewport, &nx, &ny, &nz) ||
+        !gluUnProject(x, wy, 1., view.modelview, view.projection, view.viewport, &fx, &fy, &fz))
+        return false;
+
+    float origin[3] = { (float)nx, (float)ny, (float)nz };
+    float dir[3] = { (float)(fx - nx), (float)(fy - ny), (float)(fz - nz) };
+
+    *instance = 0;
+    auto start = std::chrono::steady_clock::now();
+    *hit = tlas != NULL ? intersectTLAS(*tlas, fleet, CessnaBVH, origin, dir, instance)
+                        : intersectBVH(CessnaBVH, origin, dir);
+    auto stop = std::chrono::steady_clock::now();
+
+    if (debug) {
+        double ns = std::chrono::duration<double, std::nano>(stop - start).count();
+        if (hit->id < 0)
+            logPrint("Pick: nothing (%.0f ns)\n", ns);
+        else if (hit->type == BVH_TRIANGLE)
+            logPrint("Pick: triangle %d on aircraft %d (%.0f ns)\n", hit->id, *instance, ns);
+        else
+            logPrint("Pick: %s on aircraft %d (%.0f ns)\n", PROPELLER_NAMES[hit->id], *instance, ns);
+    }
+    return true;
 }
 
 
 
 void Animate() {
+    // with the simulation on its own thread, only keep the frames coming:
+    if (SimulationOn) {
+        glutSetWindow(MainWindow);
+        glutPostRedisplay();
+        return;
+    }
+    
     int ms = glutGet(GLUT_ELAPSED_TIME);
     Time = (float)ms / (float)1000;
     ms %= MS_IN_THE_ANIMATION_CYCLE;
     TimeCycle = (float)ms / (float)MS_IN_THE_ANIMATION_CYCLE;    // [0., 1.]
     
+    if (FleetSize > 1) {
+        updateFleet(CessnaFleet, Time);
+        refitTLAS(CessnaTLAS, CessnaFleet, CessnaBVH);
+        if (DebugOn)
+            reportTLAS(CessnaTLAS);
+    }
     
     // force a call to Display() next time it is convenient:
     glutSetWindow(MainWindow);
@@ -254,19 +633,181 @@ void Animate() {
 }
 
 
+// one step on the simulation thread: what Animate() and applyInput() do
+//    when it is off, to the simulation's own copy of the scene, which it
+//    then publishes for Display()
+
+void simulate(SceneSim &sim) {
+    bool debug = sim.debug.load(std::memory_order_relaxed);
+    if (sim.reset.exchange(false)) {
+        sim.xrot = sim.yrot = 0.;
+        sim.scale = 1.;
+    }
+    
+    int fleetSize = sim.fleetSize.load(std::memory_order_relaxed);
+    bool resized = (int)sim.fleet.instances.size() != fleetSize;
+    if (resized) {
+        resizeFleet(sim.fleet, fleetSize);
+        sim.pickedId = -1;
+    }
+    if (!sim.frozen.load(std::memory_order_relaxed)) {
+        int ms = (int)std::chrono::duration_cast<std::chrono::milliseconds>(
+                     std::chrono::steady_clock::now() - sim.epoch).count();
+        sim.time = (float)ms / (float)1000;
+        ms %= MS_IN_THE_ANIMATION_CYCLE;
+        sim.timeCycle = (float)ms / (float)MS_IN_THE_ANIMATION_CYCLE;
+    }
+    if (resized || (fleetSize > 1 && !sim.frozen.load(std::memory_order_relaxed))) {
+        updateFleet(sim.fleet, sim.time);
+        if (resized) {
+            sim.tlas = TLAS{};
+            if (fleetSize > 1)
+                buildTLAS(sim.tlas, sim.fleet, CessnaBVH);
+        } else {
+            refitTLAS(sim.tlas, sim.fleet, CessnaBVH);
+        }
+        if (debug && fleetSize > 1)
+            reportTLAS(sim.tlas);
+    }
+    
+    simTakeInput(sim);
+    InputQueue in = inputTake(sim.input);
+    if (in.events > 0) {
+        if (debug)
+            logPrint("Input: %d motion events\n", in.events);
+        applyDrag(in, sim.xrot, sim.yrot, sim.scale);
+        
+        // against the matrices of the last frame drawn:
+        PickView const &view = tripleLatest(sim.views);
+        BVHHit hit;
+        int instance;
+        if (in.hovered && view.drawn &&
+            pickHit(view, sim.fleet, fleetSize > 1 ? &sim.tlas : NULL, in.hoverX, in.hoverY, debug, &hit, &instance)) {
+            sim.pickedType = hit.type;
+            sim.pickedId = hit.id;
+            sim.pickedInstance = instance;
+        }
+        sim.inputEvents += in.events;
+        sim.inputUpdates++;
+    }
+    
+    SceneSnapshot &snap = tripleBack(sim.snapshots);
+    snap.tick = sim.ticks;
+    snap.xrot = sim.xrot;
+    snap.yrot = sim.yrot;
+    snap.scale = sim.scale;
+    snap.time = sim.time;
+    snap.timeCycle = sim.timeCycle;
+    snap.instances = sim.fleet.instances;
+    snap.pickedType = sim.pickedType;
+    snap.pickedId = sim.pickedId;
+    snap.pickedInstance = sim.pickedInstance;
+    snap.inputs = sim.inputs;
+    triplePublish(sim.snapshots);
+}
+
+// hand the scene over to the simulation thread, as it is now:
+void startSimulation() {
+    SceneSim &sim = Simulation;
+    sim.xrot = Xrot;
+    sim.yrot = Yrot;
+    sim.scale = Scale;
+    sim.time = Time;
+    sim.timeCycle = TimeCycle;
+    sim.fleet = CessnaFleet;
+    sim.tlas = CessnaTLAS;
+    sim.input = InputQueue{};
+    sim.pickedType = PickedType;
+    sim.pickedId = PickedId;
+    sim.pickedInstance = PickedInstance;
+    sim.reset = false;
+    sim.epoch = std::chrono::steady_clock::now() - std::chrono::milliseconds(glutGet(GLUT_ELAPSED_TIME));
+
+    // nothing from a run before this one: no snapshot or view to roll back to, no input left over
+    tripleReset(sim.snapshots, SceneSnapshot{});
+    tripleReset(sim.views, PickView{});
+    sim.eventTail.store(sim.eventHead.load(std::memory_order_relaxed), std::memory_order_relaxed);
+    sim.inputs = sim.shown = sim.pushed;
+
+    simControls();
+    startSceneSim(simulate);
+}
+
+// ... and take it back: the fleet is where the last snapshot put it, which
+//    the tree has not seen
+void stopSimulation() {
+    stopSceneSim();
+    if (FleetSize > 1)
+        refitTLAS(CessnaTLAS, CessnaFleet, CessnaBVH);
+}
+
+// what the menus and keys say the simulation should be doing:
+void simControls() {
+    Simulation.fleetSize.store(FleetSize, std::memory_order_relaxed);
+    Simulation.frozen.store(Frozen, std::memory_order_relaxed);
+    Simulation.debug.store(DebugOn != 0, std::memory_order_relaxed);
+}
+
+// the newest scene the simulation has published, into what drawScene() reads:
+void takeSnapshot() {
+    simControls();
+    SceneSnapshot const &snap = tripleLatest(Simulation.snapshots);
+    if (snap.tick == 0)
+        return;
+    
+    Xrot = snap.xrot;
+    Yrot = snap.yrot;
+    Scale = snap.scale;
+    Time = snap.time;
+    TimeCycle = snap.timeCycle;
+    
+    // (right after the fleet is resized, the simulation has not caught up yet)
+    if ((int)snap.instances.size() == FleetSize) {
+        CessnaFleet.instances = snap.instances;
+        PickedType = snap.pickedType;
+        PickedId = snap.pickedId;
+        PickedInstance = snap.pickedInstance;
+    }
+    
+    statsAdd(FrameStats, STAT_INPUT_EVENTS, Simulation.inputEvents.exchange(0));
+    statsAdd(FrameStats, STAT_INPUT_UPDATES, Simulation.inputUpdates.exchange(0));
+    pacerInputAt(FramePacing, simShowInput(Simulation, snap.inputs));
+    
+    // input it has not taken in yet needs another frame, even when frozen:
+    if (snap.inputs < Simulation.pushed)
+        glutPostRedisplay();
+}
+
+// the matrices this frame was drawn with, for the simulation to pick against:
+void publishPickView() {
+    PickView &view = tripleBack(Simulation.views);
+    memcpy(view.modelview, PickModelview, sizeof(view.modelview));
+    memcpy(view.projection, PickProjection, sizeof(view.projection));
+    memcpy(view.viewport, PickViewport, sizeof(view.viewport));
+    view.height = glutGet(GLUT_WINDOW_HEIGHT);
+    view.drawn = true;
+    triplePublish(Simulation.views);
+}
+
+
 // draw the complete scene:
 
 void makeShadingFlat() {
-    glShadeModel(GL_SMOOTH);
+    stateShadeModel(GL_SMOOTH);
 }
 
 void eraseBackground() {
-    glDrawBuffer(GL_BACK);
+    if (!SceneOffscreen)
+        stateDrawBuffer(GL_BACK);
     glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
-    glEnable(GL_DEPTH_TEST);
+    stateEnable(GL_DEPTH_TEST);
 }
 
 void centerViewport() {
+    if (SceneOffscreen) {
+        glViewport(0, 0, SceneResolution.width, SceneResolution.height);
+        return;
+    }
     GLsizei vx = glutGet(GLUT_WINDOW_WIDTH);
     GLsizei vy = glutGet(GLUT_WINDOW_HEIGHT);
     GLsizei v = vx < vy ? vx : vy;            // minimum dimension
@@ -277,27 +818,96 @@ void centerViewport() {
 
 void Display() {
     if (DebugOn) {
-        fprintf(stderr, "Display\n");
+        logPrint("Display\n");
     }
         
     // set which window we want to do the graphics into:
     glutSetWindow(MainWindow);
+    pacerBeginFrame(FramePacing);
+    if (SimulationOn)
+        takeSnapshot();
+    else
+        applyInput();
     
+    if (DynamicResolutionOn && SceneResolution.ready) {
+        // clear the whole window, then draw the scene smaller and stretch it into the viewport:
+        eraseBackground();
+        centerViewport();
+        GLint viewport[4];
+        glGetIntegerv(GL_VIEWPORT, viewport);
+        beginDynamicResolution(SceneResolution, viewport[2], viewport[3]);
+        SceneOffscreen = true;
+        drawScene();
+        SceneOffscreen = false;
+        endDynamicResolution(SceneResolution, viewport);
+        memcpy(PickViewport, viewport, sizeof(viewport));      // the mouse is in window pixels
+        updateDynamicResolution(SceneResolution, ElapsedSeconds());
+        statsAdd(FrameStats, STAT_RESOLUTION_PERCENT, lroundf(100.f * SceneResolution.scale));
+    } else {
+        drawScene();
+        statsAdd(FrameStats, STAT_RESOLUTION_PERCENT, 100);
+    }
+    if (SimulationOn)
+        publishPickView();
+ 
+    stateDisable(GL_DEPTH_TEST);
+    
+    // the HUD, always at the window's resolution:
+    if (DynamicResolutionOn && SceneResolution.ready && SceneRenderer->drawHUD != NULL) {
+        char hud[64];
+        snprintf(hud, sizeof(hud), "%dx%d (%.0f%%)  %.1f ms", SceneResolution.width, SceneResolution.height,
+                 100.f * SceneResolution.scale, SceneResolution.frameMs);
+        SceneRenderer->drawHUD(hud);
+    }
+    
+    glutSwapBuffers();
+    pacerEndFrame(FramePacing);
+    
+    statsAdd(FrameStats, STAT_GL_STATE_ISSUED, GLState.issued);
+    statsAdd(FrameStats, STAT_GL_STATE_ELIDED, GLState.elided);
+    stateResetCounts();
+    traceEndFrame(FrameStats);
+    if (statsEndFrame(FrameStats, ElapsedSeconds(), StatsOn)) {
+        traceReport(StatsOn);
+        pacerReport(FramePacing, StatsOn);
+        jobReport(StatsOn);
+    }
+}
+
+void drawLegacyHUD(char const *text) {
+    stateMatrixMode(GL_PROJECTION);
+    glLoadIdentity();
+    gluOrtho2D(0., 100., 0., 100.);
+    stateMatrixMode(GL_MODELVIEW);
+    glLoadIdentity();
+    stateColor3f(1., 1., 1.);
+    DoRasterString(2., 2., 0., text);
+}
+
+
+// everything in the 3D scene, starting from a cleared framebuffer:
+void drawScene() {
+    SceneRenderer->drawScene();
+}
+
+void drawLegacyScene() {
+    if (LegacyRing.ready)
+        streamBeginFrame(LegacyRing);
     eraseBackground();
     makeShadingFlat();
     centerViewport();
 
-    glMatrixMode(GL_PROJECTION);
+    stateMatrixMode(GL_PROJECTION);
     glLoadIdentity();
     gluPerspective(90, 1, 0.1, 1000);
         
     // place the objects into the scene:
-    glMatrixMode(GL_MODELVIEW);
+    stateMatrixMode(GL_MODELVIEW);
     glLoadIdentity();
     
     // eye (my eyes?), center (i am looking at this?), up (?)
     if (WhichViewPerspective == INSIDE) {
-        gluLookAt(0, 1.8, 3,     0, 0, 10,     0, 0, 2);
+        gluLookAt(COCKPIT_EYE[0], COCKPIT_EYE[1], COCKPIT_EYE[2],     0, 0, 10,     0, 0, 2);
     } else {
         gluLookAt(11, 7, 9,     0, 0, 1.6,     0, 1, 0);
                 
@@ -313,96 +923,673 @@ void Display() {
         glScalef((GLfloat)Scale, (GLfloat)Scale, (GLfloat)Scale);
     }
     
+    // remember where things are for picking:
+    glGetDoublev(GL_MODELVIEW_MATRIX, PickModelview);
+    glGetDoublev(GL_PROJECTION_MATRIX, PickProjection);
+    glGetIntegerv(GL_VIEWPORT, PickViewport);
+    ViewFrustum = extractFrustum(PickProjection, PickModelview);
+    
+    stateEnable(GL_NORMALIZE);
+
+    if (LayersOn && StaticLayer.ready)
+        drawStaticLayer();
+    else
+        drawStaticObjects();
+
+    // everything that moves:
+    streamPropellers();
+    drawPropellers(true);
+    drawFleet(drawFleetInstance);
+    drawFleetPropellers();
+    drawPicked();
+    
+    if (objectVisible(SPIRAL_SPHERE, NULL)) {
+        FunkyTargetThingy();
+        stateInvalidateColor();
+    }
+
+    if (LegacyRing.ready) {
+        streamEndFrame(LegacyRing);
+        statsAdd(FrameStats, STAT_STREAM_BYTES, LegacyRing.bytes);
+        statsAdd(FrameStats, STAT_STREAM_WAITS, LegacyRing.waits);
+        statsAdd(FrameStats, STAT_STREAM_OVERFLOWS, LegacyRing.overflows);
+    }
+}
+
+
+// the parts of the scene that only change when the view or a menu setting does:
+void drawStaticObjects() {
     // possibly draw the axes:
-    if (AxesOn) {
-        GLfloat const red[3] = {1,0,0};
-        glColor3fv(red);
+    if (AxesOn && objectVisible(AXES_SPHERE, NULL)) {
+        stateColor3f(1., 0., 0.);
         glCallList(AxesList);
     }
+
+    if (objectVisible(CessnaHullSphere, &CessnaHullBox)) {
+        if (WhichViewPerspective == INSIDE)
+            drawCessnaCockpit();
+        else
+            drawCessna();
+    }
+}
+
+// the static objects from the cached layer, redrawn into it only when they would change:
+void drawStaticLayer() {
+    struct {
+        GLdouble modelview[16], projection[16];
+        int hullMode, quantized, strips, axes, view, culling;
+    } key;
+    memset(&key, 0, sizeof(key));
+    memcpy(key.modelview, PickModelview, sizeof(key.modelview));
+    memcpy(key.projection, PickProjection, sizeof(key.projection));
+    key.hullMode = WhichHullMode;
+    key.quantized = QuantizedOn;
+    key.strips = StripsOn;
+    key.axes = AxesOn;
+    key.view = WhichViewPerspective;
+    key.culling = WhichCulling;
+
+    // under dynamic resolution the viewport changes size from frame to frame,
+    //    so the layer is drawn at the biggest it can be and shrunk to fit:
+    int size[2] = { PickViewport[2], PickViewport[3] };
+    if (SceneOffscreen)
+        memcpy(size, SceneResolution.size, sizeof(size));
+    if (beginCachedLayer(StaticLayer, size, &key, sizeof(key))) {
+        drawStaticObjects();
+        endCachedLayer(StaticLayer, PickViewport);
+        statsAdd(FrameStats, STAT_LAYER_REDRAWS, 1);
+    }
+    if (!StaticLayer.ready) {
+        drawStaticObjects();
+        return;
+    }
+    drawCachedLayer(StaticLayer);
+}
+
+
+// frustum test for one object, counted in the stats:
+bool objectVisible(BoundingSphere const &s, BVHBounds const *box) {
+    bool visible = WhichCulling == CULLING_OFF || (sphereInFrustum(ViewFrustum, s) && (box == NULL || boxInFrustum(ViewFrustum, *box)));
+    statsAdd(FrameStats, visible ? STAT_OBJECTS_DRAWN : STAT_OBJECTS_CULLED, 1);
+    return visible;
+}
+
+
+// the three spinning propellers, in scene coordinates:
+//    (cull tests each one against the frustum; fleet instances are tested whole)
+void drawPropellers(bool cull) {
+    BoundingSphere discs[3];
+    for (int i = NOSE_PROPELLER; i <= RIGHT_PROPELLER; i++)
+        discs[i] = BoundingSphere{ { PROPELLER_DISCS[i][0], PROPELLER_DISCS[i][1], PROPELLER_DISCS[i][2] },
+                                   PROPELLER_DISCS[i][6] };
+
+    stateColor3f(1., 1., 1.);
+    if (LegacyPropellers >= 0) {
+        // this frame's three, from the ring:
+        GL.BindBuffer(GL_ARRAY_BUFFER, LegacyRing.buffer);
+        glEnableClientState(GL_VERTEX_ARRAY);
+        glVertexPointer(3, GL_FLOAT, 0, (void const *)LegacyPropellers);
+        for (int i = NOSE_PROPELLER; i <= RIGHT_PROPELLER; i++)
+            if (!cull || objectVisible(discs[i], NULL))
+                glDrawArrays(GL_TRIANGLES, 6*i, 6);
+        glDisableClientState(GL_VERTEX_ARRAY);
+        GL.BindBuffer(GL_ARRAY_BUFFER, 0);
+        return;
+    }
+
+    if (!cull || objectVisible(discs[NOSE_PROPELLER], NULL)) {
+        glPushMatrix();
+    
+        // draw nose propeller
+    
+        glTranslatef(0.,0.,7.5);
+        glScalef(5., 5., 5.);
+        glRotatef(360.*TimeCycle, 0., 0., 1.);
+        glCallList(CessnaPropellerList);
     
-    glEnable(GL_NORMALIZE);
+        glPopMatrix();
+    }
 
-    glCallList(CessnaList);
-    glCallList(CessnaWireList);
+    if (!cull || objectVisible(discs[LEFT_PROPELLER], NULL)) {
+        glPushMatrix();
+    
+        // draw left propeller
+        glTranslatef(-10., 3., 0);
+        glScalef(3, 3, 3);
+        glRotatef(-2*360.*TimeCycle, 0., 1., 0.);
+        glRotatef(90., 0., 0., 0.);
+        glCallList(CessnaPropellerList);
+    
+        glPopMatrix();
+    }
 
+    if (!cull || objectVisible(discs[RIGHT_PROPELLER], NULL)) {
+        glPushMatrix();
+        // draw right propeller
+        glTranslatef(10., 3., 0.);
+        glScalef(3, 3, 3);
+        glRotatef(2*360.*TimeCycle, 0., 1., 0.);
+        glRotatef(-90., 0., 0., 0.);
+        glCallList(CessnaPropellerList);
     
+        glPopMatrix();
+    }
+}
+
+
+// propeller i's place and spin this frame, multiplied onto m, as drawPropellers() has them:
+void placePropeller(int i, GLfloat m[16]) {
+    float const *d = PROPELLER_DISCS[i];
+    matTranslate(m, d[0], d[1], d[2]);
+    if (i == NOSE_PROPELLER) {
+        matScale(m, 5., 5., 5.);
+        matRotate(m, 360.*TimeCycle, 0., 0., 1.);
+    } else {
+        matScale(m, 3, 3, 3);
+        matRotate(m, (i == LEFT_PROPELLER ? -2 : 2)*360.*TimeCycle, 0., 1., 0.);
+    }
+}
+
+// the three propellers as they are this frame, in aircraft coordinates, into
+//    the ring, where drawPropellers() draws every aircraft's from:
+void streamPropellers() {
+    LegacyPropellers = -1;
+    if (!LegacyRing.ready)
+        return;
+    GLfloat v[3][6][3];
+    for (int i = NOSE_PROPELLER; i <= RIGHT_PROPELLER; i++) {
+        GLfloat m[16];
+        matIdentity(m);
+        placePropeller(i, m);
+        for (int j = 0; j < 6; j++) {
+            GLfloat const *q = PROPELLER_VERTICES[j];
+            for (int c = 0; c < 3; c++)
+                v[i][j][c] = m[c]*q[0] + m[4 + c]*q[1] + m[8 + c]*q[2] + m[12 + c];
+        }
+    }
+    LegacyPropellers = streamUpload(LegacyRing, v, sizeof(v), sizeof(GLfloat));
+}
+
+
+// every aircraft in the fleet but the first, which drawScene() already drew,
+//    each one with drawInstance(i):
+void drawFleet(void (*drawInstance)(int)) {
+    if (FleetSize <= 1)
+        return;
+
+    if (WhichCulling != CULLING_OFF) {
+        cullInstances(ViewFrustum, CessnaFleet, CessnaSphere, VisibleInstances);
+    } else {
+        VisibleInstances.resize(FleetSize);
+        for (int i = 0; i < FleetSize; i++)
+            VisibleInstances[i] = i;
+    }
+
+    int inView = (int)VisibleInstances.size() - (!VisibleInstances.empty() && VisibleInstances[0] == 0);
+    int drawn = 0, occluded = 0;
+    if (WhichCulling == CULLING_OCCLUSION && FleetOcclusion.ready) {
+        drawOccluded(FleetOcclusion, CessnaFleet, VisibleInstances, CessnaSphere, PickModelview, drawInstance);
+        drawn = FleetOcclusion.drawn;
+        occluded = FleetOcclusion.occluded;
+    } else {
+        for (int i : VisibleInstances) {
+            if (i == 0)
+                continue;
+            drawInstance(i);
+            drawn++;
+        }
+    }
+    statsAdd(FrameStats, STAT_INSTANCES_DRAWN, drawn);
+    statsAdd(FrameStats, STAT_INSTANCES_CULLED, FleetSize - 1 - inView);
+    statsAdd(FrameStats, STAT_INSTANCES_OCCLUDED, occluded);
+}
+
+void drawFleetInstance(int i) {
     glPushMatrix();
+    glMultMatrixf(CessnaFleet.instances[i].m);
+    drawCessna();
+    // under occlusion culling the instance may be drawn conditionally, so its propellers are too:
+    if (LegacyPropellers >= 0 && WhichCulling != CULLING_OCCLUSION)
+        LegacyFleetPropellers.push_back(i);
+    else
+        drawPropellers(false);
+    glPopMatrix();
+}
+
+// the propellers of the instances drawFleetInstance() left them for, already
+//    placed by each one's matrix, in one upload and one draw:
+void drawFleetPropellers() {
+    std::vector<int> &instances = LegacyFleetPropellers;
+    if (instances.empty())
+        return;
+    static std::vector<GLfloat> v;
+    v.resize(instances.size() * 18 * 3);
+    GLfloat *out = v.data();
+    for (int i : instances) {
+        for (int k = NOSE_PROPELLER; k <= RIGHT_PROPELLER; k++) {
+            GLfloat m[16];
+            memcpy(m, CessnaFleet.instances[i].m, sizeof(m));
+            placePropeller(k, m);
+            for (int j = 0; j < 6; j++, out += 3) {
+                GLfloat const *q = PROPELLER_VERTICES[j];
+                for (int c = 0; c < 3; c++)
+                    out[c] = m[c]*q[0] + m[4 + c]*q[1] + m[8 + c]*q[2] + m[12 + c];
+            }
+        }
+    }
+    GLintptr offset = streamUpload(LegacyRing, v.data(), (GLsizeiptr)v.size() * sizeof(GLfloat), sizeof(GLfloat));
+    if (offset < 0) {
+        // no room in the ring this frame: one at a time, as drawFleetInstance() would
+        for (int i : instances) {
+            glPushMatrix();
+            glMultMatrixf(CessnaFleet.instances[i].m);
+            drawPropellers(false);
+            glPopMatrix();
+        }
+        instances.clear();
+        return;
+    }
+
+    stateColor3f(1., 1., 1.);
+    GL.BindBuffer(GL_ARRAY_BUFFER, LegacyRing.buffer);
+    glEnableClientState(GL_VERTEX_ARRAY);
+    glVertexPointer(3, GL_FLOAT, 0, (void const *)offset);
+    glDrawArrays(GL_TRIANGLES, 0, (GLsizei)instances.size() * 18);
+    glDisableClientState(GL_VERTEX_ARRAY);
+    GL.BindBuffer(GL_ARRAY_BUFFER, 0);
+    instances.clear();
+}
+
+
+// the scene drawLegacyScene() draws, through the core-profile backend:
+//    the same matrices, worked out here instead of on GL's stacks
+void drawCoreScene() {
+    eraseBackground();
+    centerViewport();
+
+    GLfloat projection[16], view[16];
+    matIdentity(projection);
+    matPerspective(projection, 90, 1, 0.1, 1000);
+    matIdentity(view);
+    if (WhichViewPerspective == INSIDE) {
+        matLookAt(view, COCKPIT_EYE[0], COCKPIT_EYE[1], COCKPIT_EYE[2],     0, 0, 10,     0, 0, 2);
+    } else {
+        matLookAt(view, 11, 7, 9,     0, 0, 1.6,     0, 1, 0);
+        matRotate(view, Yrot, 0, 1, 0);
+        matRotate(view, Xrot, 1., 0, 0);
+        if (Scale < SCALE_FACTOR_MINIMUM) {
+            Scale = SCALE_FACTOR_MINIMUM;
+        }
+        matScale(view, Scale, Scale, Scale);
+    }
+
+    // remember where things are for picking:
+    matToDouble(view, PickModelview);
+    matToDouble(projection, PickProjection);
+    glGetIntegerv(GL_VIEWPORT, PickViewport);
+    ViewFrustum = extractFrustum(PickProjection, PickModelview);
+
+    coreBeginScene(CoreScene, projection, view);
+    GLfloat identity[16];
+    matIdentity(identity);
+
+    if (AxesOn && objectVisible(AXES_SPHERE, NULL)) {
+        coreColor(1., 0., 0.);
+        coreLineWidth(CoreScene, AXES_WIDTH);
+        coreDraw(CoreScene, CoreAxes, identity);
+        coreLineWidth(CoreScene, 1.);
+    }
+    if (objectVisible(CessnaHullSphere, &CessnaHullBox)) {
+        if (WhichViewPerspective == INSIDE)
+            drawCoreCockpit();
+        else
+            drawCoreCessna(identity);
+    }
+
+    drawCorePropellers(identity, true);
+    drawFleet(drawCoreFleetInstance);
+    drawCorePicked();
+    if (objectVisible(SPIRAL_SPHERE, NULL))
+        drawCoreSpiral();
+    coreEndScene(CoreScene);
+
+    StreamRing const &ring = CoreScene.ring;
+    statsAdd(FrameStats, STAT_STREAM_BYTES, ring.bytes);
+    statsAdd(FrameStats, STAT_STREAM_WAITS, ring.waits);
+    statsAdd(FrameStats, STAT_STREAM_OVERFLOWS, ring.overflows);
+}
+
+// the hull at instance (a matrix in scene coordinates), as drawCessna() would draw it:
+void drawCoreCessna(GLfloat const instance[16]) {
+    GLfloat model[16];
+    memcpy(model, instance, sizeof(model));
+    cessnaPlacement(model);
+
+    switch (WhichHullMode) {
+        case FEATURE_EDGES: {
+            GLfloat modelview[16];
+            memcpy(modelview, CoreScene.frame.view, sizeof(modelview));
+            matMultiply(modelview, model);
+            float eye[3];
+            eyeFromModelview(modelview, eye);
+            computeSilhouette(CessnaHalfEdges, eye);
+            std::vector<GLuint> const &silhouette = CessnaHalfEdges.silhouetteIndices;
+            coreStreamIndices(CoreScene, CoreCessnaSilhouette, silhouette.data(), (int)silhouette.size());
+            coreColor(1., 0., 0.);
+            coreDraw(CoreScene, CoreCessnaFeatures, model);
+            coreDraw(CoreScene, CoreCessnaSilhouette, model);
+            break;
+        }
+
+        case HIDDEN_LINE:
+            glColorMask(GL_FALSE, GL_FALSE, GL_FALSE, GL_FALSE);
+            stateEnable(GL_POLYGON_OFFSET_FILL);
+            glPolygonOffset(HIDDEN_LINE_OFFSET_FACTOR, HIDDEN_LINE_OFFSET_UNITS);
+            beginCessnaCulling();
+            coreDraw(CoreScene, CoreCessnaSolid, model);
+            endCessnaCulling();
+            coreDraw(CoreScene, CoreCessnaOpen, model);
+            stateDisable(GL_POLYGON_OFFSET_FILL);
+            glColorMask(GL_TRUE, GL_TRUE, GL_TRUE, GL_TRUE);
+            stateDepthFunc(GL_LEQUAL);
+            coreColor(1., 0., 0.);
+            coreDraw(CoreScene, CoreCessnaWire, model);
+            stateDepthFunc(GL_LESS);
+            break;
+
+        case SOLID:
+        case SINGLE_PASS:
+            beginCessnaCulling();
+            coreDraw(CoreScene, CoreCessnaSolid, model);
+            endCessnaCulling();
+            coreDraw(CoreScene, CoreCessnaOpen, model);
+            coreColor(1., 0., 0.);
+            coreDraw(CoreScene, CoreCessnaWire, model);
+            break;
+
+        default:
+            coreColor(1., 0., 0.);
+            coreDraw(CoreScene, CoreCessnaWire, model);
+    }
+}
+
+// ... and as drawCessnaCockpit() would:
+void drawCoreCockpit() {
+    GLfloat model[16];
+    matIdentity(model);
+    if (WhichHullMode == WIREFRAME || WhichHullMode == FEATURE_EDGES) {
+        drawCoreCessna(model);
+        return;
+    }
+    cessnaPlacement(model);
+
+    coreColor(1., 0., 0.);
+    switch (WhichHullMode) {
+        case HIDDEN_LINE:
+            glColorMask(GL_FALSE, GL_FALSE, GL_FALSE, GL_FALSE);
+            stateEnable(GL_POLYGON_OFFSET_FILL);
+            glPolygonOffset(HIDDEN_LINE_OFFSET_FACTOR, HIDDEN_LINE_OFFSET_UNITS);
+            coreDraw(CoreScene, CoreCockpitSolid, model);
+            stateDisable(GL_POLYGON_OFFSET_FILL);
+            glColorMask(GL_TRUE, GL_TRUE, GL_TRUE, GL_TRUE);
+            stateDepthFunc(GL_LEQUAL);
+            coreDraw(CoreScene, CoreCockpitWire, model);
+            stateDepthFunc(GL_LESS);
+            break;
+
+        default:
+            coreDraw(CoreScene, CoreCockpitSolid, model);
+            coreDraw(CoreScene, CoreCockpitWire, model);
+    }
+}
+
+// the three spinning propellers, placed as in drawPropellers():
+void drawCorePropellers(GLfloat const instance[16], bool cull) {
+    coreColor(1., 1., 1.);
+    for (int i = NOSE_PROPELLER; i <= RIGHT_PROPELLER; i++) {
+        float const *d = PROPELLER_DISCS[i];
+        if (cull && !objectVisible(BoundingSphere{ { d[0], d[1], d[2] }, d[6] }, NULL))
+            continue;
+        GLfloat m[16];
+        memcpy(m, instance, sizeof(m));
+        placePropeller(i, m);
+        coreDraw(CoreScene, CorePropeller, m);
+    }
+}
+
+void drawCoreFleetInstance(int i) {
+    drawCoreCessna(CessnaFleet.instances[i].m);
+    drawCorePropellers(CessnaFleet.instances[i].m, false);
+}
+
+// highlight whatever the mouse is over, as drawPicked() does:
+void drawCorePicked() {
+    if (PickedId < 0)
+        return;
+
+    GLfloat model[16];
+    matIdentity(model);
+    if (PickedInstance > 0)
+        memcpy(model, CessnaFleet.instances[PickedInstance].m, sizeof(model));
+    coreColor(1., 1., 0.);
+    stateDepthFunc(GL_LEQUAL);
+    if (PickedType == BVH_TRIANGLE) {
+        struct tri const &t = CESSNAtris[PickedId];
+        GLfloat v[3][3];
+        int p[3] = { t.p0, t.p1, t.p2 };
+        for (int k = 0; k < 3; k++)
+            memcpy(v[k], &CessnaScenePoints[p[k]].x, sizeof(v[k]));
+        stateEnable(GL_POLYGON_OFFSET_FILL);
+        glPolygonOffset(-1., -1.);
+        coreDrawStream(CoreScene, GL_TRIANGLES, &v[0][0], 3, false, model);
+        stateDisable(GL_POLYGON_OFFSET_FILL);
+    } else {
+        GLfloat outline[DISC_OUTLINE][3];
+        discOutline(PickedId, outline, DISC_OUTLINE);
+        coreDrawStream(CoreScene, GL_LINE_LOOP, &outline[0][0], DISC_OUTLINE, false, model);
+    }
+    stateDepthFunc(GL_LESS);
+}
+
+// FunkyTargetThingy():
+void drawCoreSpiral() {
+    GLfloat m[16];
+    matIdentity(m);
+    matTranslate(m, 0, 1, 15.);
+    matRotate(m, 90., 90, 0, -5);
+    matScale(m, 2,2,2);
+    GLfloat v[SPIRAL_VERTICES][6];
+    funkySpiral(v);
+    coreDrawStream(CoreScene, GL_LINE_LOOP, &v[0][0], SPIRAL_VERTICES, true, m);
+}
+
+
+// draw the scene BENCHMARK_FRAMES times in every hull mode and print the timings:
+void Benchmark() {
+    glutSetWindow(MainWindow);
+    int mode = WhichHullMode, layers = LayersOn;
+
+    // a cached layer would hide what the hull modes cost:
+    LayersOn = 0;
+    fprintf(stderr, "Benchmark: %d frames per mode\n", BENCHMARK_FRAMES);
+    printBenchmarkHeader("hull mode");
+    for (WhichHullMode = WIREFRAME; WhichHullMode <= HIDDEN_LINE; WhichHullMode++) {
+        BenchmarkResult r = runBenchmark(drawScene, BENCHMARK_FRAMES, true);
+        printBenchmarkResult(HULL_MODE_NAMES[WhichHullMode], r);
+    }
+    WhichHullMode = mode;
+
+    // the still view, drawn every frame vs. cached:
+    printBenchmarkHeader("static layer");
+    for (LayersOn = 0; LayersOn <= 1; LayersOn++) {
+        BenchmarkResult r = runBenchmark(drawScene, BENCHMARK_FRAMES, true);
+        printBenchmarkResult(LayersOn ? "cached" : "drawn", r);
+    }
+    LayersOn = layers;
+
+    // the culling modes over a fleet (the current one, or 256 if it is off):
+    int fleet = FleetSize, culling = WhichCulling;
+    if (FleetSize <= 1)
+        setFleetSize(256);
+    fprintf(stderr, "Culling, %d aircraft:\n", FleetSize);
+    printBenchmarkHeader("culling");
+    for (WhichCulling = CULLING_OFF; WhichCulling <= CULLING_OCCLUSION; WhichCulling++) {
+        drawScene();                // prime last frame's occlusion results
+        long before = FrameStats.counts[STAT_INSTANCES_DRAWN];
+        bool ownQueries = WhichCulling == CULLING_OCCLUSION && FleetOcclusion.target == GL_SAMPLES_PASSED;
+        BenchmarkResult r = runBenchmark(drawScene, BENCHMARK_FRAMES, !ownQueries);
+        printBenchmarkResult(CULLING_NAMES[WhichCulling], r);
+        fprintf(stderr, "%-24s %10.1f instances drawn per frame\n", "",
+                (double)(FrameStats.counts[STAT_INSTANCES_DRAWN] - before) / BENCHMARK_FRAMES);
+    }
+    WhichCulling = culling;
+    if (fleet != FleetSize)
+        setFleetSize(fleet);
+
+    // the same frames with and without the state cache:
+    bool cache = GLState.on;
+    printBenchmarkHeader("state cache");
+    for (int on = 0; on <= 1; on++) {
+        GLState.on = on;
+        stateResetCounts();
+        BenchmarkResult r = runBenchmark(drawScene, BENCHMARK_FRAMES, true);
+        printBenchmarkResult(on ? "on" : "off", r);
+        fprintf(stderr, "%-24s %10.1f state calls issued, %.1f elided per frame\n", "",
+                (double)GLState.issued / BENCHMARK_FRAMES, (double)GLState.elided / BENCHMARK_FRAMES);
+    }
+    GLState.on = cache;
+    stateResetCounts();
+
+    benchmarkTLAS(CessnaBVH);
+}
+
+
+void DoAxesMenu(int id) {
+    AxesOn = id;
     
-    // draw nose propeller
+    glutSetWindow(MainWindow);
+    glutPostRedisplay();
+}
+
+
+void DoDebugMenu(int id) {
+    DebugOn = id;
     
-    glTranslatef(0.,0.,7.5);
-    glScalef(5., 5., 5.);
-    glRotatef(360.*TimeCycle, 0., 0., 1.);
-    glColor3f(1., 1., 1.);
-    glCallList(CessnaPropellerList);
+    glutSetWindow(MainWindow);
+    glutPostRedisplay();
+}
+
+
+// main menu callback:
+void DoMainMenu(int id) {
+    switch (id) {
+        case RESET:
+            Reset();
+            break;
+            
+        case QUIT:
+            glutSetWindow(MainWindow);
+            stopSceneSim();
+            pacerDrain(FramePacing);
+            glutDestroyWindow(MainWindow);
+            exit(0);
+            break;
+            
+        default:
+            fprintf(stderr, "Don't know what to do with Menu %d\n", id);
+    }
     
-    glPopMatrix();
-    glPushMatrix();
+    glutSetWindow(MainWindow);
+    glutPostRedisplay();
+}
+
+
+void DoCullingMenu(int id) {
+    WhichCulling = id;
+    
+    glutSetWindow(MainWindow);
+    glutPostRedisplay();
+}
+
+
+void DoStatsMenu(int id) {
+    StatsOn = id;
+    
+    glutSetWindow(MainWindow);
+    glutPostRedisplay();
+}
+
+
+void DoStateCacheMenu(int id) {
+    GLState.on = id;
+    
+    glutSetWindow(MainWindow);
+    glutPostRedisplay();
+}
+
+
+void DoPacingMenu(int id) {
+    FramePacing.inFlight = id;
     
-    // draw left propeller
-    glTranslatef(-10., 3., 0);
-    glScalef(3, 3, 3);
-    glRotatef(-2*360.*TimeCycle, 0., 1., 0.);
-    glRotatef(90., 0., 0., 0.);
-    glCallList(CessnaPropellerList);
+    glutSetWindow(MainWindow);
+    glutPostRedisplay();
+}
+
+
+void DoResolutionMenu(int id) {
+    DynamicResolutionOn = id;
+    
+    glutSetWindow(MainWindow);
+    glutPostRedisplay();
+}
+
+
+void DoLayersMenu(int id) {
+    LayersOn = id;
     
-    glPopMatrix();
-    glPushMatrix();
-    // draw right propeller
-    glTranslatef(10., 3., 0.);
-    glScalef(3, 3, 3);
-    glRotatef(2*360.*TimeCycle, 0., 1., 0.);
-    glRotatef(-90., 0., 0., 0.);
-    glCallList(CessnaPropellerList);
+    glutSetWindow(MainWindow);
+    glutPostRedisplay();
+}
+
+
+void DoFleetMenu(int id) {
+    setFleetSize(id);
     
-    glPopMatrix();
+    glutSetWindow(MainWindow);
+    glutPostRedisplay();
+}
+
+
+void DoHullMenu(int id) {
+    WhichHullMode = id;
     
-    FunkyTargetThingy();
- 
-    glDisable(GL_DEPTH_TEST);
-    glMatrixMode(GL_PROJECTION);
-    glLoadIdentity();
-    gluOrtho2D(0., 100., 0., 100.);
-    glMatrixMode(GL_MODELVIEW);
-    glLoadIdentity();
-    glutSwapBuffers();
-    glFlush();
+    glutSetWindow(MainWindow);
+    glutPostRedisplay();
 }
 
 
-void DoAxesMenu(int id) {
-    AxesOn = id;
+void DoQuantizedMenu(int id) {
+    QuantizedOn = id;
     
     glutSetWindow(MainWindow);
     glutPostRedisplay();
 }
 
 
-void DoDebugMenu(int id) {
-    DebugOn = id;
+void DoStripsMenu(int id) {
+    StripsOn = id;
     
     glutSetWindow(MainWindow);
     glutPostRedisplay();
 }
 
 
-// main menu callback:
-void DoMainMenu(int id) {
-    switch (id) {
-        case RESET:
-            Reset();
-            break;
-            
-        case QUIT:
-            glutSetWindow(MainWindow);
-            glFinish();
-            glutDestroyWindow(MainWindow);
-            exit(0);
-            break;
-            
-        default:
-            fprintf(stderr, "Don't know what to do with Menu %d\n", id);
-    }
+void DoSimulationMenu(int id) {
+    if (id && !SimulationOn)
+        startSimulation();
+    else if (!id && SimulationOn)
+        stopSimulation();
+    SimulationOn = id;
     
     glutSetWindow(MainWindow);
     glutPostRedisplay();
@@ -418,6 +1605,18 @@ void DoPerspMenu(int id) {
 
 
 
+// use glut to display a string of characters using a raster font:
+
+void DoRasterString(float x, float y, float z, char const *s) {
+    glRasterPos3f((GLfloat)x, (GLfloat)y, (GLfloat)z);
+    
+    for (char c; (c = *s) != '\0'; s++) {
+        glutBitmapCharacter(GLUT_BITMAP_HELVETICA_18, c);
+    }
+}
+
+
+
 // return the number of seconds since the start of the program:
 
 float ElapsedSeconds() {
@@ -446,10 +1645,72 @@ void InitMenus() {
     glutAddMenuEntry("Outside", OUTSIDE);
     glutAddMenuEntry("Inside", INSIDE);
     
+    int hullmenu = glutCreateMenu(DoHullMenu);
+    for (int mode = WIREFRAME; mode <= HIDDEN_LINE; mode++)
+        glutAddMenuEntry(HULL_MODE_NAMES[mode], mode);
+    
+    int fleetmenu = glutCreateMenu(DoFleetMenu);
+    for (int i = 0; i < FLEET_NSIZES; i++) {
+        char name[16];
+        snprintf(name, sizeof(name), "%d", FLEET_SIZES[i]);
+        glutAddMenuEntry(name, FLEET_SIZES[i]);
+    }
+    
+    int cullingmenu = glutCreateMenu(DoCullingMenu);
+    for (int mode = CULLING_OFF; mode <= CULLING_OCCLUSION; mode++)
+        glutAddMenuEntry(CULLING_NAMES[mode], mode);
+    
+    int layersmenu = glutCreateMenu(DoLayersMenu);
+    glutAddMenuEntry("Off",  0);
+    glutAddMenuEntry("On",   1);
+    
+    int resolutionmenu = glutCreateMenu(DoResolutionMenu);
+    glutAddMenuEntry("Native",   0);
+    glutAddMenuEntry("Dynamic",  1);
+    
+    int statsmenu = glutCreateMenu(DoStatsMenu);
+    glutAddMenuEntry("Off",  0);
+    glutAddMenuEntry("On",   1);
+    
+    int statecachemenu = glutCreateMenu(DoStateCacheMenu);
+    glutAddMenuEntry("Off",  0);
+    glutAddMenuEntry("On",   1);
+    
+    int pacingmenu = glutCreateMenu(DoPacingMenu);
+    glutAddMenuEntry("Off",  0);
+    for (int n = 1; n <= PACER_MAX_FRAMES; n++) {
+        char name[16];
+        snprintf(name, sizeof(name), "%d", n);
+        glutAddMenuEntry(name, n);
+    }
+    
+    int quantizedmenu = glutCreateMenu(DoQuantizedMenu);
+    glutAddMenuEntry("Off",  0);
+    glutAddMenuEntry("On",   1);
+    
+    int stripsmenu = glutCreateMenu(DoStripsMenu);
+    glutAddMenuEntry("Off",  0);
+    glutAddMenuEntry("On",   1);
+    
+    int simulationmenu = glutCreateMenu(DoSimulationMenu);
+    glutAddMenuEntry("Off",  0);
+    glutAddMenuEntry("On",   1);
+    
     glutCreateMenu(DoMainMenu);
     glutAddSubMenu(  "Axes",          axesmenu);
     glutAddSubMenu(  "View",          perspmenu);
+    glutAddSubMenu(  "Hull",          hullmenu);
+    glutAddSubMenu(  "Fleet",         fleetmenu);
+    glutAddSubMenu(  "Culling",       cullingmenu);
+    glutAddSubMenu(  "Layers",        layersmenu);
+    glutAddSubMenu(  "Resolution",    resolutionmenu);
+    glutAddSubMenu(  "Quantized",     quantizedmenu);
+    glutAddSubMenu(  "Strips",        stripsmenu);
+    glutAddSubMenu(  "State Cache",   statecachemenu);
+    glutAddSubMenu(  "Frames In Flight", pacingmenu);
+    glutAddSubMenu(  "Simulation",    simulationmenu);
     glutAddMenuEntry("Reset",         RESET);
+    glutAddSubMenu(  "Stats",         statsmenu);
     glutAddSubMenu(  "Debug",         debugmenu);
     glutAddMenuEntry("Quit",          QUIT);
     
@@ -471,21 +1732,18 @@ void InitGraphics() {
     // set the initial window configuration:
     glutInitWindowPosition(0, 0);
     glutInitWindowSize(INITIAL_WINDOW_SIZE, INITIAL_WINDOW_SIZE);
+    requestRendererContext(*SceneRenderer);
     
     // open the window and set its title:
     MainWindow = glutCreateWindow(WINDOW_TITLE);
     glutSetWindowTitle(WINDOW_TITLE);
     
-    // set the framebuffer clear values:
-    glClearColor(BACKCOLOR[0], BACKCOLOR[1], BACKCOLOR[2], BACKCOLOR[3]);
-    
-    
     glutSetWindow(MainWindow);
     glutDisplayFunc(Display);
     glutKeyboardFunc(Keyboard);
     glutMouseFunc(MouseButton);
     glutMotionFunc(MouseMotion);
-    glutPassiveMotionFunc(NULL);
+    glutPassiveMotionFunc(PassiveMotion);
     glutEntryFunc(NULL);
     glutSpecialFunc(NULL);
     glutSpaceballMotionFunc(NULL);
@@ -511,6 +1769,13 @@ void InitGraphics() {
     fprintf( stderr, "Status: Using GLEW %s\n", glewGetString(GLEW_VERSION));
 #endif
     
+    loadGLProcs();
+    if (!checkRendererContext(*SceneRenderer))
+        exit(1);
+    initFramePacer(FramePacing, FRAMES_IN_FLIGHT);
+    
+    // set the framebuffer clear values (after loadGLProcs(), so a capture has it):
+    glClearColor(BACKCOLOR[0], BACKCOLOR[1], BACKCOLOR[2], BACKCOLOR[3]);
 }
 
 void initAxes() {
@@ -525,97 +1790,614 @@ void initAxes() {
 void InitLists() {
     glutSetWindow(MainWindow);
     
+    // everything below is built from the repaired triangles:
+    MeshRepairReport repair = repairMesh(CESSNApoints, CESSNAtris, &CESSNAntris);
+    reportMeshRepair(repair);
+    CessnaClosedTris = repair.closedTris;
+    
+    CessnaMirror = buildMirrorMesh(CESSNApoints, CESSNAnpoints, CESSNAedges, CESSNAnedges,
+                                   CESSNAtris, CESSNAntris, CessnaClosedTris);
+    reportMirrorMesh(CessnaMirror, CESSNAnpoints, CESSNAnedges, CESSNAntris);
+    
+    int npoints = (int)CessnaMirror.points.size();
+    CessnaHalfChains = chainEdges(CessnaMirror.halfEdges, npoints);
+    CessnaSingleChains = chainEdges(CessnaMirror.singleEdges, npoints);
+    reportEdgeChains("half", CessnaHalfChains);
+    reportEdgeChains("single", CessnaSingleChains);
+    
+    CessnaHalfEdges = buildHalfEdgeMesh(CESSNApoints, CESSNAtris, CESSNAntris);
+    
+    buildCessnaBVH();
+    float eye[3] = { COCKPIT_EYE[0], COCKPIT_EYE[1], COCKPIT_EYE[2] };
+    CessnaCockpitPVS = buildPVS(CessnaBVH, eye, CESSNAtris, CESSNAntris, CESSNAedges, CESSNAnedges, CESSNAnpoints);
+    reportPVS("cockpit", CessnaCockpitPVS, CESSNAntris, CESSNAnedges);
+    computeCessnaBounds();
+
+    SceneRenderer->initLists();
+    if (!initDynamicResolution(SceneResolution))
+        fprintf(stderr, "Dynamic resolution is not available\n");
+    setFleetSize(1);
+}
+
+// display lists and the rest for drawLegacyScene():
+void initLegacyLists() {
     createCessnaWireframe();
+    createCessnaSolid();
+    createCessnaQuantized();
+    createCessnaBary();
     createCessnaPropeller();
+    createCessnaCockpit();
+    initOcclusionCuller(FleetOcclusion, CessnaBVH.bounds);
+    if (!initStreamRing(LegacyRing, STREAM_RING_REGION))
+        fprintf(stderr, "Stream ring is not available, per-frame vertices go through glBegin/glEnd\n");
+    if (!initCachedLayer(StaticLayer))
+        fprintf(stderr, "Cached static layer is not available\n");
 
     initAxes();
 }
 
+// the same shapes as VAOs for drawCoreScene(): the whole hull rather than
+//    mirror halves, each triangle with its own three vertices so it can
+//    have its own flat shade
+void initCoreLists() {
+    if (!initCoreRenderer(CoreScene)) {
+        fprintf(stderr, "The core-profile renderer could not be set up\n");
+        exit(1);
+    }
+
+    std::vector<GLfloat> v;
+    auto addTri = [&v](struct tri const &t) {
+        float g = cessnaTriShade(CESSNApoints, t);
+        for (int p : { t.p0, t.p1, t.p2 })
+            v.insert(v.end(), { CESSNApoints[p].x, CESSNApoints[p].y, CESSNApoints[p].z, 0.f, g, 0.f });
+    };
+    auto addEdge = [&v](struct edge const &e) {
+        for (int p : { e.p0, e.p1 })
+            v.insert(v.end(), { CESSNApoints[p].x, CESSNApoints[p].y, CESSNApoints[p].z });
+    };
+
+    for (int i = 0; i < CessnaClosedTris; i++)
+        addTri(CESSNAtris[i]);
+    CoreCessnaSolid = coreMesh(GL_TRIANGLES, v.data(), (int)v.size() / 6, true);
+    v.clear();
+    for (int i = CessnaClosedTris; i < CESSNAntris; i++)
+        addTri(CESSNAtris[i]);
+    CoreCessnaOpen = coreMesh(GL_TRIANGLES, v.data(), (int)v.size() / 6, true);
+    v.clear();
+    for (int i : CessnaCockpitPVS.tris)
+        addTri(CESSNAtris[i]);
+    CoreCockpitSolid = coreMesh(GL_TRIANGLES, v.data(), (int)v.size() / 6, true);
+
+    v.clear();
+    for (int i = 0; i < CESSNAnedges; i++)
+        addEdge(CESSNAedges[i]);
+    CoreCessnaWire = coreMesh(GL_LINES, v.data(), (int)v.size() / 3, false);
+    v.clear();
+    for (int i : CessnaCockpitPVS.edges)
+        addEdge(CESSNAedges[i]);
+    CoreCockpitWire = coreMesh(GL_LINES, v.data(), (int)v.size() / 3, false);
+
+    std::vector<GLuint> const &feature = CessnaHalfEdges.featureIndices;
+    CoreCessnaFeatures = coreMesh(GL_LINES, &CESSNApoints[0].x, CESSNAnpoints, false);
+    coreMeshIndices(CoreCessnaFeatures, feature.data(), (int)feature.size(), GL_STATIC_DRAW);
+    CoreCessnaSilhouette = coreMesh(GL_LINES, &CESSNApoints[0].x, CESSNAnpoints, false);
+
+    CorePropeller = coreMesh(GL_TRIANGLES, &PROPELLER_VERTICES[0][0], 6, false);
+
+    std::vector<GLfloat> axes = axesLines(1.5);
+    CoreAxes = coreMesh(GL_LINES, axes.data(), (int)axes.size() / 3, false);
+
+    fprintf(stderr, "Core renderer: the quantized, strip, single-pass, cached-layer and occlusion-culled paths "
+                    "are legacy only and fall back\n");
+}
+
 void setColor(float r, float g, float b) {
     glColor3f(r, g, b);
 }
 
-void createCessnaWireframe() {
-    CessnaWireList = glGenLists(1);
-    glNewList(CessnaWireList, GL_COMPILE);
-    
-    int i;
-    struct edge *ep;
-    struct point *p0, *p1;
+// position the cessna model in the scene:
+void cessnaPlacement(GLfloat m[16]) {
+    matRotate(m, -7., 0., 1., 0.);
+    matTranslate(m,  0., -1., 0. );
+    matRotate(m,  97.,   0., 1., 0. );
+    matRotate(m, -15.,   0., 0., 1. );
+}
+
+void applyCessnaPlacement() {
+    GLfloat m[16];
+    matIdentity(m);
+    cessnaPlacement(m);
+    glMultMatrixf(m);
+}
+
+// the whole wireframe: the single edges, then the half and its reflection
+//    (reflecting flips the winding)
+GLuint createCessnaWireList(GLuint halfList, void (*drawSingle)()) {
+    GLuint list = glGenLists(1);
+    glNewList(list, GL_COMPILE);
 
     glPushMatrix();
-    glRotatef(-7., 0., 1., 0.);
-    glTranslatef( 0., -1., 0. );
-    glRotatef(  97.,   0., 1., 0. );
-    glRotatef( -15.,   0., 0., 1. );
-    glBegin( GL_LINES );
+    applyCessnaPlacement();
 
     // red
     setColor(1, 0, 0);
 
-    for (i=0, ep = CESSNAedges; i < CESSNAnedges; i++, ep++) {
-        p0 = &CESSNApoints[ ep->p0 ];
-        p1 = &CESSNApoints[ ep->p1 ];
-        glVertex3f( p0->x, p0->y, p0->z );
-        glVertex3f( p1->x, p1->y, p1->z );
+    drawSingle();
+
+    glCallList(halfList);
+    if (CessnaMirror.axis >= 0) {
+        glPushMatrix();
+        applyMirrorReflection(CessnaMirror);
+        glFrontFace(GL_CW);
+        glCallList(halfList);
+        glFrontFace(GL_CCW);
+        glPopMatrix();
     }
+
+    glPopMatrix();
     
+    glEndList();
+    return list;
+}
+
+void drawCessnaEdges(std::vector<struct edge> const &edges) {
+    glBegin( GL_LINES );
+    for (struct edge const &e : edges) {
+        struct point const &p0 = CessnaMirror.points[ e.p0 ];
+        struct point const &p1 = CessnaMirror.points[ e.p1 ];
+        glVertex3f( p0.x, p0.y, p0.z );
+        glVertex3f( p1.x, p1.y, p1.z );
+    }
+    glEnd();
+}
+
+void drawCessnaStrips(EdgeChains const &ec) {
+    glBegin( GL_LINE_STRIP );
+    for (int i : ec.indices) {
+        if (i == EDGECHAIN_RESTART) {
+            glEnd();
+            glBegin( GL_LINE_STRIP );
+            continue;
+        }
+        struct point const &p = CessnaMirror.points[ i ];
+        glVertex3f( p.x, p.y, p.z );
+    }
+    glEnd();
+}
+
+void createCessnaWireframe() {
+    CessnaHalfWireList = glGenLists(1);
+    glNewList(CessnaHalfWireList, GL_COMPILE);
+    drawCessnaEdges(CessnaMirror.halfEdges);
+    glEndList();
+
+    CessnaHalfWireStripList = glGenLists(1);
+    glNewList(CessnaHalfWireStripList, GL_COMPILE);
+    drawCessnaStrips(CessnaHalfChains);
+    glEndList();
+
+    CessnaWireList = createCessnaWireList(CessnaHalfWireList,
+                                          []() { drawCessnaEdges(CessnaMirror.singleEdges); });
+    CessnaWireStripList = createCessnaWireList(CessnaHalfWireStripList,
+                                               []() { drawCessnaStrips(CessnaSingleChains); });
+}
+
+// the green of a flat-shaded triangle, with fake "lighting" from above:
+float cessnaTriShade(struct point const *points, struct tri const &t) {
+    struct point const &p0 = points[ t.p0 ];
+    struct point const &p1 = points[ t.p1 ];
+    struct point const &p2 = points[ t.p2 ];
+    float p01[3] = { p1.x - p0.x, p1.y - p0.y, p1.z - p0.z };
+    float p02[3] = { p2.x - p0.x, p2.y - p0.y, p2.z - p0.z };
+    float n[3];
+
+    Cross(p01, p02, n);
+    Unit(n, n);
+    n[1] = fabs( n[1] );
+    n[1] += .25;
+    if( n[1] > 1. )
+        n[1] = 1.;
+    return n[1];
+}
+
+// ... drawn:
+void shadeCessnaTri(struct point const *points, struct tri const &t) {
+    struct point const &p0 = points[ t.p0 ];
+    struct point const &p1 = points[ t.p1 ];
+    struct point const &p2 = points[ t.p2 ];
+    glColor3f( 0., cessnaTriShade(points, t), 0. );
+
+    glVertex3f( p0.x, p0.y, p0.z );
+    glVertex3f( p1.x, p1.y, p1.z );
+    glVertex3f( p2.x, p2.y, p2.z );
+}
+
+// the solid hull's closed components, or the rest:
+GLuint createCessnaSolidList(bool closed) {
+    MirrorMesh const &mm = CessnaMirror;
+    int halfFirst = closed ? 0 : mm.halfClosed;
+    int halfLast = closed ? mm.halfClosed : (int)mm.halfTris.size();
+    int singleFirst = closed ? 0 : mm.singleClosed;
+    int singleLast = closed ? mm.singleClosed : (int)mm.singleTris.size();
+
+    // the half that gets drawn twice:
+    //    the shade only depends on |n.y|, which a reflection does not change
+    GLuint halfList = glGenLists(1);
+    glNewList(halfList, GL_COMPILE);
+    glBegin(GL_TRIANGLES);
+    for (int i = halfFirst; i < halfLast; i++) {
+        shadeCessnaTri(mm.points.data(), mm.halfTris[i]);
+    }
+    glEnd();
+    glEndList();
+
+    GLuint list = glGenLists(1);
+    glNewList(list, GL_COMPILE);
+
+    glPushMatrix();
+    applyCessnaPlacement();
+
+    glBegin(GL_TRIANGLES);
+    for (int i = singleFirst; i < singleLast; i++) {
+        shadeCessnaTri(mm.points.data(), mm.singleTris[i]);
+    }
     glEnd();
+
+    glCallList(halfList);
+    if (mm.axis >= 0) {
+        glPushMatrix();
+        applyMirrorReflection(mm);
+        glFrontFace(GL_CW);
+        glCallList(halfList);
+        glFrontFace(GL_CCW);
+        glPopMatrix();
+    }
+
     glPopMatrix();
-    
+
     glEndList();
+    return list;
 }
 
-//void CESSNAshade() {
-//
-//    CessnaList = glGenLists(1);
-//    glNewList(CessnaList, GL_COMPILE);
-//
-//    int i;
-//    struct tri *tp;
-//    float p01[3], n[3];
-////    struct edge *ep;
-//    struct point *p0, *p1;
-//
-//    glPushMatrix();
-//    glRotatef(-7., 0., 1., 0.);
-//    glTranslatef( 0., -1., 0. );
-//    glRotatef(  97.,   0., 1., 0. );
-//    glRotatef( -15.,   0., 0., 1. );
-//    glBegin(GL_TRIANGLES);
-//
-//
-//    for (i=0, tp = CESSNAtris; i < CESSNAntris; i++, tp++) {
-//        p0 = &CESSNApoints[ tp->p0 ];
-//        p1 = &CESSNApoints[ tp->p1 ];
-//
-//        /* fake "lighting" from above:            */
-//
-//        p01[0] = p1->x - p0->x;
-//        p01[1] = p1->y - p0->y;
-//        p01[2] = p1->z - p0->z;
-////        Unit( n, n );
-//        n[1] = fabs( n[1] );
-//        n[1] += .25;
-//        if( n[1] > 1. )
-//            n[1] = 1.;
-//        glColor3f( 0., n[1], 0. );
-//
-//        glVertex3f( p0->x, p0->y, p0->z );
-//        glVertex3f( p1->x, p1->y, p1->z );
-//    }
-//    glEnd( );
-//    glPopMatrix( );
-//
-//    glEndList();
-//}
+void createCessnaSolid() {
+    CessnaList = createCessnaSolidList(true);
+    CessnaOpenList = createCessnaSolidList(false);
+}
 
-void createCessnaPropeller() {
-    // propeller parameters:
+void createCessnaQuantized() {
+    CessnaQuant = buildQuantMesh(CessnaMirror, CessnaHalfChains, CessnaSingleChains);
+    CessnaQuantReady = uploadQuantMesh(CessnaQuant);
+    if (!CessnaQuantReady)
+        fprintf(stderr, "Quantized cessna is not available, using display lists\n");
+}
 
-    #define PROPELLER_RADIUS     1.0
-    #define PROPELLER_WIDTH      0.4
-    
+void createCessnaBary() {
+    CessnaBary = buildBaryMesh(CessnaMirror, CESSNApoints, CESSNAedges, CESSNAnedges);
+    CessnaBaryReady = uploadBaryMesh(CessnaBary);
+    if (!CessnaBaryReady)
+        fprintf(stderr, "Single-pass hull is not available, using two passes\n");
+}
+
+// draw only the creases, boundaries, and the silhouette from where we are now:
+void drawCessnaFeatureEdges() {
+    glPushMatrix();
+    applyCessnaPlacement();
+
+    float eye[3];
+    eyeInModelCoordinates(eye);
+    computeSilhouette(CessnaHalfEdges, eye);
+
+    setColor(1, 0, 0);
+    glEnableClientState(GL_VERTEX_ARRAY);
+    glVertexPointer(3, GL_FLOAT, 0, CESSNApoints);
+    std::vector<GLuint> const &feature = CessnaHalfEdges.featureIndices;
+    std::vector<GLuint> const &silhouette = CessnaHalfEdges.silhouetteIndices;
+    glDrawElements(GL_LINES, (GLsizei)feature.size(), GL_UNSIGNED_INT, feature.data());
+    glDrawElements(GL_LINES, (GLsizei)silhouette.size(), GL_UNSIGNED_INT, silhouette.data());
+    glDisableClientState(GL_VERTEX_ARRAY);
+
+    glPopMatrix();
+
+    if (DebugOn)
+        logPrint("Feature edges: %zu + %zu silhouette of %d\n",
+                 feature.size()/2, silhouette.size()/2, CESSNAnedges);
+}
+
+// depth-only pass of the hull, then only the edges in front of it:
+//    the polygon offset pushes the triangles back so their own edges pass
+void drawCessnaHiddenLine() {
+    glColorMask(GL_FALSE, GL_FALSE, GL_FALSE, GL_FALSE);
+    stateEnable(GL_POLYGON_OFFSET_FILL);
+    glPolygonOffset(HIDDEN_LINE_OFFSET_FACTOR, HIDDEN_LINE_OFFSET_UNITS);
+    drawCessnaSolid();
+    stateDisable(GL_POLYGON_OFFSET_FILL);
+    glColorMask(GL_TRUE, GL_TRUE, GL_TRUE, GL_TRUE);
+
+    stateDepthFunc(GL_LEQUAL);
+    drawCessnaWire();
+    stateDepthFunc(GL_LESS);
+}
+
+// once every triangle faces outward the back-facing half never needs rasterizing;
+//    only the closed components are drawn in between, the rest after:
+void beginCessnaCulling() {
+    glCullFace(GL_BACK);
+    stateEnable(GL_CULL_FACE);
+}
+
+void endCessnaCulling() {
+    stateDisable(GL_CULL_FACE);
+}
+
+void drawCessnaSolid() {
+    if (QuantizedOn && CessnaQuantReady) {
+        glPushMatrix();
+        applyCessnaPlacement();
+        beginCessnaCulling();
+        drawQuantMesh(CessnaQuant, CessnaMirror, QUANT_CLOSED_TRIS, false, false);
+        endCessnaCulling();
+        drawQuantMesh(CessnaQuant, CessnaMirror, QUANT_OPEN_TRIS, false, false);
+        glPopMatrix();
+    } else {
+        beginCessnaCulling();
+        glCallList(CessnaList);
+        endCessnaCulling();
+        glCallList(CessnaOpenList);
+    }
+}
+
+void drawCessnaWire() {
+    if (QuantizedOn && CessnaQuantReady) {
+        glPushMatrix();
+        applyCessnaPlacement();
+        drawQuantMesh(CessnaQuant, CessnaMirror, QUANT_NO_TRIS, true, StripsOn);
+        glPopMatrix();
+    } else {
+        glCallList(StripsOn ? CessnaWireStripList : CessnaWireList);
+    }
+}
+
+// from the cockpit only the PVS is drawn, straight from the full (not
+//    mirror-compressed) mesh since it is no longer symmetric:
+void createCessnaCockpit() {
+    CessnaCockpitList = glGenLists(1);
+    glNewList(CessnaCockpitList, GL_COMPILE);
+    glPushMatrix();
+    applyCessnaPlacement();
+    glBegin(GL_TRIANGLES);
+    for (int i : CessnaCockpitPVS.tris)
+        shadeCessnaTri(CESSNApoints, CESSNAtris[i]);
+    glEnd();
+    glPopMatrix();
+    glEndList();
+
+    CessnaCockpitWireList = glGenLists(1);
+    glNewList(CessnaCockpitWireList, GL_COMPILE);
+    glPushMatrix();
+    applyCessnaPlacement();
+    setColor(1, 0, 0);
+    glBegin(GL_LINES);
+    for (int i : CessnaCockpitPVS.edges) {
+        struct point const &p0 = CESSNApoints[ CESSNAedges[i].p0 ];
+        struct point const &p1 = CESSNApoints[ CESSNAedges[i].p1 ];
+        glVertex3f( p0.x, p0.y, p0.z );
+        glVertex3f( p1.x, p1.y, p1.z );
+    }
+    glEnd();
+    glPopMatrix();
+    glEndList();
+}
+
+// the hull as seen from the INSIDE camera, in the nearest thing to the current hull mode:
+//    the PVS edges are only right when the triangles' depth hides the others,
+//    so the line-only modes draw the whole hull
+void drawCessnaCockpit() {
+    switch (WhichHullMode) {
+        case WIREFRAME:
+        case FEATURE_EDGES:
+            drawCessna();
+            return;
+
+        case HIDDEN_LINE:
+            glColorMask(GL_FALSE, GL_FALSE, GL_FALSE, GL_FALSE);
+            stateEnable(GL_POLYGON_OFFSET_FILL);
+            glPolygonOffset(HIDDEN_LINE_OFFSET_FACTOR, HIDDEN_LINE_OFFSET_UNITS);
+            glCallList(CessnaCockpitList);
+            stateDisable(GL_POLYGON_OFFSET_FILL);
+            glColorMask(GL_TRUE, GL_TRUE, GL_TRUE, GL_TRUE);
+            stateDepthFunc(GL_LEQUAL);
+            glCallList(CessnaCockpitWireList);
+            stateDepthFunc(GL_LESS);
+            break;
+
+        default:
+            glCallList(CessnaCockpitList);
+            glCallList(CessnaCockpitWireList);
+    }
+    stateInvalidateColor();         // the lists set their own
+}
+
+// draw the hull the way the Hull, Quantized, and Strips menus say:
+void drawCessna() {
+    switch (WhichHullMode) {
+        case FEATURE_EDGES:
+            drawCessnaFeatureEdges();
+            break;
+
+        case SINGLE_PASS:
+            if (CessnaBaryReady) {
+                glPushMatrix();
+                applyCessnaPlacement();
+                beginCessnaCulling();
+                drawBaryMesh(CessnaBary, CessnaMirror, true);
+                endCessnaCulling();
+                drawBaryMesh(CessnaBary, CessnaMirror, false);
+                glPopMatrix();
+                break;
+            }
+            drawCessnaSolid();
+            drawCessnaWire();
+            break;
+
+        case HIDDEN_LINE:
+            drawCessnaHiddenLine();
+            break;
+
+        case SOLID:
+            drawCessnaSolid();
+            drawCessnaWire();
+            break;
+
+        default:
+            drawCessnaWire();
+    }
+    stateInvalidateColor();         // the lists and setColor() set their own
+}
+
+
+void buildCessnaBVH() {
+    // the placement as a matrix:
+    GLfloat m[16];
+    matIdentity(m);
+    cessnaPlacement(m);
+
+    CessnaScenePoints.resize(CESSNAnpoints);
+    for (int i = 0; i < CESSNAnpoints; i++) {
+        struct point const &p = CESSNApoints[i];
+        struct point &q = CessnaScenePoints[i];
+        q.x = m[0]*p.x + m[4]*p.y + m[8]*p.z  + m[12];
+        q.y = m[1]*p.x + m[5]*p.y + m[9]*p.z  + m[13];
+        q.z = m[2]*p.x + m[6]*p.y + m[10]*p.z + m[14];
+    }
+
+    std::vector<BVHPrimitive> prims;
+    for (int i = 0; i < CESSNAntris; i++) {
+        BVHPrimitive p;
+        p.type = BVH_TRIANGLE;
+        p.id = i;
+        struct point const *v[3] = { &CessnaScenePoints[CESSNAtris[i].p0],
+                                     &CessnaScenePoints[CESSNAtris[i].p1],
+                                     &CessnaScenePoints[CESSNAtris[i].p2] };
+        float *corner[3] = { p.a, p.b, p.c };
+        for (int k = 0; k < 3; k++) {
+            corner[k][0] = v[k]->x;
+            corner[k][1] = v[k]->y;
+            corner[k][2] = v[k]->z;
+        }
+        prims.push_back(p);
+    }
+    for (int i = NOSE_PROPELLER; i <= RIGHT_PROPELLER; i++) {
+        BVHPrimitive p = {};
+        p.type = BVH_DISC;
+        p.id = i;
+        for (int k = 0; k < 3; k++) {
+            p.a[k] = PROPELLER_DISCS[i][k];
+            p.b[k] = PROPELLER_DISCS[i][3 + k];
+        }
+        p.c[0] = PROPELLER_DISCS[i][6];
+        prims.push_back(p);
+    }
+
+    auto start = std::chrono::steady_clock::now();
+    CessnaBVH = buildBVH(prims);
+    auto stop = std::chrono::steady_clock::now();
+    reportBVH(CessnaBVH, std::chrono::duration<double, std::milli>(stop - start).count());
+
+    PickedId = -1;
+}
+
+// bounding box and spheres for frustum culling:
+void computeCessnaBounds() {
+    CessnaHullBox.reset();
+    for (struct point const &p : CessnaScenePoints) {
+        float v[3] = { p.x, p.y, p.z };
+        CessnaHullBox.grow(v);
+    }
+
+    // spheres centered on their boxes, as tight as the points allow:
+    BVHBounds const *boxes[2] = { &CessnaHullBox, &CessnaBVH.bounds };
+    BoundingSphere *spheres[2] = { &CessnaHullSphere, &CessnaSphere };
+    for (int b = 0; b < 2; b++) {
+        BoundingSphere &s = *spheres[b];
+        for (int k = 0; k < 3; k++)
+            s.c[k] = (boxes[b]->lo[k] + boxes[b]->hi[k]) / 2.f;
+        float r2 = 0.;
+        for (struct point const &p : CessnaScenePoints) {
+            float d[3] = { p.x - s.c[0], p.y - s.c[1], p.z - s.c[2] };
+            r2 = fmaxf(r2, Dot(d, d));
+        }
+        s.r = sqrtf(r2);
+    }
+    for (int i = NOSE_PROPELLER; i <= RIGHT_PROPELLER; i++) {
+        float const *d = PROPELLER_DISCS[i];
+        float v[3] = { d[0] - CessnaSphere.c[0], d[1] - CessnaSphere.c[1], d[2] - CessnaSphere.c[2] };
+        CessnaSphere.r = fmaxf(CessnaSphere.r, sqrtf(Dot(v, v)) + d[6]);
+    }
+}
+
+// lay out n aircraft and build the tree over them:
+void setFleetSize(int n) {
+    FleetSize = n;
+    resizeFleet(CessnaFleet, n);
+    updateFleet(CessnaFleet, Time);
+    CessnaTLAS = TLAS{};
+    buildTLAS(CessnaTLAS, CessnaFleet, CessnaBVH);
+    if (n > 1)
+        reportTLAS(CessnaTLAS);
+    PickedId = -1;
+}
+
+// highlight whatever the mouse is over:
+void drawPicked() {
+    if (PickedId < 0)
+        return;
+
+    glPushMatrix();
+    if (PickedInstance > 0)
+        glMultMatrixf(CessnaFleet.instances[PickedInstance].m);
+    stateColor3f(1., 1., 0.);
+    stateDepthFunc(GL_LEQUAL);
+    if (PickedType == BVH_TRIANGLE) {
+        struct tri const &t = CESSNAtris[PickedId];
+        struct point const *v[3] = { &CessnaScenePoints[t.p0], &CessnaScenePoints[t.p1], &CessnaScenePoints[t.p2] };
+        stateEnable(GL_POLYGON_OFFSET_FILL);
+        glPolygonOffset(-1., -1.);
+        glBegin(GL_TRIANGLES);
+        for (int k = 0; k < 3; k++)
+            glVertex3f(v[k]->x, v[k]->y, v[k]->z);
+        glEnd();
+        stateDisable(GL_POLYGON_OFFSET_FILL);
+    } else {
+        GLfloat outline[DISC_OUTLINE][3];
+        discOutline(PickedId, outline, DISC_OUTLINE);
+        glBegin(GL_LINE_LOOP);
+        for (int i = 0; i < DISC_OUTLINE; i++)
+            glVertex3f(outline[i][0], outline[i][1], outline[i][2]);
+        glEnd();
+    }
+    stateDepthFunc(GL_LESS);
+    glPopMatrix();
+}
+
+// n points around a propeller's disc: two unit vectors perpendicular to its normal
+void discOutline(int propeller, GLfloat v[][3], int n) {
+    float const *d = PROPELLER_DISCS[propeller];
+    float normal[3] = { d[3], d[4], d[5] };
+    float a[3] = { 1., 0., 0. }, b[3];
+    if (fabs(normal[0]) > .9)
+        a[0] = 0., a[1] = 1.;
+    Cross(normal, a, b);
+    Unit(b, b);
+    Cross(b, normal, a);
+    for (int i = 0; i < n; i++) {
+        float ang = 2.f * (float)M_PI * i / n;
+        float c = d[6] * cosf(ang), s = d[6] * sinf(ang);
+        for (int k = 0; k < 3; k++)
+            v[i][k] = d[k] + c*a[k] + s*b[k];
+    }
+}
+
+void createCessnaPropeller() {
     CessnaPropellerList = glGenLists(1);
     glNewList(CessnaPropellerList, GL_COMPILE);
 
@@ -645,22 +2427,49 @@ void FunkyTargetThingy() {
     glTranslatef(0, 1, 15.);
     glRotatef(90., 90, 0, -5);
     glScalef(2,2,2);
+    GLfloat v[SPIRAL_VERTICES][6];
+    funkySpiral(v);
+    GLintptr offset = LegacyRing.ready ? streamUpload(LegacyRing, v, sizeof(v), sizeof(GLfloat)) : -1;
+    if (offset >= 0) {
+        GL.BindBuffer(GL_ARRAY_BUFFER, LegacyRing.buffer);
+        glEnableClientState(GL_VERTEX_ARRAY);
+        glEnableClientState(GL_COLOR_ARRAY);
+        glVertexPointer(3, GL_FLOAT, sizeof(v[0]), (void const *)offset);
+        glColorPointer(3, GL_FLOAT, sizeof(v[0]), (void const *)(offset + 3 * sizeof(GLfloat)));
+        glDrawArrays(GL_LINE_LOOP, 0, SPIRAL_VERTICES);
+        glDisableClientState(GL_COLOR_ARRAY);
+        glDisableClientState(GL_VERTEX_ARRAY);
+        GL.BindBuffer(GL_ARRAY_BUFFER, 0);
+        return;
+    }
     glBegin(GL_LINE_LOOP);
     
-    for (int y = 0; y < 200; y++) {
-        float deg = y / 10.;
-        if (y < 40) glColor3f(0, y/80., 128/255.);
-        else if (y < 80) glColor3f(0, 128/255., (80-y)/80.);
-        else if (y < 120) glColor3f((y-80.)/80., 128/255., 0);
-        else glColor3f(128/255., (160-y)/80., 0);
-        glVertex3f(cosf(deg)/2., y/200.*sinf(Time), sinf(deg)/2.);
-        glVertex3f(cosf(deg), y/80.*sinf(Time), sinf(deg));
+    for (int i = 0; i < SPIRAL_VERTICES; i++) {
+        glColor3f(v[i][3], v[i][4], v[i][5]);
+        glVertex3f(v[i][0], v[i][1], v[i][2]);
     }
     
     glEnd();
 
 }
 
+// its line loop, xyz rgb, for this Time:
+void funkySpiral(GLfloat v[][6]) {
+    for (int y = 0; y < SPIRAL_VERTICES / 2; y++) {
+        float deg = y / 10.;
+        float c[3];
+        if (y < 40) c[0] = 0, c[1] = y/80., c[2] = 128/255.;
+        else if (y < 80) c[0] = 0, c[1] = 128/255., c[2] = (80-y)/80.;
+        else if (y < 120) c[0] = (y-80.)/80., c[1] = 128/255., c[2] = 0;
+        else c[0] = 128/255., c[1] = (160-y)/80., c[2] = 0;
+        GLfloat *a = v[2*y], *b = v[2*y + 1];
+        a[0] = cosf(deg)/2.,    a[1] = y/200.*sinf(Time),   a[2] = sinf(deg)/2.;
+        b[0] = cosf(deg),       b[1] = y/80.*sinf(Time),    b[2] = sinf(deg);
+        memcpy(a + 3, c, sizeof(c));
+        memcpy(b + 3, c, sizeof(c));
+    }
+}
+
 
 
 
@@ -670,9 +2479,13 @@ void Reset() {
     ActiveButton = 0;
     AxesOn = 0;
     DebugOn = 0;
+    WhichCulling = CULLING_FRUSTUM;
+    StatsOn = 0;
+    GLState.on = true;
     Scale  = 1.0;
     Xrot = Yrot = 0.;
     Frozen = 0;
+    Simulation.reset = true;
 }
 
 
@@ -721,16 +2534,33 @@ const float BASEFRAC = 1.10f;
 //    Draw a set of 3D axes:
 //    (length is the axis length in world coordinates)
 void Axes(float length) {
-    // Draw axis lines
-    glBegin(GL_LINE_STRIP);
-    glVertex3f(length, 0., 0.);
-    glVertex3f(0., 0., 0.);
-    glVertex3f(0., length, 0.);
-    glEnd();
-    glBegin(GL_LINE_STRIP);
-    glVertex3f(0., 0., 0.);
-    glVertex3f(0., 0., length);
+    std::vector<GLfloat> lines = axesLines(length);
+    glBegin(GL_LINES);
+    for (size_t i = 0; i < lines.size(); i += 3)
+        glVertex3f(lines[i], lines[i + 1], lines[i + 2]);
     glEnd();
+}
+
+// ... as GL_LINES pairs:
+std::vector<GLfloat> axesLines(float length) {
+    std::vector<GLfloat> lines;
+    GLfloat last[3];
+    bool strip = false;             // last is the end of a line strip so far
+    auto lineTo = [&](float x, float y, float z) {
+        if (strip)
+            lines.insert(lines.end(), { last[0], last[1], last[2], x, y, z });
+        last[0] = x, last[1] = y, last[2] = z;
+        strip = true;
+    };
+
+    // axis lines
+    lineTo(length, 0., 0.);
+    lineTo(0., 0., 0.);
+    lineTo(0., length, 0.);
+    strip = false;
+    lineTo(0., 0., 0.);
+    lineTo(0., 0., length);
+    strip = false;
     
     
     // Set length fractions
@@ -738,45 +2568,71 @@ void Axes(float length) {
     float base = BASEFRAC * length;
     
     // Draw stroke X
-    glBegin(GL_LINE_STRIP);
     for (int i = 0; i < 4; i++) {
         int j = x_order[i];
         if (j < 0) {
-            glEnd();
-            glBegin(GL_LINE_STRIP);
+            strip = false;
             j = -j;
         }
         j--;
-        glVertex3f(base + fact*xx[j], fact*xy[j], 0.0);
+        lineTo(base + fact*xx[j], fact*xy[j], 0.0);
     }
-    glEnd();
+    strip = false;
     
     // Draw stroke Y
-    glBegin(GL_LINE_STRIP);
     for (int i = 0; i < 5; i++) {
         int j = y_order[i];
         if (j < 0) {
-            glEnd();
-            glBegin(GL_LINE_STRIP);
+            strip = false;
             j = -j;
         }
         j--;
-        glVertex3f(fact*yx[j], base + fact*yy[j], 0.0);
+        lineTo(fact*yx[j], base + fact*yy[j], 0.0);
     }
-    glEnd();
+    strip = false;
     
     // Draw stroke Z
-    glBegin(GL_LINE_STRIP);
     for (int i = 0; i < 6; i++) {
         int j = z_order[i];
         if (j < 0) {
-            glEnd();
-            glBegin(GL_LINE_STRIP);
+            strip = false;
             j = -j;
         }
         j--;
-        glVertex3f(0.0, fact*zy[j], base + fact*zx[j]);
+        lineTo(0.0, fact*zy[j], base + fact*zx[j]);
     }
-    glEnd();
     
+    return lines;
+}
+
+
+float Dot(float v1[3], float v2[3]) {
+    return v1[0]*v2[0] + v1[1]*v2[1] + v1[2]*v2[2];
+}
+
+
+void Cross(float v1[3], float v2[3], float vout[3]) {
+    float tmp[3];
+    tmp[0] = v1[1]*v2[2] - v2[1]*v1[2];
+    tmp[1] = v2[0]*v1[2] - v1[0]*v2[2];
+    tmp[2] = v1[0]*v2[1] - v2[0]*v1[1];
+    vout[0] = tmp[0];
+    vout[1] = tmp[1];
+    vout[2] = tmp[2];
+}
+
+
+float Unit(float vin[3], float vout[3]) {
+    float dist = vin[0]*vin[0] + vin[1]*vin[1] + vin[2]*vin[2];
+    if (dist > 0.0) {
+        dist = sqrtf(dist);
+        vout[0] = vin[0] / dist;
+        vout[1] = vin[1] / dist;
+        vout[2] = vin[2] / dist;
+    } else {
+        vout[0] = vin[0];
+        vout[1] = vin[1];
+        vout[2] = vin[2];
+    }
+    return dist;
 }
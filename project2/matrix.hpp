@@ -0,0 +1,112 @@
+//
+//  matrix.hpp
+//  project2
+//
+//  4x4 matrices on the CPU, column-major like OpenGL's.  Each call
+//    multiplies onto m from the right, the way the GL or GLU call of the
+//    same name does to the current matrix, so a sequence written against
+//    the matrix stack reads the same with these.
+//
+
+#ifndef matrix_hpp
+#define matrix_hpp
+
+#include <math.h>
+#include <string.h>
+
+
+void matIdentity(GLfloat m[16]) {
+    memset(m, 0, 16 * sizeof(GLfloat));
+    m[0] = m[5] = m[10] = m[15] = 1.f;
+}
+
+// m = m * b
+void matMultiply(GLfloat m[16], GLfloat const b[16]) {
+    GLfloat r[16];
+    for (int c = 0; c < 4; c++)
+        for (int k = 0; k < 4; k++)
+            r[4*c + k] = m[k] * b[4*c] + m[4 + k] * b[4*c + 1] + m[8 + k] * b[4*c + 2] + m[12 + k] * b[4*c + 3];
+    memcpy(m, r, sizeof(r));
+}
+
+void matTranslate(GLfloat m[16], float x, float y, float z) {
+    for (int k = 0; k < 4; k++)
+        m[12 + k] += m[k] * x + m[4 + k] * y + m[8 + k] * z;
+}
+
+void matScale(GLfloat m[16], float x, float y, float z) {
+    for (int k = 0; k < 4; k++) {
+        m[k] *= x;
+        m[4 + k] *= y;
+        m[8 + k] *= z;
+    }
+}
+
+// like glRotatef(), a zero axis leaves m alone:
+void matRotate(GLfloat m[16], float degrees, float x, float y, float z) {
+    float len = sqrtf(x*x + y*y + z*z);
+    if (len == 0.f)
+        return;
+    x /= len, y /= len, z /= len;
+    float a = degrees * (float)M_PI / 180.f;
+    float c = cosf(a), s = sinf(a), t = 1.f - c;
+    GLfloat r[16] = {
+        x*x*t + c,      y*x*t + z*s,    x*z*t - y*s,    0.f,
+        x*y*t - z*s,    y*y*t + c,      y*z*t + x*s,    0.f,
+        x*z*t + y*s,    y*z*t - x*s,    z*z*t + c,      0.f,
+        0.f,            0.f,            0.f,            1.f
+    };
+    matMultiply(m, r);
+}
+
+void matPerspective(GLfloat m[16], float fovy, float aspect, float zNear, float zFar) {
+    float f = 1.f / tanf(fovy * (float)M_PI / 360.f);
+    GLfloat p[16] = {
+        f / aspect, 0.f,    0.f,                                0.f,
+        0.f,        f,      0.f,                                0.f,
+        0.f,        0.f,    (zFar + zNear) / (zNear - zFar),    -1.f,
+        0.f,        0.f,    2.f * zFar * zNear / (zNear - zFar), 0.f
+    };
+    matMultiply(m, p);
+}
+
+void matOrtho2D(GLfloat m[16], float left, float right, float bottom, float top) {
+    GLfloat o[16] = {
+        2.f / (right - left),               0.f,                                0.f,    0.f,
+        0.f,                                2.f / (top - bottom),               0.f,    0.f,
+        0.f,                                0.f,                                -1.f,   0.f,
+        -(right + left) / (right - left),   -(top + bottom) / (top - bottom),   0.f,    1.f
+    };
+    matMultiply(m, o);
+}
+
+void matLookAt(GLfloat m[16], float ex, float ey, float ez, float cx, float cy, float cz,
+               float ux, float uy, float uz) {
+    float f[3] = { cx - ex, cy - ey, cz - ez };
+    float len = sqrtf(f[0]*f[0] + f[1]*f[1] + f[2]*f[2]);
+    for (int k = 0; k < 3; k++)
+        f[k] /= len;
+    float s[3] = { f[1]*uz - f[2]*uy, f[2]*ux - f[0]*uz, f[0]*uy - f[1]*ux };
+    len = sqrtf(s[0]*s[0] + s[1]*s[1] + s[2]*s[2]);
+    for (int k = 0; k < 3; k++)
+        s[k] /= len;
+    float u[3] = { s[1]*f[2] - s[2]*f[1], s[2]*f[0] - s[0]*f[2], s[0]*f[1] - s[1]*f[0] };
+    GLfloat v[16] = {
+        s[0],   u[0],   -f[0],  0.f,
+        s[1],   u[1],   -f[1],  0.f,
+        s[2],   u[2],   -f[2],  0.f,
+        0.f,    0.f,    0.f,    1.f
+    };
+    matMultiply(m, v);
+    matTranslate(m, -ex, -ey, -ez);
+}
+
+
+// for the GLU and frustum code, which work in doubles:
+void matToDouble(GLfloat const m[16], GLdouble d[16]) {
+    for (int k = 0; k < 16; k++)
+        d[k] = m[k];
+}
+
+
+#endif /* matrix_hpp */
@@ -0,0 +1,181 @@
+//
+//  meshrepair.hpp
+//  project2
+//
+//  Makes the winding of a triangle list consistent so back-face culling
+//    is safe: drops degenerate triangles, flags non-manifold edges, then
+//    walks each connected component breadth-first across shared edges,
+//    flipping neighbors that disagree, and finally turns each component
+//    so that it encloses positive volume (front faces point outward).
+//    Only a closed component has an outside, though: one with boundary
+//    edges (an open sheet), non-manifold edges or winding conflicts may
+//    show either side, so culling its back faces would open holes.  The
+//    triangles of the closed components are moved to the front, and only
+//    those are safe to cull.
+//
+
+#ifndef meshrepair_hpp
+#define meshrepair_hpp
+
+#include <stdio.h>
+
+#include <algorithm>
+#include <unordered_map>
+#include <vector>
+
+
+struct MeshRepairReport
+{
+    int degenerate;         // triangles dropped
+    int nonManifold;        // edges with more than two triangles (not walked across)
+    int components;         // connected components
+    int flipped;            // triangles whose winding was reversed
+    int conflicts;          // edges that still disagree (non-orientable pieces)
+    int boundary;           // edges with only one triangle
+    int open;               // components that are not closed and consistently wound
+    int closedTris;         // triangles in the closed ones, which now come first
+};
+
+
+static double repairTriVolume(struct point const *points, struct tri const &t) {
+    struct point const &a = points[t.p0], &b = points[t.p1], &c = points[t.p2];
+    return (double)a.x * ((double)b.y*c.z - (double)b.z*c.y)
+         - (double)a.y * ((double)b.x*c.z - (double)b.z*c.x)
+         + (double)a.z * ((double)b.x*c.y - (double)b.y*c.x);
+}
+
+
+// repairs tris[0 .. *ntris-1] in place; *ntris goes down if degenerate triangles are dropped:
+
+MeshRepairReport repairMesh(struct point const *points, struct tri *tris, int *ntris) {
+    MeshRepairReport report = {};
+
+    // degenerate: a repeated vertex or no area
+
+    int n = 0;
+    for (int i = 0; i < *ntris; i++) {
+        struct tri const &t = tris[i];
+        struct point const &a = points[t.p0], &b = points[t.p1], &c = points[t.p2];
+        float u[3] = { b.x-a.x, b.y-a.y, b.z-a.z };
+        float v[3] = { c.x-a.x, c.y-a.y, c.z-a.z };
+        float cx = u[1]*v[2]-u[2]*v[1], cy = u[2]*v[0]-u[0]*v[2], cz = u[0]*v[1]-u[1]*v[0];
+        if (t.p0 == t.p1 || t.p1 == t.p2 || t.p2 == t.p0 || (cx == 0.f && cy == 0.f && cz == 0.f)) {
+            report.degenerate++;
+            continue;
+        }
+        tris[n++] = t;
+    }
+    *ntris = n;
+
+    // the triangles around each undirected edge, and which way each one runs it:
+
+    struct EdgeUse { int tri; bool forward; };
+    std::unordered_map<unsigned long long, std::vector<EdgeUse>> edges;
+    edges.reserve(3*n);
+    auto key = [](int a, int b) {
+        return ((unsigned long long)std::min(a, b) << 32) | (unsigned)std::max(a, b);
+    };
+    for (int i = 0; i < n; i++) {
+        int v[3] = { tris[i].p0, tris[i].p1, tris[i].p2 };
+        for (int k = 0; k < 3; k++) {
+            int a = v[k], b = v[(k+1)%3];
+            edges[key(a, b)].push_back(EdgeUse{ i, a < b });
+        }
+    }
+
+    std::vector<std::vector<std::pair<int, bool>>> neighbors(n);     // (tri, same direction?)
+    std::vector<char> unclosed(n, 0);       // on a boundary or non-manifold edge
+    for (auto const &entry : edges) {
+        std::vector<EdgeUse> const &uses = entry.second;
+        if (uses.size() > 2) {
+            report.nonManifold++;
+            for (EdgeUse const &u : uses)
+                unclosed[u.tri] = 1;
+            continue;
+        }
+        if (uses.size() == 1) {
+            report.boundary++;
+            unclosed[uses[0].tri] = 1;
+        }
+        if (uses.size() == 2) {
+            bool same = uses[0].forward == uses[1].forward;
+            neighbors[uses[0].tri].push_back({ uses[1].tri, same });
+            neighbors[uses[1].tri].push_back({ uses[0].tri, same });
+        }
+    }
+
+    // breadth-first over each component: a neighbor that runs the shared
+    //    edge the same way we do must be flipped relative to us
+
+    std::vector<int> component(n, -1);
+    std::vector<char> flip(n, 0);
+    std::vector<char> closed;               // per component
+    std::vector<int> queue;
+    for (int seed = 0; seed < n; seed++) {
+        if (component[seed] >= 0)
+            continue;
+        int c = report.components++;
+        component[seed] = c;
+        queue.assign(1, seed);
+        double volume = 0.;
+        closed.push_back(1);
+        for (size_t q = 0; q < queue.size(); q++) {
+            int t = queue[q];
+            if (unclosed[t])
+                closed[c] = 0;
+            for (auto const &nb : neighbors[t]) {
+                char want = flip[t] ^ (char)nb.second;
+                if (component[nb.first] < 0) {
+                    component[nb.first] = c;
+                    flip[nb.first] = want;
+                    queue.push_back(nb.first);
+                } else if (flip[nb.first] != want) {
+                    report.conflicts++;
+                    closed[c] = 0;
+                }
+            }
+            double vol = repairTriVolume(points, tris[t]);
+            volume += flip[t] ? -vol : vol;
+        }
+
+        // make the component enclose positive volume:
+        if (volume < 0.) {
+            for (int t : queue)
+                flip[t] = !flip[t];
+        }
+    }
+    report.conflicts /= 2;         // each disagreeing edge is seen from both sides
+
+    for (int i = 0; i < n; i++) {
+        if (flip[i]) {
+            std::swap(tris[i].p1, tris[i].p2);
+            report.flipped++;
+        }
+    }
+
+    // the closed components first, otherwise in the order they came:
+    for (int c = 0; c < report.components; c++)
+        report.open += !closed[c];
+    std::vector<struct tri> sorted;
+    sorted.reserve(n);
+    for (int pass = 1; pass >= 0; pass--)
+        for (int i = 0; i < n; i++)
+            if (closed[component[i]] == pass)
+                sorted.push_back(tris[i]);
+    std::copy(sorted.begin(), sorted.end(), tris);
+    report.closedTris = 0;
+    for (int i = 0; i < n; i++)
+        report.closedTris += closed[component[i]];
+    return report;
+}
+
+
+void reportMeshRepair(MeshRepairReport const &r) {
+    fprintf(stderr, "Mesh repair: %d components, %d triangles flipped, %d degenerate dropped, "
+                    "%d non-manifold edges, %d winding conflicts, %d boundary edges\n",
+            r.components, r.flipped, r.degenerate, r.nonManifold, r.conflicts, r.boundary);
+    fprintf(stderr, "Mesh repair: %d open components, %d triangles safe to cull\n", r.open, r.closedTris);
+}
+
+
+#endif /* meshrepair_hpp */
@@ -0,0 +1,296 @@
+//
+//  mirror.hpp
+//  project2
+//
+//  Mirror-symmetry compression of a point/edge/tri mesh:
+//    finds an axis-aligned symmetry plane, keeps one half of the mesh
+//    plus the elements that lie on (or straddle) the plane, and lets the
+//    renderer rebuild the other half with a reflection matrix.
+//
+
+#ifndef mirror_hpp
+#define mirror_hpp
+
+#include <math.h>
+#include <stdio.h>
+
+#include <algorithm>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+
+// two coordinates closer than this are considered the same:
+const float MIRROR_TOLERANCE = 0.001f;
+
+// fraction of the points that must have a mirror image before we use the plane:
+const float MIRROR_MIN_MATCHED = 0.5f;
+
+
+struct MirrorMesh
+{
+    int     axis;           // 0, 1, 2 = X, Y, Z; -1 means no symmetry found
+    float   center;         // the plane is coord[axis] == center
+
+    std::vector<struct point> points;       // every point referenced below
+    std::vector<struct edge>  halfEdges;    // drawn twice: as-is and reflected
+    std::vector<struct edge>  singleEdges;  // seam and asymmetric edges, drawn once
+    std::vector<struct tri>   halfTris;     // drawn twice: as-is and reflected
+    std::vector<struct tri>   singleTris;   // seam and asymmetric tris, drawn once
+    int     halfClosed, singleClosed;       // how many of each come first from closed components
+};
+
+
+static float mirrorCoord(struct point const &p, int axis) {
+    return axis == 0 ? p.x : (axis == 1 ? p.y : p.z);
+}
+
+
+static struct point mirrorReflect(struct point p, int axis, float center) {
+    if (axis == 0)      p.x = 2.f*center - p.x;
+    else if (axis == 1) p.y = 2.f*center - p.y;
+    else                p.z = 2.f*center - p.z;
+    return p;
+}
+
+
+struct MirrorPointKey
+{
+    long long x, y, z;
+    bool operator==(MirrorPointKey const &o) const { return x == o.x && y == o.y && z == o.z; }
+};
+
+struct MirrorPointHash
+{
+    size_t operator()(MirrorPointKey const &k) const {
+        return (size_t)(k.x * 73856093LL ^ k.y * 19349663LL ^ k.z * 83492791LL);
+    }
+};
+
+static MirrorPointKey mirrorKey(struct point const &p) {
+    MirrorPointKey k;
+    k.x = llroundf(p.x / MIRROR_TOLERANCE);
+    k.y = llroundf(p.y / MIRROR_TOLERANCE);
+    k.z = llroundf(p.z / MIRROR_TOLERANCE);
+    return k;
+}
+
+
+// for every point, the index of its mirror image across the given plane (or -1):
+
+static int mirrorMatch(struct point const *points, int npoints, int axis, float center,
+                       std::vector<int> &mirrorOf) {
+    std::unordered_map<MirrorPointKey, int, MirrorPointHash> lookup;
+    lookup.reserve(npoints);
+    for (int i = 0; i < npoints; i++)
+        lookup.emplace(mirrorKey(points[i]), i);
+
+    int matched = 0;
+    mirrorOf.assign(npoints, -1);
+    for (int i = 0; i < npoints; i++) {
+        auto it = lookup.find(mirrorKey(mirrorReflect(points[i], axis, center)));
+        if (it != lookup.end()) {
+            mirrorOf[i] = it->second;
+            matched++;
+        }
+    }
+    return matched;
+}
+
+
+// which side of the plane a point is on: +1, -1, or 0 for on the plane:
+
+static int mirrorSide(struct point const &p, int axis, float center) {
+    float d = mirrorCoord(p, axis) - center;
+    if (d >  MIRROR_TOLERANCE/2.f) return  1;
+    if (d < -MIRROR_TOLERANCE/2.f) return -1;
+    return 0;
+}
+
+
+static unsigned long long mirrorEdgeKey(int a, int b) {
+    if (a > b) std::swap(a, b);
+    return ((unsigned long long)a << 32) | (unsigned)b;
+}
+
+
+struct MirrorTriKey
+{
+    int a, b, c;
+    bool operator==(MirrorTriKey const &o) const { return a == o.a && b == o.b && c == o.c; }
+    bool operator<(MirrorTriKey const &o) const {
+        return a != o.a ? a < o.a : (b != o.b ? b < o.b : c < o.c);
+    }
+};
+
+struct MirrorTriHash
+{
+    size_t operator()(MirrorTriKey const &k) const {
+        return (size_t)k.a * 73856093u ^ (size_t)k.b * 19349663u ^ (size_t)k.c * 83492791u;
+    }
+};
+
+static MirrorTriKey mirrorTriKey(int a, int b, int c) {
+    if (a > b) std::swap(a, b);
+    if (b > c) std::swap(b, c);
+    if (a > b) std::swap(a, b);
+    return MirrorTriKey{ a, b, c };
+}
+
+
+// split the mesh into the part that is drawn twice and the part drawn once;
+//    tris[0 .. nclosed-1] are from closed components (meshrepair.hpp), and
+//    both lists keep those first -- a half triangle only if its mirror
+//    image is closed too, since that is what gets drawn in its place
+
+MirrorMesh buildMirrorMesh(struct point const *points, int npoints,
+                           struct edge const *edges, int nedges,
+                           struct tri const *tris, int ntris, int nclosed) {
+    MirrorMesh mm;
+    mm.axis = -1;
+    mm.center = 0.;
+    mm.halfClosed = mm.singleClosed = 0;
+
+    // try the mid-plane of the bounding box along each axis:
+
+    std::vector<int> mirrorOf, best;
+    int bestMatched = 0;
+    for (int axis = 0; axis < 3 && npoints > 0; axis++) {
+        float lo = mirrorCoord(points[0], axis), hi = lo;
+        for (int i = 1; i < npoints; i++) {
+            lo = std::min(lo, mirrorCoord(points[i], axis));
+            hi = std::max(hi, mirrorCoord(points[i], axis));
+        }
+        float center = (lo + hi) / 2.f;
+        int matched = mirrorMatch(points, npoints, axis, center, mirrorOf);
+        if (matched > bestMatched) {
+            bestMatched = matched;
+            best.swap(mirrorOf);
+            mm.axis = axis;
+            mm.center = center;
+        }
+    }
+
+    if (bestMatched < MIRROR_MIN_MATCHED * npoints) {
+        mm.axis = -1;
+        best.assign(npoints, -1);
+    }
+
+    std::vector<int> side(npoints, 0);
+    for (int i = 0; i < npoints && mm.axis >= 0; i++)
+        side[i] = mirrorSide(points[i], mm.axis, mm.center);
+
+    // edges: keep one of each mirrored pair, biased toward the positive side
+
+    std::unordered_set<unsigned long long> edgeSet;
+    for (int i = 0; i < nedges; i++)
+        edgeSet.insert(mirrorEdgeKey(edges[i].p0, edges[i].p1));
+
+    std::vector<struct edge> halfEdges, singleEdges;
+    for (int i = 0; i < nedges; i++) {
+        struct edge e = edges[i];
+        int m0 = best[e.p0], m1 = best[e.p1];
+        unsigned long long key = mirrorEdgeKey(e.p0, e.p1);
+        if (m0 < 0 || m1 < 0 || edgeSet.count(mirrorEdgeKey(m0, m1)) == 0) {
+            singleEdges.push_back(e);
+            continue;
+        }
+        unsigned long long mkey = mirrorEdgeKey(m0, m1);
+        if (mkey == key) {
+            singleEdges.push_back(e);       // its own mirror image: on the seam
+            continue;
+        }
+        int s = side[e.p0] + side[e.p1];
+        if (s > 0 || (s == 0 && key < mkey))
+            halfEdges.push_back(e);
+    }
+
+    // tris: same idea, the mirror of (p0,p1,p2) is the set (m0,m1,m2)
+
+    std::unordered_map<MirrorTriKey, int, MirrorTriHash> triSet;
+    for (int i = 0; i < ntris; i++)
+        triSet[mirrorTriKey(tris[i].p0, tris[i].p1, tris[i].p2)] = i;
+
+    std::vector<struct tri> halfTris, singleTris, halfOpen, singleOpen;
+    for (int i = 0; i < ntris; i++) {
+        struct tri t = tris[i];
+        bool closed = i < nclosed;
+        int m0 = best[t.p0], m1 = best[t.p1], m2 = best[t.p2];
+        auto twin = m0 < 0 || m1 < 0 || m2 < 0 ? triSet.end() : triSet.find(mirrorTriKey(m0, m1, m2));
+        if (twin == triSet.end()) {
+            (closed ? singleTris : singleOpen).push_back(t);
+            continue;
+        }
+        MirrorTriKey key = mirrorTriKey(t.p0, t.p1, t.p2);
+        MirrorTriKey mkey = twin->first;
+        if (mkey == key) {
+            (closed ? singleTris : singleOpen).push_back(t);
+            continue;
+        }
+        int s = side[t.p0] + side[t.p1] + side[t.p2];
+        if (s > 0 || (s == 0 && key < mkey))
+            (closed && twin->second < nclosed ? halfTris : halfOpen).push_back(t);
+    }
+    mm.halfClosed = (int)halfTris.size();
+    mm.singleClosed = (int)singleTris.size();
+    halfTris.insert(halfTris.end(), halfOpen.begin(), halfOpen.end());
+    singleTris.insert(singleTris.end(), singleOpen.begin(), singleOpen.end());
+
+    // keep only the points that are still referenced, and renumber:
+
+    std::vector<int> remap(npoints, -1);
+    auto use = [&](int &p) {
+        if (remap[p] < 0) {
+            remap[p] = (int)mm.points.size();
+            mm.points.push_back(points[p]);
+        }
+        p = remap[p];
+    };
+    for (struct edge &e : halfEdges)   { use(e.p0); use(e.p1); }
+    for (struct tri &t : halfTris)     { use(t.p0); use(t.p1); use(t.p2); }
+    for (struct edge &e : singleEdges) { use(e.p0); use(e.p1); }
+    for (struct tri &t : singleTris)   { use(t.p0); use(t.p1); use(t.p2); }
+
+    mm.halfEdges.swap(halfEdges);
+    mm.singleEdges.swap(singleEdges);
+    mm.halfTris.swap(halfTris);
+    mm.singleTris.swap(singleTris);
+    return mm;
+}
+
+
+// print how much the compression saved:
+
+void reportMirrorMesh(MirrorMesh const &mm, int npoints, int nedges, int ntris) {
+    if (mm.axis < 0) {
+        fprintf(stderr, "Mirror: no symmetry plane found, mesh stored in full\n");
+        return;
+    }
+
+    size_t before = npoints*sizeof(struct point) + nedges*sizeof(struct edge) + ntris*sizeof(struct tri);
+    size_t after = mm.points.size()*sizeof(struct point)
+                 + (mm.halfEdges.size() + mm.singleEdges.size())*sizeof(struct edge)
+                 + (mm.halfTris.size() + mm.singleTris.size())*sizeof(struct tri);
+
+    fprintf(stderr, "Mirror: plane %c = %.2f\n", "XYZ"[mm.axis], mm.center);
+    fprintf(stderr, "  points %d -> %zu\n", npoints, mm.points.size());
+    fprintf(stderr, "  edges  %d -> %zu half + %zu single\n", nedges, mm.halfEdges.size(), mm.singleEdges.size());
+    fprintf(stderr, "  tris   %d -> %zu half + %zu single\n", ntris, mm.halfTris.size(), mm.singleTris.size());
+    fprintf(stderr, "  bytes  %zu -> %zu (%.0f%%)\n", before, after, 100.*after/before);
+}
+
+
+// multiply the current matrix by the reflection across the mirror plane:
+
+void applyMirrorReflection(MirrorMesh const &mm) {
+    float s[3] = { 1., 1., 1. };
+    float t[3] = { 0., 0., 0. };
+    s[mm.axis] = -1.;
+    t[mm.axis] = mm.center;
+    glTranslatef(t[0], t[1], t[2]);
+    glScalef(s[0], s[1], s[2]);
+    glTranslatef(-t[0], -t[1], -t[2]);
+}
+
+
+#endif /* mirror_hpp */
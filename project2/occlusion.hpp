@@ -0,0 +1,168 @@
+//
+//  occlusion.hpp
+//  project2
+//
+//  Hardware occlusion culling for the fleet: the instances that survived
+//    frustum culling are sorted front to back, the nearest few are drawn
+//    as occluders, and every other one gets an occlusion query on its
+//    bounding box.  With conditional rendering (GL 3.0) the GPU skips the
+//    hidden ones itself; otherwise we skip the ones last frame's query
+//    said were hidden.  Results are only read once they are available, so
+//    the CPU never waits on the GPU.
+//
+
+#ifndef occlusion_hpp
+#define occlusion_hpp
+
+#include <algorithm>
+#include <vector>
+
+#include "bvh.hpp"
+#include "fleet.hpp"
+#include "frustum.hpp"
+#include "glproc.hpp"
+#include "glstate.hpp"
+
+
+// nearest instances drawn without a query, to fill the depth buffer first:
+const int OCCLUSION_OCCLUDERS = 8;
+
+
+struct OcclusionCuller
+{
+    bool    ready;              // the context has occlusion queries
+    bool    conditional;        // ... and conditional rendering
+    GLenum  target;             // GL_ANY_SAMPLES_PASSED if there is one, else GL_SAMPLES_PASSED
+    GLuint  boxList;            // the model's bounding box, solid
+    std::vector<GLuint> queries;    // one per instance
+    std::vector<char> pending;      // a query was issued and not read back yet
+    std::vector<char> visible;      // what the last query that came back said
+    std::vector<std::pair<float, int>> order;   // (view depth, instance), scratch
+    int     drawn, occluded;        // last frame: instances submitted, instances the queries hid
+};
+
+
+bool initOcclusionCuller(OcclusionCuller &oc, BVHBounds const &b) {
+    oc = OcclusionCuller{};
+    oc.ready = GL.GenQueries != NULL && glVersionAtLeast(1, 5);
+    if (!oc.ready)
+        return false;
+    oc.conditional = GL.BeginConditionalRender != NULL && glVersionAtLeast(3, 0);
+    oc.target = (glVersionAtLeast(3, 3) || hasGLExtension("GL_ARB_occlusion_query2")) ?
+                GL_ANY_SAMPLES_PASSED : GL_SAMPLES_PASSED;
+
+    oc.boxList = glGenLists(1);
+    glNewList(oc.boxList, GL_COMPILE);
+    glBegin(GL_QUADS);
+    for (int axis = 0; axis < 3; axis++) {
+        int u = (axis + 1) % 3, v = (axis + 2) % 3;
+        for (int side = 0; side < 2; side++) {
+            float p[3];
+            p[axis] = side ? b.hi[axis] : b.lo[axis];
+            float const corners[4][2] = { { 0, 0 }, { 1, 0 }, { 1, 1 }, { 0, 1 } };
+            for (int c = 0; c < 4; c++) {
+                p[u] = corners[c][0] ? b.hi[u] : b.lo[u];
+                p[v] = corners[c][1] ? b.hi[v] : b.lo[v];
+                glVertex3fv(p);
+            }
+        }
+    }
+    glEnd();
+    glEndList();
+
+    fprintf(stderr, "Occlusion culling: %s queries, %s\n",
+            oc.target == GL_ANY_SAMPLES_PASSED ? "any-samples" : "samples-passed",
+            oc.conditional ? "conditional rendering" : "last frame's results");
+    return true;
+}
+
+
+static void occlusionResize(OcclusionCuller &oc, int n) {
+    int old = (int)oc.queries.size();
+    if (n > old) {
+        oc.queries.resize(n);
+        GL.GenQueries(n - old, &oc.queries[old]);
+    }
+    oc.pending.resize(n, 0);
+    oc.visible.resize(n, 1);
+}
+
+
+// draw the given instances (instance 0, drawn by the caller, is skipped) with
+//    occlusion culling; drawInstance(i) draws instance i
+
+void drawOccluded(OcclusionCuller &oc, Fleet const &fleet, std::vector<int> const &instances,
+                  BoundingSphere const &s, GLdouble const modelview[16], void (*drawInstance)(int)) {
+    occlusionResize(oc, (int)fleet.instances.size());
+
+    // pick up whatever results have come back, without waiting:
+    oc.occluded = 0;
+    for (int i : instances) {
+        if (oc.pending[i]) {
+            GLuint available = 0;
+            GL.GetQueryObjectuiv(oc.queries[i], GL_QUERY_RESULT_AVAILABLE, &available);
+            if (available) {
+                GLuint samples;
+                GL.GetQueryObjectuiv(oc.queries[i], GL_QUERY_RESULT, &samples);
+                oc.visible[i] = samples > 0;
+                oc.pending[i] = 0;
+            }
+        }
+    }
+
+    // front to back by eye-space depth:
+    oc.order.clear();
+    for (int i : instances) {
+        if (i == 0)
+            continue;
+        float const *m = fleet.instances[i].m;
+        float c[3];
+        for (int k = 0; k < 3; k++)
+            c[k] = m[k]*s.c[0] + m[4 + k]*s.c[1] + m[8 + k]*s.c[2] + m[12 + k];
+        float z = (float)(modelview[2]*c[0] + modelview[6]*c[1] + modelview[10]*c[2] + modelview[14]);
+        oc.order.push_back({ -z, i });
+    }
+    std::sort(oc.order.begin(), oc.order.end());
+
+    int noccluders = std::min((int)oc.order.size(), OCCLUSION_OCCLUDERS);
+    for (int j = 0; j < noccluders; j++)
+        drawInstance(oc.order[j].second);
+    oc.drawn = noccluders;
+
+    // boxes for the rest, against the depth the occluders left:
+    glColorMask(GL_FALSE, GL_FALSE, GL_FALSE, GL_FALSE);
+    glDepthMask(GL_FALSE);
+    stateDisable(GL_CULL_FACE);
+    for (int j = noccluders; j < (int)oc.order.size(); j++) {
+        int i = oc.order[j].second;
+        if (oc.pending[i] && !oc.conditional)
+            continue;               // the last one is still in flight
+        GL.BeginQuery(oc.target, oc.queries[i]);
+        glPushMatrix();
+        glMultMatrixf(fleet.instances[i].m);
+        glCallList(oc.boxList);
+        glPopMatrix();
+        GL.EndQuery(oc.target);
+        oc.pending[i] = 1;
+    }
+    glColorMask(GL_TRUE, GL_TRUE, GL_TRUE, GL_TRUE);
+    glDepthMask(GL_TRUE);
+
+    for (int j = noccluders; j < (int)oc.order.size(); j++) {
+        int i = oc.order[j].second;
+        if (oc.conditional) {
+            GL.BeginConditionalRender(oc.queries[i], GL_QUERY_NO_WAIT);
+            drawInstance(i);
+            GL.EndConditionalRender();
+        } else if (oc.visible[i]) {
+            drawInstance(i);
+        }
+        if (oc.visible[i])
+            oc.drawn++;
+        else
+            oc.occluded++;
+    }
+}
+
+
+#endif /* occlusion_hpp */
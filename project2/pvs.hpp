@@ -0,0 +1,120 @@
+//
+//  pvs.hpp
+//  project2
+//
+//  Potentially-visible set for a fixed camera: rays go out in every
+//    direction from a few eye positions spread over a small head-motion
+//    box, and every triangle one of them hits first is visible.  Rays can
+//    slip past small triangles, so the set is grown by one ring (every
+//    triangle sharing a vertex with a visible one) to stay conservative.
+//    Edges are kept when both ends are on a visible triangle, which only
+//    holds when the triangles are drawn too: their depth is what hides
+//    the edges left out, so line-only drawing needs the full edge list.
+//
+
+#ifndef pvs_hpp
+#define pvs_hpp
+
+#include <math.h>
+#include <stdio.h>
+
+#include <chrono>
+#include <vector>
+
+#include "bvh.hpp"
+#include "jobs.hpp"
+
+
+// half the size of the box the eye can move in:
+const float PVS_HEAD_RADIUS = 0.15f;
+
+// eye positions: the center of the head box and its eight corners
+const int PVS_EYES = 9;
+
+// rays cast from each eye position:
+const int PVS_RAYS_PER_EYE = 32768;
+
+
+struct PVS
+{
+    std::vector<int> tris;      // into the triangle list the BVH was built from
+    std::vector<int> edges;     // into the edge list
+    int     hit;                // triangles a ray hit, before growing
+    double  buildMs;
+};
+
+
+// bvh holds the triangles (ids = index into tris) in the same coordinates as eye;
+//    other primitives (the propeller discs) do not block the view
+
+PVS buildPVS(BVH const &bvh, float const eye[3], struct tri const *tris, int ntris,
+             struct edge const *edges, int nedges, int npoints) {
+    auto start = std::chrono::steady_clock::now();
+    PVS pvs = {};
+
+    // one job per eye position:
+    std::vector<std::vector<char>> seen(PVS_EYES, std::vector<char>(ntris, 0));
+    parallelFor(0, PVS_EYES, 1, [&](int firstEye, int lastEye) {
+        for (int e = firstEye; e < lastEye; e++) {
+            float o[3];
+            for (int k = 0; k < 3; k++)
+                o[k] = eye[k] + (e == 0 ? 0.f : ((((e - 1) >> k) & 1) ? PVS_HEAD_RADIUS : -PVS_HEAD_RADIUS));
+
+            // directions evenly over the sphere (a Fibonacci spiral):
+            const float golden = (float)M_PI * (3.f - sqrtf(5.f));
+            for (int r = 0; r < PVS_RAYS_PER_EYE; r++) {
+                float y = 1.f - 2.f * (r + .5f) / PVS_RAYS_PER_EYE;
+                float s = sqrtf(1.f - y*y);
+                float d[3] = { s * cosf(golden * r), y, s * sinf(golden * r) };
+
+                BVHHit hit = { FLT_MAX, -1, -1 };
+                traverseBVH(bvh, o, d, hit, [&](BVHPrimitive const &prim, BVHHit &h) {
+                    float t;
+                    if (prim.type == BVH_TRIANGLE && bvhIntersectTriangle(prim, o, d, t) && t < h.t) {
+                        h.t = t;
+                        h.type = prim.type;
+                        h.id = prim.id;
+                    }
+                });
+                if (hit.id >= 0)
+                    seen[e][hit.id] = 1;
+            }
+        }
+    });
+
+    // one ring around everything that was hit:
+    std::vector<char> vertex(npoints, 0);
+    for (int i = 0; i < ntris; i++) {
+        bool any = false;
+        for (int e = 0; e < PVS_EYES; e++)
+            any = any || seen[e][i];
+        if (any) {
+            pvs.hit++;
+            vertex[tris[i].p0] = vertex[tris[i].p1] = vertex[tris[i].p2] = 1;
+        }
+    }
+    std::vector<char> onVisible(npoints, 0);
+    for (int i = 0; i < ntris; i++) {
+        struct tri const &t = tris[i];
+        if (vertex[t.p0] || vertex[t.p1] || vertex[t.p2]) {
+            pvs.tris.push_back(i);
+            onVisible[t.p0] = onVisible[t.p1] = onVisible[t.p2] = 1;
+        }
+    }
+    for (int i = 0; i < nedges; i++)
+        if (onVisible[edges[i].p0] && onVisible[edges[i].p1])
+            pvs.edges.push_back(i);
+
+    auto stop = std::chrono::steady_clock::now();
+    pvs.buildMs = std::chrono::duration<double, std::milli>(stop - start).count();
+    return pvs;
+}
+
+
+void reportPVS(char const *name, PVS const &pvs, int ntris, int nedges) {
+    fprintf(stderr, "PVS %s: %zu of %d triangles (%d hit by %d rays), %zu of %d edges, %.1f ms\n",
+            name, pvs.tris.size(), ntris, pvs.hit, PVS_EYES * PVS_RAYS_PER_EYE, pvs.edges.size(), nedges, pvs.buildMs);
+}
+
+
+#endif /* pvs_hpp */
@@ -0,0 +1,368 @@
+//
+//  quantize.hpp
+//  project2
+//
+//  16-bit quantized vertex format for a MirrorMesh:
+//    positions are int16 in units of 1/invScale (hundredths for cessna.hpp)
+//    plus an integer offset, normals are octahedral-encoded in 2 bytes,
+//    indices are 16-bit.  The vertex shader decodes both.  A mesh with
+//    too many points for 16-bit indices (0xffff is the restart index)
+//    comes out empty, and uploadQuantMesh() turns it down.
+//
+
+#ifndef quantize_hpp
+#define quantize_hpp
+
+#include <math.h>
+#include <stdio.h>
+
+#include <vector>
+
+#include "edgechain.hpp"
+#include "glproc.hpp"
+#include "mirror.hpp"
+
+
+struct QuantVertex
+{
+    GLshort x, y, z;        // (position * invScale) - offset
+    GLbyte  n[2];           // octahedral-encoded unit normal
+};
+
+static_assert(sizeof(QuantVertex) == 8, "QuantVertex must be 8 bytes");
+
+
+// primitive restart index for the line strips:
+const GLushort QUANT_RESTART = 0xffff;
+
+
+// which of the triangles drawQuantMesh() draws: the closed components
+//    (which may be culled) and the rest go separately
+enum QuantTris {
+    QUANT_NO_TRIS,
+    QUANT_CLOSED_TRIS,
+    QUANT_OPEN_TRIS
+};
+
+
+// a contiguous run of the index buffer:
+
+struct QuantRange
+{
+    int first, count;
+};
+
+
+struct QuantMesh
+{
+    bool    exact;          // true if every position decodes to exactly its source float
+    float   invScale;       // position = (q + offset) / invScale
+    float   offset[3];      // whole number of quantization units
+
+    std::vector<QuantVertex> verts;
+    std::vector<GLushort>    indices;
+    QuantRange halfTris, singleTris, halfEdges, singleEdges;
+    QuantRange halfOpenTris, singleOpenTris;    // from components that are not closed
+    QuantRange halfStrips, singleStrips;    // line strips separated by QUANT_RESTART
+
+    bool    restart;        // true if the context can do primitive restart
+    GLuint  vbo, ibo;
+    GLuint  program;
+    GLint   uOffset, uInvScale, uColor, uShade;
+};
+
+
+static float quantSignNotZero(float v) {
+    return v < 0.f ? -1.f : 1.f;
+}
+
+static void quantOctEncode(float const nin[3], GLbyte out[2]) {
+    float l1 = fabsf(nin[0]) + fabsf(nin[1]) + fabsf(nin[2]);
+    if (l1 == 0.f) {
+        out[0] = out[1] = 0;
+        return;
+    }
+    float x = nin[0] / l1, y = nin[1] / l1;
+    if (nin[2] < 0.f) {
+        float ox = x;
+        x = (1.f - fabsf(y)) * quantSignNotZero(ox);
+        y = (1.f - fabsf(ox)) * quantSignNotZero(y);
+    }
+    out[0] = (GLbyte) lroundf(x * 127.f);
+    out[1] = (GLbyte) lroundf(y * 127.f);
+}
+
+
+// smallest power-of-ten scale that represents every coordinate exactly in 16 bits, or 0:
+
+static float quantFindExactScale(std::vector<struct point> const &points, float const lo[3], float const hi[3]) {
+    for (float invScale = 1.f; invScale <= 10000.f; invScale *= 10.f) {
+        bool fits = true;
+        for (int a = 0; a < 3 && fits; a++)
+            fits = (hi[a] - lo[a]) * invScale < 65535.f;
+
+        for (size_t i = 0; i < points.size() && fits; i++) {
+            float const *c = &points[i].x;
+            for (int a = 0; a < 3 && fits; a++)
+                fits = (float)lroundf(c[a] * invScale) / invScale == c[a];
+        }
+        if (fits)
+            return invScale;
+    }
+    return 0.f;
+}
+
+
+// area-weighted vertex normals; the tris do not have to be consistently wound,
+//    each face normal is flipped to agree with what the vertex has so far
+
+static void quantAddNormal(float *acc, float const *n) {
+    float d = acc[0]*n[0] + acc[1]*n[1] + acc[2]*n[2];
+    float s = d < 0.f ? -1.f : 1.f;
+    acc[0] += s*n[0];
+    acc[1] += s*n[1];
+    acc[2] += s*n[2];
+}
+
+static void quantAccumulateNormals(MirrorMesh const &mm, std::vector<struct tri> const &tris,
+                                   std::vector<float> &normals) {
+    for (struct tri const &t : tris) {
+        struct point const &p0 = mm.points[t.p0];
+        struct point const &p1 = mm.points[t.p1];
+        struct point const &p2 = mm.points[t.p2];
+        float u[3] = { p1.x-p0.x, p1.y-p0.y, p1.z-p0.z };
+        float v[3] = { p2.x-p0.x, p2.y-p0.y, p2.z-p0.z };
+        float n[3] = { u[1]*v[2]-u[2]*v[1], u[2]*v[0]-u[0]*v[2], u[0]*v[1]-u[1]*v[0] };
+        quantAddNormal(&normals[3*t.p0], n);
+        quantAddNormal(&normals[3*t.p1], n);
+        quantAddNormal(&normals[3*t.p2], n);
+    }
+}
+
+
+QuantMesh buildQuantMesh(MirrorMesh const &mm, EdgeChains const &halfChains, EdgeChains const &singleChains) {
+    QuantMesh qm = {};
+    size_t npoints = mm.points.size();
+    if (npoints >= QUANT_RESTART) {
+        fprintf(stderr, "Quantize: %zu vertices do not fit 16-bit indices\n", npoints);
+        return qm;
+    }
+
+    float lo[3] = { 0., 0., 0. }, hi[3] = { 0., 0., 0. };
+    for (size_t i = 0; i < npoints; i++) {
+        float const *c = &mm.points[i].x;
+        for (int a = 0; a < 3; a++) {
+            if (i == 0 || c[a] < lo[a]) lo[a] = c[a];
+            if (i == 0 || c[a] > hi[a]) hi[a] = c[a];
+        }
+    }
+
+    qm.invScale = quantFindExactScale(mm.points, lo, hi);
+    qm.exact = qm.invScale > 0.f;
+    if (!qm.exact) {
+        float range = 0.f;
+        for (int a = 0; a < 3; a++)
+            range = fmaxf(range, hi[a] - lo[a]);
+        qm.invScale = range > 0.f ? 65534.f / range : 1.f;
+    }
+    for (int a = 0; a < 3; a++)
+        qm.offset[a] = (float)lroundf((lo[a] + hi[a]) / 2.f * qm.invScale);
+
+    // normals: the reflected half also touches the points that lie on the mirror plane
+
+    std::vector<float> half(3*npoints, 0.f), normals(3*npoints, 0.f);
+    quantAccumulateNormals(mm, mm.halfTris, half);
+    quantAccumulateNormals(mm, mm.singleTris, normals);
+    for (size_t i = 0; i < npoints; i++) {
+        quantAddNormal(&normals[3*i], &half[3*i]);
+        if (mm.axis >= 0 && mirrorSide(mm.points[i], mm.axis, mm.center) == 0) {
+            float r[3] = { half[3*i], half[3*i+1], half[3*i+2] };
+            r[mm.axis] = -r[mm.axis];
+            quantAddNormal(&normals[3*i], r);
+        }
+    }
+
+    qm.verts.resize(npoints);
+    for (size_t i = 0; i < npoints; i++) {
+        float const *c = &mm.points[i].x;
+        QuantVertex &v = qm.verts[i];
+        v.x = (GLshort) (lroundf(c[0] * qm.invScale) - qm.offset[0]);
+        v.y = (GLshort) (lroundf(c[1] * qm.invScale) - qm.offset[1]);
+        v.z = (GLshort) (lroundf(c[2] * qm.invScale) - qm.offset[2]);
+        quantOctEncode(&normals[3*i], v.n);
+    }
+
+    auto addTris = [&](std::vector<struct tri> const &tris, int first, int last, QuantRange &r) {
+        r.first = (int)qm.indices.size();
+        for (int i = first; i < last; i++) {
+            qm.indices.push_back((GLushort)tris[i].p0);
+            qm.indices.push_back((GLushort)tris[i].p1);
+            qm.indices.push_back((GLushort)tris[i].p2);
+        }
+        r.count = (int)qm.indices.size() - r.first;
+    };
+    auto addEdges = [&](std::vector<struct edge> const &edges, QuantRange &r) {
+        r.first = (int)qm.indices.size();
+        for (struct edge const &e : edges) {
+            qm.indices.push_back((GLushort)e.p0);
+            qm.indices.push_back((GLushort)e.p1);
+        }
+        r.count = (int)qm.indices.size() - r.first;
+    };
+    auto addStrips = [&](EdgeChains const &ec, QuantRange &r) {
+        r.first = (int)qm.indices.size();
+        for (int i : ec.indices)
+            qm.indices.push_back(i == EDGECHAIN_RESTART ? QUANT_RESTART : (GLushort)i);
+        r.count = (int)qm.indices.size() - r.first;
+    };
+    addTris(mm.halfTris, 0, mm.halfClosed, qm.halfTris);
+    addTris(mm.singleTris, 0, mm.singleClosed, qm.singleTris);
+    addTris(mm.halfTris, mm.halfClosed, (int)mm.halfTris.size(), qm.halfOpenTris);
+    addTris(mm.singleTris, mm.singleClosed, (int)mm.singleTris.size(), qm.singleOpenTris);
+    addEdges(mm.halfEdges, qm.halfEdges);
+    addEdges(mm.singleEdges, qm.singleEdges);
+    addStrips(halfChains, qm.halfStrips);
+    addStrips(singleChains, qm.singleStrips);
+
+    fprintf(stderr, "Quantize: %zu vertices x %zu bytes, %zu indices x %zu bytes, %s (1/%g units)\n",
+            qm.verts.size(), sizeof(QuantVertex), qm.indices.size(), sizeof(GLushort),
+            qm.exact ? "exact" : "lossy", qm.invScale);
+    return qm;
+}
+
+
+static char const *QUANT_VERTEX_SHADER =
+    "#version 120\n"
+    "attribute vec3 aPosition;\n"
+    "attribute vec2 aNormal;\n"
+    "uniform vec3 uOffset;\n"
+    "uniform float uInvScale;\n"
+    "uniform vec4 uColor;\n"
+    "uniform int uShade;\n"
+    "varying vec4 vColor;\n"
+    "vec3 octDecode(vec2 e) {\n"
+    "    vec3 n = vec3(e, 1. - abs(e.x) - abs(e.y));\n"
+    "    if (n.z < 0.)\n"
+    "        n.xy = (1. - abs(n.yx)) * vec2(n.x < 0. ? -1. : 1., n.y < 0. ? -1. : 1.);\n"
+    "    return normalize(n);\n"
+    "}\n"
+    "void main() {\n"
+    "    vec3 p = (aPosition + uOffset) / uInvScale;\n"
+    "    gl_Position = gl_ModelViewProjectionMatrix * vec4(p, 1.);\n"
+    "    vColor = uColor;\n"
+    "    if (uShade != 0) {\n"
+    "        // fake \"lighting\" from above:\n"
+    "        vColor.rgb *= min(abs(octDecode(aNormal).y) + .25, 1.);\n"
+    "    }\n"
+    "}\n";
+
+static char const *QUANT_FRAGMENT_SHADER =
+    "#version 120\n"
+    "varying vec4 vColor;\n"
+    "void main() {\n"
+    "    gl_FragColor = vColor;\n"
+    "}\n";
+
+
+// upload to buffer objects and build the decoding program; returns false if we can't:
+
+bool uploadQuantMesh(QuantMesh &qm) {
+    if (qm.verts.empty() || GL.GenBuffers == NULL || GL.CreateProgram == NULL || GL.VertexAttribPointer == NULL)
+        return false;
+
+    char const *attribs[] = { "aPosition", "aNormal", NULL };
+    qm.program = createProgram(QUANT_VERTEX_SHADER, QUANT_FRAGMENT_SHADER, attribs);
+    if (qm.program == 0)
+        return false;
+    qm.uOffset   = GL.GetUniformLocation(qm.program, "uOffset");
+    qm.uInvScale = GL.GetUniformLocation(qm.program, "uInvScale");
+    qm.uColor    = GL.GetUniformLocation(qm.program, "uColor");
+    qm.uShade    = GL.GetUniformLocation(qm.program, "uShade");
+
+    GL.GenBuffers(1, &qm.vbo);
+    GL.BindBuffer(GL_ARRAY_BUFFER, qm.vbo);
+    GL.BufferData(GL_ARRAY_BUFFER, qm.verts.size()*sizeof(QuantVertex), qm.verts.data(), GL_STATIC_DRAW);
+    GL.GenBuffers(1, &qm.ibo);
+    GL.BindBuffer(GL_ELEMENT_ARRAY_BUFFER, qm.ibo);
+    GL.BufferData(GL_ELEMENT_ARRAY_BUFFER, qm.indices.size()*sizeof(GLushort), qm.indices.data(), GL_STATIC_DRAW);
+    GL.BindBuffer(GL_ARRAY_BUFFER, 0);
+    GL.BindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
+
+    qm.restart = glVersionAtLeast(3, 1) && GL.PrimitiveRestartIndex != NULL;
+    return true;
+}
+
+
+static void quantDrawRange(GLenum mode, QuantRange const &r) {
+    if (r.count > 0)
+        glDrawElements(mode, r.count, GL_UNSIGNED_SHORT, (GLvoid const *)(r.first * sizeof(GLushort)));
+}
+
+
+// draw the solid (closed or open triangles) and/or wireframe, reflecting the mirrored half:
+//    strips only take effect when the context has primitive restart
+
+void drawQuantMesh(QuantMesh const &qm, MirrorMesh const &mm, QuantTris solid, bool wire, bool strips) {
+    strips = strips && qm.restart;
+    if (strips) {
+        glEnable(GL_PRIMITIVE_RESTART);
+        GL.PrimitiveRestartIndex(QUANT_RESTART);
+    }
+
+    GL.UseProgram(qm.program);
+    GL.Uniform3f(qm.uOffset, qm.offset[0], qm.offset[1], qm.offset[2]);
+    GL.Uniform1f(qm.uInvScale, qm.invScale);
+
+    GL.BindBuffer(GL_ARRAY_BUFFER, qm.vbo);
+    GL.BindBuffer(GL_ELEMENT_ARRAY_BUFFER, qm.ibo);
+    GL.EnableVertexAttribArray(0);
+    GL.EnableVertexAttribArray(1);
+    GL.VertexAttribPointer(0, 3, GL_SHORT, GL_FALSE, sizeof(QuantVertex), (GLvoid const *)0);
+    GL.VertexAttribPointer(1, 2, GL_BYTE,  GL_TRUE,  sizeof(QuantVertex), (GLvoid const *)(3*sizeof(GLshort)));
+
+    for (int pass = 0; pass < 2; pass++) {
+        if (pass == 1) {
+            if (mm.axis < 0)
+                break;
+            glPushMatrix();
+            applyMirrorReflection(mm);
+            glFrontFace(GL_CW);
+        }
+        if (solid != QUANT_NO_TRIS) {
+            bool open = solid == QUANT_OPEN_TRIS;
+            GL.Uniform4f(qm.uColor, 0., 1., 0., 1.);
+            GL.Uniform1i(qm.uShade, 1);
+            quantDrawRange(GL_TRIANGLES, open ? qm.halfOpenTris : qm.halfTris);
+            if (pass == 0)
+                quantDrawRange(GL_TRIANGLES, open ? qm.singleOpenTris : qm.singleTris);
+        }
+        if (wire) {
+            GL.Uniform4f(qm.uColor, 1., 0., 0., 1.);
+            GL.Uniform1i(qm.uShade, 0);
+            if (strips) {
+                quantDrawRange(GL_LINE_STRIP, qm.halfStrips);
+                if (pass == 0)
+                    quantDrawRange(GL_LINE_STRIP, qm.singleStrips);
+            } else {
+                quantDrawRange(GL_LINES, qm.halfEdges);
+                if (pass == 0)
+                    quantDrawRange(GL_LINES, qm.singleEdges);
+            }
+        }
+        if (pass == 1) {
+            glFrontFace(GL_CCW);
+            glPopMatrix();
+        }
+    }
+
+    GL.DisableVertexAttribArray(0);
+    GL.DisableVertexAttribArray(1);
+    GL.BindBuffer(GL_ARRAY_BUFFER, 0);
+    GL.BindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
+    GL.UseProgram(0);
+    if (strips)
+        glDisable(GL_PRIMITIVE_RESTART);
+}
+
+
+#endif /* quantize_hpp */
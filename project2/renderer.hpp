@@ -0,0 +1,56 @@
+//
+//  renderer.hpp
+//  project2
+//
+//  The scene is drawn by one of two backends, picked on the command line
+//    since the kind of context has to be asked for before the window is
+//    made:
+//    - legacy: the fixed-function code in main.cpp (display lists,
+//      glBegin/glEnd, the matrix stacks), in whatever context GLUT gives;
+//      what changes every frame comes from a StreamRing when it has buffers.
+//    - core: a 3.3 core-profile context, drawn with VAOs, one shader
+//      program and a uniform buffer (corerenderer.hpp).
+//    Both draw the same scene from the same globals.
+//
+
+#ifndef renderer_hpp
+#define renderer_hpp
+
+#include <stdio.h>
+
+#include "glproc.hpp"
+
+
+struct Renderer
+{
+    char const *name;
+    int     major, minor;               // context version to ask for; 0 for GLUT's default
+    bool    core;                       // ... in the core profile
+    void    (*initLists)();             // make the GL objects the scene needs
+    void    (*drawScene)();             // everything in the 3D scene, from a cleared framebuffer
+    void    (*drawHUD)(char const *);   // a line of text in the window's corner, or NULL
+};
+
+
+// before glutCreateWindow():
+void requestRendererContext(Renderer const &r) {
+    if (r.major == 0)
+        return;
+    glutInitContextVersion(r.major, r.minor);
+    glutInitContextProfile(r.core ? GLUT_CORE_PROFILE : GLUT_COMPATIBILITY_PROFILE);
+}
+
+// after loadGLProcs(): did we get what we asked for?
+bool checkRendererContext(Renderer const &r) {
+    fprintf(stderr, "Renderer: %s, OpenGL %s\n", r.name, (char const *) glGetString(GL_VERSION));
+    if (r.major == 0)
+        return true;
+    bool ok = glVersionAtLeast(r.major, r.minor) && (!r.core || glCoreProfile());
+    if (!ok)
+        fprintf(stderr, "Renderer: asked for %d.%d%s and did not get it\n",
+                r.major, r.minor, r.core ? " core profile" : "");
+    return ok;
+}
+
+
+#endif /* renderer_hpp */
@@ -0,0 +1,639 @@
+//
+//  replay.cpp
+//  project2
+//
+//  Runs a GL capture made with "project2 -capture file" (see glcapture.hpp)
+//    as fast as it will go, with nothing else of the program around it, and
+//    prints how long it took.  The setup part (everything up to the end of
+//    the first frame, so the display lists and buffers get made) runs once;
+//    the rest of the frames run again for each pass.
+//
+//    replay file [passes]
+//
+//  There is no window: on Linux the context comes from EGL with a pbuffer
+//    the size of the captured window (so it runs on a headless Mesa),
+//    elsewhere from a hidden GLUT window.
+//
+//    g++ -std=gnu++20 -O2 replay.cpp -o replay -lEGL -lGL -lGLU -lglut
+//
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "glew.h"
+#include "glut.h"
+
+#include "glproc.hpp"
+
+#ifndef __APPLE__
+#include <EGL/egl.h>
+#include <EGL/eglext.h>
+#endif
+
+#include <algorithm>
+#include <chrono>
+#include <string>
+#include <tuple>
+#include <type_traits>
+#include <unordered_map>
+#include <vector>
+
+
+// times the frames are run when the command line does not say:
+const int REPLAY_PASSES = 5;
+
+
+struct ReplayReader
+{
+    unsigned char const *p, *end;
+    unsigned char const *start;     // of the file, for saying where things went wrong
+    bool    overrun;                // a record wanted more than was left; replayFrame() fails it
+};
+
+// are there n more bytes?  if not, the record is broken, and we go to the end:
+static bool have(ReplayReader &r, size_t n) {
+    if (!r.overrun && (size_t)(r.end - r.p) >= n)
+        return true;
+    r.overrun = true;
+    r.p = r.end;
+    return false;
+}
+
+// the next argument, as the capture wrote it (0 if the file ran out):
+template<typename T>
+static T take(ReplayReader &r) {
+    if constexpr (std::is_pointer_v<T>) {
+        uint64_t offset = 0;
+        if (have(r, sizeof(offset))) {
+            memcpy(&offset, r.p, sizeof(offset));
+            r.p += sizeof(offset);
+        }
+        return (T)(uintptr_t)offset;
+    } else {
+        T v{};
+        if (have(r, sizeof(v))) {
+            memcpy(&v, r.p, sizeof(v));
+            r.p += sizeof(v);
+        }
+        return v;
+    }
+}
+
+// ... n bytes of data, left where they are; zeros if the file ran out,
+//    so whatever the rest of the record hands the GL is never past the end:
+static void const *takeBytes(ReplayReader &r, size_t n) {
+    if (!have(r, n)) {
+        static std::vector<unsigned char> zeros;
+        if (zeros.size() < n)
+            zeros.resize(n);
+        return zeros.data();
+    }
+    void const *p = r.p;
+    r.p += n;
+    return p;
+}
+
+static std::string takeString(ReplayReader &r) {
+    uint32_t n = take<uint32_t>(r);
+    return std::string((char const *)takeBytes(r, n), n);
+}
+
+
+// the names the program got, mapped to the ones we got:
+
+typedef std::unordered_map<GLuint, GLuint> NameMap;
+
+struct ReplayNames
+{
+    NameMap buffers, programs, queries, framebuffers, textures, lists, vertexArrays;
+    std::unordered_map<uint64_t, GLint> uniforms;   // (captured program, location) -> location
+    std::unordered_map<uint64_t, GLuint> blocks;    // (captured program, block index) -> index
+    GLuint  program;                                // the captured one in use
+    GLint   vertexSize;                             // of the client vertex array
+    GLenum  vertexType;
+    std::vector<char> scratch;                      // where the Get...() calls put things
+};
+
+ReplayNames Names;
+
+
+static GLuint mapped(NameMap &m, GLuint name) {
+    auto it = m.find(name);
+    return it != m.end() ? it->second : name;
+}
+
+static GLint uniform(GLint location) {
+    auto it = Names.uniforms.find((uint64_t)Names.program << 32 | (uint32_t)location);
+    return it != Names.uniforms.end() ? it->second : location;
+}
+
+static void *scratch(size_t n) {
+    if (Names.scratch.size() < n)
+        Names.scratch.resize(n);
+    return Names.scratch.data();
+}
+
+
+// a call whose arguments need no translating:
+
+template<typename R, typename... A>
+static void replayCall(R (GLAPIENTRY *f)(A...), ReplayReader &r) {
+    std::tuple<A...> args{ take<A>(r)... };
+    if (f != NULL)
+        std::apply(f, args);
+}
+
+// a count of names and the names; NULL, with the record marked overrun, if
+//    the count is negative or more than the file has left, before anything
+//    gets allocated for it:
+static GLuint const *takeNames(ReplayReader &r, GLsizei &n) {
+    n = take<GLsizei>(r);
+    if (n < 0) {
+        r.overrun = true;
+        r.p = r.end;
+        return NULL;
+    }
+    if (!have(r, (size_t)n * sizeof(GLuint)))
+        return NULL;
+    GLuint const *names = (GLuint const *)r.p;
+    r.p += (size_t)n * sizeof(GLuint);
+    return names;
+}
+
+template<typename F>
+static void replayGen(ReplayReader &r, NameMap &m, F gen) {
+    GLsizei n;
+    GLuint const *names = takeNames(r, n);
+    if (names == NULL)
+        return;
+    std::vector<GLuint> ours(n);
+    gen(n, ours.data());
+    for (int i = 0; i < n; i++)
+        m[names[i]] = ours[i];
+}
+
+template<typename F>
+static void replayDelete(ReplayReader &r, NameMap &m, F del) {
+    GLsizei n;
+    GLuint const *names = takeNames(r, n);
+    if (names == NULL)
+        return;
+    std::vector<GLuint> ours(n);
+    for (int i = 0; i < n; i++) {
+        ours[i] = mapped(m, names[i]);
+        m.erase(names[i]);
+    }
+    del(n, ours.data());
+}
+
+// the client vertices a draw call brought along, if any:
+static void replayClientVertices(ReplayReader &r) {
+    uint32_t n = take<uint32_t>(r);
+    if (n > 0)
+        glVertexPointer(Names.vertexSize, Names.vertexType, 0,
+                        takeBytes(r, (size_t)n * Names.vertexSize * glcTypeSize(Names.vertexType)));
+}
+
+
+typedef void (*ReplayHandler)(ReplayReader &);
+
+ReplayHandler REPLAY[GLT_NCALLS];
+
+
+void initReplayHandlers() {
+#define X(type, name)   REPLAY[GLT_##name] = [](ReplayReader &r) { replayCall(GL.name, r); };
+    GL_PROC_LIST(X)
+#undef X
+#define X(name)         REPLAY[GLT_##name] = [](ReplayReader &r) { replayCall(&::gl##name, r); };
+    GL_CORE_LIST(X)
+#undef X
+#define X(name)         REPLAY[GLT_##name] = [](ReplayReader &r) { replayCall(&::glu##name, r); };
+    GL_GLU_LIST(X)
+#undef X
+
+    // the ones that make, name or point at something:
+    REPLAY[GLT_GenBuffers]        = [](ReplayReader &r) { replayGen(r, Names.buffers, GL.GenBuffers); };
+    REPLAY[GLT_DeleteBuffers]     = [](ReplayReader &r) { replayDelete(r, Names.buffers, GL.DeleteBuffers); };
+    REPLAY[GLT_GenQueries]        = [](ReplayReader &r) { replayGen(r, Names.queries, GL.GenQueries); };
+    REPLAY[GLT_DeleteQueries]     = [](ReplayReader &r) { replayDelete(r, Names.queries, GL.DeleteQueries); };
+    REPLAY[GLT_GenFramebuffers]   = [](ReplayReader &r) { replayGen(r, Names.framebuffers, GL.GenFramebuffers); };
+    REPLAY[GLT_DeleteFramebuffers] = [](ReplayReader &r) { replayDelete(r, Names.framebuffers, GL.DeleteFramebuffers); };
+    REPLAY[GLT_GenTextures]       = [](ReplayReader &r) { replayGen(r, Names.textures, glGenTextures); };
+    REPLAY[GLT_GenVertexArrays]   = [](ReplayReader &r) { replayGen(r, Names.vertexArrays, GL.GenVertexArrays); };
+    REPLAY[GLT_DeleteVertexArrays] = [](ReplayReader &r) { replayDelete(r, Names.vertexArrays, GL.DeleteVertexArrays); };
+    REPLAY[GLT_BindVertexArray]   = [](ReplayReader &r) { GL.BindVertexArray(mapped(Names.vertexArrays, take<GLuint>(r))); };
+
+    REPLAY[GLT_GenLists] = [](ReplayReader &r) {
+        GLsizei range = take<GLsizei>(r);
+        GLuint base = take<GLuint>(r);
+        GLuint ours = glGenLists(range);
+        for (int i = 0; i < range; i++)
+            Names.lists[base + i] = ours + i;
+    };
+    REPLAY[GLT_NewList] = [](ReplayReader &r) {
+        GLuint list = mapped(Names.lists, take<GLuint>(r));
+        glNewList(list, take<GLenum>(r));
+    };
+    REPLAY[GLT_CallList] = [](ReplayReader &r) { glCallList(mapped(Names.lists, take<GLuint>(r))); };
+
+    REPLAY[GLT_BindBuffer] = [](ReplayReader &r) {
+        GLenum target = take<GLenum>(r);
+        GL.BindBuffer(target, mapped(Names.buffers, take<GLuint>(r)));
+    };
+    REPLAY[GLT_BufferData] = [](ReplayReader &r) {
+        GLenum target = take<GLenum>(r);
+        int64_t size = take<int64_t>(r);
+        GLenum usage = take<GLenum>(r);
+        void const *data = take<uint8_t>(r) ? takeBytes(r, size) : NULL;
+        GL.BufferData(target, (GLsizeiptr)size, data, usage);
+    };
+
+    REPLAY[GLT_BufferSubData] = [](ReplayReader &r) {
+        GLenum target = take<GLenum>(r);
+        int64_t offset = take<int64_t>(r);
+        int64_t size = take<int64_t>(r);
+        GL.BufferSubData(target, (GLintptr)offset, (GLsizeiptr)size, takeBytes(r, size));
+    };
+    REPLAY[GLT_BindBufferBase] = [](ReplayReader &r) {
+        GLenum target = take<GLenum>(r);
+        GLuint index = take<GLuint>(r);
+        GL.BindBufferBase(target, index, mapped(Names.buffers, take<GLuint>(r)));
+    };
+    REPLAY[GLT_BindBufferRange] = [](ReplayReader &r) {
+        GLenum target = take<GLenum>(r);
+        GLuint index = take<GLuint>(r);
+        GLuint buffer = mapped(Names.buffers, take<GLuint>(r));
+        GLintptr offset = take<GLintptr>(r);
+        GL.BindBufferRange(target, index, buffer, offset, take<GLsizeiptr>(r));
+    };
+
+    REPLAY[GLT_CreateShader] = [](ReplayReader &r) {
+        GLenum type = take<GLenum>(r);
+        Names.programs[take<GLuint>(r)] = GL.CreateShader(type);
+    };
+    REPLAY[GLT_CreateProgram] = [](ReplayReader &r) { Names.programs[take<GLuint>(r)] = GL.CreateProgram(); };
+    REPLAY[GLT_DeleteShader]  = [](ReplayReader &r) { GL.DeleteShader(mapped(Names.programs, take<GLuint>(r))); };
+    REPLAY[GLT_CompileShader] = [](ReplayReader &r) { GL.CompileShader(mapped(Names.programs, take<GLuint>(r))); };
+    REPLAY[GLT_LinkProgram]   = [](ReplayReader &r) { GL.LinkProgram(mapped(Names.programs, take<GLuint>(r))); };
+    REPLAY[GLT_ShaderSource] = [](ReplayReader &r) {
+        GLuint shader = mapped(Names.programs, take<GLuint>(r));
+        GLsizei count = take<GLsizei>(r);
+        std::vector<std::string> strings(count);
+        std::vector<GLchar const *> pointers(count);
+        for (int i = 0; i < count; i++) {
+            strings[i] = takeString(r);
+            pointers[i] = strings[i].c_str();
+        }
+        GL.ShaderSource(shader, count, pointers.data(), NULL);
+    };
+    REPLAY[GLT_AttachShader] = [](ReplayReader &r) {
+        GLuint program = mapped(Names.programs, take<GLuint>(r));
+        GL.AttachShader(program, mapped(Names.programs, take<GLuint>(r)));
+    };
+    REPLAY[GLT_BindAttribLocation] = [](ReplayReader &r) {
+        GLuint program = mapped(Names.programs, take<GLuint>(r));
+        GLuint index = take<GLuint>(r);
+        GL.BindAttribLocation(program, index, takeString(r).c_str());
+    };
+    REPLAY[GLT_GetShaderiv] = [](ReplayReader &r) {
+        GLuint shader = mapped(Names.programs, take<GLuint>(r));
+        GLenum pname = take<GLenum>(r);
+        take<GLint *>(r);
+        GL.GetShaderiv(shader, pname, (GLint *)scratch(sizeof(GLint)));
+    };
+    REPLAY[GLT_GetProgramiv] = [](ReplayReader &r) {
+        GLuint program = mapped(Names.programs, take<GLuint>(r));
+        GLenum pname = take<GLenum>(r);
+        take<GLint *>(r);
+        GL.GetProgramiv(program, pname, (GLint *)scratch(sizeof(GLint)));
+    };
+    REPLAY[GLT_GetShaderInfoLog] = [](ReplayReader &r) {
+        GLuint shader = mapped(Names.programs, take<GLuint>(r));
+        GLsizei size = take<GLsizei>(r);
+        take<GLsizei *>(r);
+        take<GLchar *>(r);
+        GL.GetShaderInfoLog(shader, size, NULL, (GLchar *)scratch(size));
+    };
+    REPLAY[GLT_GetProgramInfoLog] = [](ReplayReader &r) {
+        GLuint program = mapped(Names.programs, take<GLuint>(r));
+        GLsizei size = take<GLsizei>(r);
+        take<GLsizei *>(r);
+        take<GLchar *>(r);
+        GL.GetProgramInfoLog(program, size, NULL, (GLchar *)scratch(size));
+    };
+    REPLAY[GLT_UseProgram] = [](ReplayReader &r) {
+        Names.program = take<GLuint>(r);
+        GL.UseProgram(mapped(Names.programs, Names.program));
+    };
+    REPLAY[GLT_GetUniformLocation] = [](ReplayReader &r) {
+        GLuint program = take<GLuint>(r);
+        std::string name = takeString(r);
+        GLint location = take<GLint>(r);
+        Names.uniforms[(uint64_t)program << 32 | (uint32_t)location] =
+            GL.GetUniformLocation(mapped(Names.programs, program), name.c_str());
+    };
+    REPLAY[GLT_GetUniformBlockIndex] = [](ReplayReader &r) {
+        GLuint program = take<GLuint>(r);
+        std::string name = takeString(r);
+        GLuint index = take<GLuint>(r);
+        Names.blocks[(uint64_t)program << 32 | index] =
+            GL.GetUniformBlockIndex(mapped(Names.programs, program), name.c_str());
+    };
+    REPLAY[GLT_UniformBlockBinding] = [](ReplayReader &r) {
+        GLuint program = take<GLuint>(r);
+        GLuint index = take<GLuint>(r);
+        auto it = Names.blocks.find((uint64_t)program << 32 | index);
+        GL.UniformBlockBinding(mapped(Names.programs, program), it != Names.blocks.end() ? it->second : index,
+                               take<GLuint>(r));
+    };
+    REPLAY[GLT_UniformMatrix4fv] = [](ReplayReader &r) {
+        GLint location = uniform(take<GLint>(r));
+        GLsizei count = take<GLsizei>(r);
+        GLboolean transpose = take<GLboolean>(r);
+        GL.UniformMatrix4fv(location, count, transpose, (GLfloat const *)takeBytes(r, count * 16 * sizeof(GLfloat)));
+    };
+    REPLAY[GLT_Uniform1i] = [](ReplayReader &r) {
+        GLint location = uniform(take<GLint>(r));
+        GL.Uniform1i(location, take<GLint>(r));
+    };
+    REPLAY[GLT_Uniform1f] = [](ReplayReader &r) {
+        GLint location = uniform(take<GLint>(r));
+        GL.Uniform1f(location, take<GLfloat>(r));
+    };
+    REPLAY[GLT_Uniform2f] = [](ReplayReader &r) {
+        GLint location = uniform(take<GLint>(r));
+        GLfloat v[2] = { take<GLfloat>(r), take<GLfloat>(r) };
+        GL.Uniform2f(location, v[0], v[1]);
+    };
+    REPLAY[GLT_Uniform3f] = [](ReplayReader &r) {
+        GLint location = uniform(take<GLint>(r));
+        GLfloat v[3] = { take<GLfloat>(r), take<GLfloat>(r), take<GLfloat>(r) };
+        GL.Uniform3f(location, v[0], v[1], v[2]);
+    };
+    REPLAY[GLT_Uniform4f] = [](ReplayReader &r) {
+        GLint location = uniform(take<GLint>(r));
+        GLfloat v[4] = { take<GLfloat>(r), take<GLfloat>(r), take<GLfloat>(r), take<GLfloat>(r) };
+        GL.Uniform4f(location, v[0], v[1], v[2], v[3]);
+    };
+
+    REPLAY[GLT_BeginQuery] = [](ReplayReader &r) {
+        GLenum target = take<GLenum>(r);
+        GL.BeginQuery(target, mapped(Names.queries, take<GLuint>(r)));
+    };
+    REPLAY[GLT_GetQueryObjectuiv] = [](ReplayReader &r) {
+        GLuint query = mapped(Names.queries, take<GLuint>(r));
+        GLenum pname = take<GLenum>(r);
+        take<GLuint *>(r);
+        GL.GetQueryObjectuiv(query, pname, (GLuint *)scratch(sizeof(GLuint)));
+    };
+    REPLAY[GLT_GetQueryObjectui64v] = [](ReplayReader &r) {
+        GLuint query = mapped(Names.queries, take<GLuint>(r));
+        GLenum pname = take<GLenum>(r);
+        take<GLuint64 *>(r);
+        GL.GetQueryObjectui64v(query, pname, (GLuint64 *)scratch(sizeof(GLuint64)));
+    };
+    REPLAY[GLT_BeginConditionalRender] = [](ReplayReader &r) {
+        GLuint query = mapped(Names.queries, take<GLuint>(r));
+        GL.BeginConditionalRender(query, take<GLenum>(r));
+    };
+
+    REPLAY[GLT_BindFramebuffer] = [](ReplayReader &r) {
+        GLenum target = take<GLenum>(r);
+        GL.BindFramebuffer(target, mapped(Names.framebuffers, take<GLuint>(r)));
+    };
+    REPLAY[GLT_FramebufferTexture2D] = [](ReplayReader &r) {
+        GLenum target = take<GLenum>(r);
+        GLenum attachment = take<GLenum>(r);
+        GLenum textarget = take<GLenum>(r);
+        GLuint texture = mapped(Names.textures, take<GLuint>(r));
+        GL.FramebufferTexture2D(target, attachment, textarget, texture, take<GLint>(r));
+    };
+    REPLAY[GLT_BindTexture] = [](ReplayReader &r) {
+        GLenum target = take<GLenum>(r);
+        glBindTexture(target, mapped(Names.textures, take<GLuint>(r)));
+    };
+    REPLAY[GLT_TexImage2D] = [](ReplayReader &r) {
+        GLenum target = take<GLenum>(r);
+        GLint level = take<GLint>(r);
+        GLint internal = take<GLint>(r);
+        GLsizei width = take<GLsizei>(r);
+        GLsizei height = take<GLsizei>(r);
+        GLint border = take<GLint>(r);
+        GLenum format = take<GLenum>(r);
+        GLenum type = take<GLenum>(r);
+        void const *pixels = take<uint8_t>(r) ?
+                             takeBytes(r, (size_t)width * height * glcPixelSize(format, type)) : NULL;
+        glTexImage2D(target, level, internal, width, height, border, format, type, pixels);
+    };
+
+    REPLAY[GLT_Vertex3fv]   = [](ReplayReader &r) { glVertex3fv((GLfloat const *)takeBytes(r, 3 * sizeof(GLfloat))); };
+    REPLAY[GLT_MultMatrixf] = [](ReplayReader &r) { glMultMatrixf((GLfloat const *)takeBytes(r, 16 * sizeof(GLfloat))); };
+    REPLAY[GLT_VertexPointer] = [](ReplayReader &r) {
+        GLint size = take<GLint>(r);
+        GLenum type = take<GLenum>(r);
+        GLsizei stride = take<GLsizei>(r);
+        if (take<uint8_t>(r)) {
+            Names.vertexSize = size;        // the vertices come with the draw call
+            Names.vertexType = type;
+        } else {
+            glVertexPointer(size, type, stride, take<void const *>(r));
+        }
+    };
+    REPLAY[GLT_ColorPointer] = [](ReplayReader &r) {
+        GLint size = take<GLint>(r);
+        GLenum type = take<GLenum>(r);
+        GLsizei stride = take<GLsizei>(r);
+        if (take<uint8_t>(r))
+            glDisableClientState(GL_COLOR_ARRAY);   // the colours were not captured
+        else
+            glColorPointer(size, type, stride, take<void const *>(r));
+    };
+    REPLAY[GLT_DrawArrays] = [](ReplayReader &r) {
+        GLenum mode = take<GLenum>(r);
+        GLint first = take<GLint>(r);
+        GLsizei count = take<GLsizei>(r);
+        replayClientVertices(r);
+        glDrawArrays(mode, first, count);
+    };
+    REPLAY[GLT_DrawElements] = [](ReplayReader &r) {
+        GLenum mode = take<GLenum>(r);
+        GLsizei count = take<GLsizei>(r);
+        GLenum type = take<GLenum>(r);
+        void const *indices = take<uint8_t>(r) ? takeBytes(r, (size_t)count * glcTypeSize(type)) :
+                                                 take<void const *>(r);
+        replayClientVertices(r);
+        glDrawElements(mode, count, type, indices);
+    };
+
+    REPLAY[GLT_GetIntegerv] = [](ReplayReader &r) {
+        GLenum pname = take<GLenum>(r);
+        take<GLint *>(r);
+        glGetIntegerv(pname, (GLint *)scratch(16 * sizeof(GLint)));
+    };
+    REPLAY[GLT_GetFloatv] = [](ReplayReader &r) {
+        GLenum pname = take<GLenum>(r);
+        take<GLfloat *>(r);
+        glGetFloatv(pname, (GLfloat *)scratch(16 * sizeof(GLfloat)));
+    };
+    REPLAY[GLT_GetDoublev] = [](ReplayReader &r) {
+        GLenum pname = take<GLenum>(r);
+        take<GLdouble *>(r);
+        glGetDoublev(pname, (GLdouble *)scratch(16 * sizeof(GLdouble)));
+    };
+}
+
+
+// run records up to the end of the next frame (or the file);
+//    returns the number of calls, or -1 if the file is broken
+
+long replayFrame(ReplayReader &r) {
+    long calls = 0;
+    while (r.p + sizeof(uint16_t) <= r.end) {
+        long at = (long)(r.p - r.start);
+        uint16_t id = take<uint16_t>(r);
+        if (id == GLC_FRAME)
+            return calls;
+        if (id >= GLT_NCALLS) {
+            fprintf(stderr, "Replay: bad record %u at byte %ld\n", id, at);
+            return -1;
+        }
+        REPLAY[id](r);
+        if (r.overrun) {
+            fprintf(stderr, "Replay: %s record at byte %ld runs past the end of the file\n", GLT_NAMES[id], at);
+            return -1;
+        }
+        calls++;
+    }
+    return calls;
+}
+
+
+// a context with a framebuffer the size of the captured window:
+bool createReplayContext(int argc, char *argv[], int width, int height) {
+#ifdef __APPLE__
+    glutInit(&argc, argv);
+    glutInitDisplayMode(GLUT_RGBA | GLUT_DOUBLE | GLUT_DEPTH);
+    glutInitWindowSize(width, height);
+    glutCreateWindow("replay");
+    glutHideWindow();
+    return loadGLProcs() == 0;
+#else
+    (void)argc, (void)argv;
+    auto queryDevices = (PFNEGLQUERYDEVICESEXTPROC) eglGetProcAddress("eglQueryDevicesEXT");
+    auto getDisplay = (PFNEGLGETPLATFORMDISPLAYEXTPROC) eglGetProcAddress("eglGetPlatformDisplayEXT");
+    EGLDeviceEXT device;
+    EGLint ndevices = 0;
+    if (queryDevices == NULL || getDisplay == NULL || !queryDevices(1, &device, &ndevices) || ndevices < 1)
+        return false;
+    EGLDisplay display = getDisplay(EGL_PLATFORM_DEVICE_EXT, device, NULL);
+    if (!eglInitialize(display, NULL, NULL) || !eglBindAPI(EGL_OPENGL_API))
+        return false;
+
+    EGLint const configAttribs[] = {
+        EGL_SURFACE_TYPE, EGL_PBUFFER_BIT, EGL_RENDERABLE_TYPE, EGL_OPENGL_BIT,
+        EGL_RED_SIZE, 8, EGL_GREEN_SIZE, 8, EGL_BLUE_SIZE, 8, EGL_ALPHA_SIZE, 8, EGL_DEPTH_SIZE, 24,
+        EGL_NONE
+    };
+    EGLConfig config;
+    EGLint nconfigs = 0;
+    if (!eglChooseConfig(display, configAttribs, &config, 1, &nconfigs) || nconfigs < 1)
+        return false;
+    EGLint const surfaceAttribs[] = { EGL_WIDTH, width, EGL_HEIGHT, height, EGL_NONE };
+    EGLSurface surface = eglCreatePbufferSurface(display, config, surfaceAttribs);
+    EGLContext context = eglCreateContext(display, config, EGL_NO_CONTEXT, NULL);
+    if (surface == EGL_NO_SURFACE || context == EGL_NO_CONTEXT ||
+        !eglMakeCurrent(display, surface, surface, context))
+        return false;
+
+    // glutGetProcAddress() wants glutInit(), which wants a display:
+    int missing = 0;
+#define X(type, name) \
+    GL.name = (type) eglGetProcAddress("gl" #name); \
+    if (GL.name == NULL) missing++;
+    GL_PROC_LIST(X)
+#undef X
+    return missing == 0;
+#endif
+}
+
+
+int main(int argc, char *argv[]) {
+    if (argc < 2) {
+        fprintf(stderr, "usage: %s capture-file [passes]\n", argv[0]);
+        return 1;
+    }
+    int passes = argc > 2 ? atoi(argv[2]) : REPLAY_PASSES;
+
+    FILE *fp = fopen(argv[1], "rb");
+    if (fp == NULL) {
+        fprintf(stderr, "Replay: cannot read %s\n", argv[1]);
+        return 1;
+    }
+    std::vector<unsigned char> data;
+    unsigned char buffer[1 << 16];
+    for (size_t n; (n = fread(buffer, 1, sizeof(buffer), fp)) > 0; )
+        data.insert(data.end(), buffer, buffer + n);
+    fclose(fp);
+
+    GLCaptureHeader header;
+    if (data.size() < sizeof(header) || memcmp(data.data(), GLC_MAGIC, sizeof(GLC_MAGIC)) != 0) {
+        fprintf(stderr, "Replay: %s is not a GL capture\n", argv[1]);
+        return 1;
+    }
+    memcpy(&header, data.data(), sizeof(header));
+    if (header.ncalls != GLT_NCALLS) {
+        fprintf(stderr, "Replay: %s was captured by a build with %u entry points, this one has %d\n",
+                argv[1], header.ncalls, (int)GLT_NCALLS);
+        return 1;
+    }
+
+    if (!createReplayContext(argc, argv, header.width, header.height)) {
+        fprintf(stderr, "Replay: could not get an OpenGL context\n");
+        return 1;
+    }
+    initReplayHandlers();
+    fprintf(stderr, "Replay: %s, %d x %d, %u frames, %.1f MB\n", argv[1], header.width, header.height,
+            header.frames, data.size() / 1.e6);
+    fprintf(stderr, "        %s, %s\n", (char const *)glGetString(GL_RENDERER), (char const *)glGetString(GL_VERSION));
+
+    ReplayReader r = { data.data() + sizeof(header), data.data() + data.size(), data.data(), false };
+    auto start = std::chrono::steady_clock::now();
+    long setupCalls = replayFrame(r);
+    glFinish();
+    auto stop = std::chrono::steady_clock::now();
+    if (setupCalls < 0)
+        return 1;
+    fprintf(stderr, "setup: %ld calls, %.2f ms\n", setupCalls,
+            std::chrono::duration<double, std::milli>(stop - start).count());
+
+    // the frames, as fast as they go; the per-frame times are submission only
+    unsigned char const *frames = r.p;
+    fprintf(stderr, "%-6s %8s %10s %10s %10s %10s %12s\n",
+            "pass", "frames", "total ms", "ms/frame", "min ms", "max ms", "calls/frame");
+    for (int pass = 1; pass <= passes; pass++) {
+        r.p = frames;
+        std::vector<double> times;
+        long calls = 0;
+        auto passStart = std::chrono::steady_clock::now();
+        while (r.p < r.end) {
+            auto frameStart = std::chrono::steady_clock::now();
+            long n = replayFrame(r);
+            if (n < 0)
+                return 1;
+            auto frameStop = std::chrono::steady_clock::now();
+            times.push_back(std::chrono::duration<double, std::milli>(frameStop - frameStart).count());
+            calls += n;
+        }
+        glFinish();
+        double total = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - passStart).count();
+        if (times.empty())
+            break;
+        fprintf(stderr, "%-6d %8zu %10.2f %10.3f %10.3f %10.3f %12.1f\n", pass, times.size(), total,
+                total / times.size(), *std::min_element(times.begin(), times.end()),
+                *std::max_element(times.begin(), times.end()), (double)calls / times.size());
+    }
+    for (GLenum e; (e = glGetError()) != GL_NO_ERROR; )
+        fprintf(stderr, "Replay: GL error %s\n", (char const *)gluErrorString(e));
+    return 0;
+}
@@ -0,0 +1,247 @@
+//
+//  scenesim.hpp
+//  project2
+//
+//  The simulation on a thread of its own, so a slow frame does not hold up
+//    the input or the animation, and a slow simulation step does not hold
+//    up the frame.  Neither side ever waits for the other:
+//    - the input callbacks (which GLUT calls on the GL thread) push each
+//      event into a single-producer ring, and the simulation takes them
+//      out at its next tick;
+//    - each tick the simulation writes a whole new SceneSnapshot (camera,
+//      Time, every aircraft's transform, what is under the mouse) and
+//      publishes it through a triple buffer; the GL thread draws whichever
+//      is the latest when it starts a frame, and keeps drawing the one it
+//      has if nothing new came in;
+//    - the other way, the GL thread publishes the matrices it drew with,
+//      so the simulation can pick against what is on the screen.
+//  A triple buffer has a slot for the writer, one for the reader, and one
+//    in the middle; publishing swaps the writer's slot with the middle,
+//    taking the latest swaps the reader's with the middle if it is newer.
+//    Both are a single atomic exchange.
+//
+
+#ifndef scenesim_hpp
+#define scenesim_hpp
+
+#include <stdlib.h>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <thread>
+#include <vector>
+
+#include "fleet.hpp"
+#include "inputqueue.hpp"
+#include "tlas.hpp"
+
+
+// simulation steps per second:
+const int SIM_TICKS_PER_SECOND = 120;
+
+// input events that can wait for the next tick, a power of two:
+const unsigned SIM_INPUT_EVENTS = 1024;
+
+
+// marks the middle slot as published and not yet taken:
+const int TRIPLE_FRESH = 4;
+
+template <typename T>
+struct TripleBuffer
+{
+    T       slots[3];
+    std::atomic<int> middle{ 1 };       // index, | TRIPLE_FRESH if newer than the reader's
+    int     front = 0;                  // the reader's
+    int     back = 2;                   // the writer's
+};
+
+// the writer fills this in ...
+template <typename T>
+T &tripleBack(TripleBuffer<T> &tb) {
+    return tb.slots[tb.back];
+}
+
+// ... then hands it over:
+template <typename T>
+void triplePublish(TripleBuffer<T> &tb) {
+    tb.back = tb.middle.exchange(tb.back | TRIPLE_FRESH, std::memory_order_acq_rel) & ~TRIPLE_FRESH;
+}
+
+// back to nothing published, every slot value; only while neither side is using it:
+template <typename T>
+void tripleReset(TripleBuffer<T> &tb, T const &value) {
+    for (T &slot : tb.slots)
+        slot = value;
+    tb.middle.store(1, std::memory_order_relaxed);
+    tb.front = 0;
+    tb.back = 2;
+}
+
+// the reader's slot, moved on to the newest published if there is one:
+template <typename T>
+T const &tripleLatest(TripleBuffer<T> &tb) {
+    if (tb.middle.load(std::memory_order_relaxed) & TRIPLE_FRESH)
+        tb.front = tb.middle.exchange(tb.front, std::memory_order_acq_rel) & ~TRIPLE_FRESH;
+    return tb.slots[tb.front];
+}
+
+
+struct SceneSnapshot
+{
+    long    tick;                       // 0 if it was never written
+    float   xrot, yrot, scale;          // the camera
+    float   time, timeCycle;
+    std::vector<Instance> instances;    // the fleet, at time
+    int     pickedType, pickedId, pickedInstance;   // under the mouse
+    long    inputs;                     // input events taken in by the time it was made
+};
+
+struct PickView
+{
+    bool     drawn;                     // false until a frame has been
+    GLdouble modelview[16], projection[16];
+    GLint    viewport[4];
+    int      height;                    // of the window, to flip the mouse's y
+};
+
+struct InputEvent
+{
+    bool    hover;                      // else a drag
+    int     buttons;
+    int     x, y;                       // where to, or how far
+};
+
+
+struct SceneSim
+{
+    std::thread *thread;
+    std::atomic<bool> running;
+    void  (*tick)(SceneSim &);
+
+    // from the GL thread:
+    InputEvent events[SIM_INPUT_EVENTS];
+    std::atomic<unsigned> eventHead, eventTail;
+    long    pushed;                     // events that made it into the ring, the GL thread's count
+    double  pushTimes[SIM_INPUT_EVENTS];    // ... when each of the latest came in, by that count, in seconds
+    long    shown;                      // the inputs of the last snapshot the GL thread took
+    std::atomic<int> fleetSize;
+    std::atomic<bool> frozen, debug, reset;
+    std::chrono::steady_clock::time_point epoch;    // when GLUT's elapsed time was 0; GLUT is the GL thread's alone
+    TripleBuffer<PickView> views;
+
+    // to the GL thread:
+    TripleBuffer<SceneSnapshot> snapshots;
+    std::atomic<long> inputEvents, inputUpdates;    // since the GL thread last took them for the stats
+
+    // the simulation's own:
+    long    ticks, inputs;
+    float   xrot, yrot, scale;
+    float   time, timeCycle;
+    Fleet   fleet;
+    TLAS    tlas;
+    InputQueue input;
+    int     pickedType, pickedId, pickedInstance;
+};
+
+SceneSim Simulation;
+
+
+// from the input callbacks; false if the ring is full and the event is lost:
+
+static bool simPush(SceneSim &sim, InputEvent const &e) {
+    unsigned head = sim.eventHead.load(std::memory_order_relaxed);
+    if (head - sim.eventTail.load(std::memory_order_acquire) >= SIM_INPUT_EVENTS)
+        return false;
+    sim.events[head % SIM_INPUT_EVENTS] = e;
+    sim.eventHead.store(head + 1, std::memory_order_release);
+    sim.pushTimes[sim.pushed % SIM_INPUT_EVENTS] =
+        std::chrono::duration<double>(std::chrono::steady_clock::now().time_since_epoch()).count();
+    sim.pushed++;
+    return true;
+}
+
+// when the earliest input a snapshot covering inputs is the first to show came
+//    in, or -1 if it shows nothing new; the snapshot is then the one shown
+
+double simShowInput(SceneSim &sim, long inputs) {
+    if (inputs <= sim.shown)
+        return -1.;
+    // (if the times have gone round since, the oldest one left is as close as we get)
+    long first = std::max(sim.shown, sim.pushed - (long)SIM_INPUT_EVENTS);
+    sim.shown = inputs;
+    return sim.pushTimes[first % SIM_INPUT_EVENTS];
+}
+
+bool simDrag(SceneSim &sim, int buttons, int dx, int dy) {
+    return simPush(sim, InputEvent{ false, buttons, dx, dy });
+}
+
+bool simHover(SceneSim &sim, int x, int y) {
+    return simPush(sim, InputEvent{ true, 0, x, y });
+}
+
+
+// in the tick: everything pushed since the last one, folded into sim.input
+
+int simTakeInput(SceneSim &sim) {
+    unsigned tail = sim.eventTail.load(std::memory_order_relaxed);
+    unsigned head = sim.eventHead.load(std::memory_order_acquire);
+    for (unsigned i = tail; i != head; i++) {
+        InputEvent const &e = sim.events[i % SIM_INPUT_EVENTS];
+        if (e.hover)
+            inputHover(sim.input, e.x, e.y);
+        else
+            inputDrag(sim.input, e.buttons, e.x, e.y);
+    }
+    sim.eventTail.store(head, std::memory_order_release);
+    sim.inputs += head - tail;
+    return (int)(head - tail);
+}
+
+
+static void simLoop(SceneSim *sim) {
+    jobThreadName("simulation");
+    auto period = std::chrono::nanoseconds(1000000000 / SIM_TICKS_PER_SECOND);
+    auto next = std::chrono::steady_clock::now();
+    while (sim->running.load(std::memory_order_acquire)) {
+        sim->ticks++;
+        sim->tick(*sim);
+
+        // a tick that ran long is not made up for:
+        next += period;
+        auto now = std::chrono::steady_clock::now();
+        if (next < now)
+            next = now;
+        std::this_thread::sleep_until(next);
+    }
+}
+
+void stopSceneSim() {
+    SceneSim &sim = Simulation;
+    if (sim.thread == NULL)
+        return;
+    sim.running.store(false, std::memory_order_release);
+    sim.thread->join();
+    delete sim.thread;
+    sim.thread = NULL;
+}
+
+// the simulation's own state must be set up before this; from here on it
+//    belongs to the thread until stopSceneSim()
+
+void startSceneSim(void (*tick)(SceneSim &)) {
+    SceneSim &sim = Simulation;
+    if (sim.thread != NULL)
+        return;
+    static bool registered = false;
+    if (!registered)
+        atexit(stopSceneSim);   // before anything it uses is torn down
+    registered = true;
+    sim.tick = tick;
+    sim.running.store(true, std::memory_order_release);
+    sim.thread = new std::thread(simLoop, &sim);
+}
+
+
+#endif /* scenesim_hpp */
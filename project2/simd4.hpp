@@ -0,0 +1,106 @@
+//
+//  simd4.hpp
+//  project2
+//
+//  Four floats at a time, for the loops that test many things against
+//    the same plane.  GCC and Clang get their vector extensions, which
+//    turn into SSE or NEON without any intrinsics; MSVC on x86 gets SSE
+//    intrinsics; anything else gets a plain array the compiler may or may
+//    not vectorize.  A comparison gives a mask, and simdBits() turns a
+//    mask into one bit per lane, lane 0 in bit 0.
+//
+
+#ifndef simd4_hpp
+#define simd4_hpp
+
+#include <string.h>
+
+#if !defined(__GNUC__) && (defined(_M_X64) || defined(_M_IX86))
+#include <xmmintrin.h>
+#endif
+
+
+#if defined(__GNUC__)
+
+typedef float SimdFloat4 __attribute__((vector_size(16)));
+typedef int   SimdMask4  __attribute__((vector_size(16)));
+
+static inline SimdFloat4 simdLoad(float const *p) {
+    SimdFloat4 v;
+    memcpy(&v, p, sizeof(v));
+    return v;
+}
+static inline SimdFloat4 simdSplat(float x)                         { return SimdFloat4{ x, x, x, x }; }
+static inline SimdFloat4 simdAdd(SimdFloat4 a, SimdFloat4 b)        { return a + b; }
+static inline SimdFloat4 simdMul(SimdFloat4 a, SimdFloat4 b)        { return a * b; }
+static inline SimdFloat4 simdNeg(SimdFloat4 a)                      { return -a; }
+static inline SimdMask4  simdGE(SimdFloat4 a, SimdFloat4 b)         { return a >= b; }
+static inline SimdMask4  simdGT(SimdFloat4 a, SimdFloat4 b)         { return a > b; }
+static inline SimdMask4  simdAnd(SimdMask4 a, SimdMask4 b)          { return a & b; }
+static inline SimdMask4  simdAllTrue()                              { return SimdMask4{ -1, -1, -1, -1 }; }
+static inline int simdBits(SimdMask4 m) {
+    return (m[0] & 1) | (m[1] & 1) << 1 | (m[2] & 1) << 2 | (m[3] & 1) << 3;
+}
+
+#elif defined(_M_X64) || defined(_M_IX86)
+
+typedef __m128 SimdFloat4;
+typedef __m128 SimdMask4;
+
+static inline SimdFloat4 simdLoad(float const *p)                   { return _mm_loadu_ps(p); }
+static inline SimdFloat4 simdSplat(float x)                         { return _mm_set1_ps(x); }
+static inline SimdFloat4 simdAdd(SimdFloat4 a, SimdFloat4 b)        { return _mm_add_ps(a, b); }
+static inline SimdFloat4 simdMul(SimdFloat4 a, SimdFloat4 b)        { return _mm_mul_ps(a, b); }
+static inline SimdFloat4 simdNeg(SimdFloat4 a)                      { return _mm_sub_ps(_mm_setzero_ps(), a); }
+static inline SimdMask4  simdGE(SimdFloat4 a, SimdFloat4 b)         { return _mm_cmpge_ps(a, b); }
+static inline SimdMask4  simdGT(SimdFloat4 a, SimdFloat4 b)         { return _mm_cmpgt_ps(a, b); }
+static inline SimdMask4  simdAnd(SimdMask4 a, SimdMask4 b)          { return _mm_and_ps(a, b); }
+static inline SimdMask4  simdAllTrue()                              { return _mm_cmpeq_ps(_mm_setzero_ps(), _mm_setzero_ps()); }
+static inline int simdBits(SimdMask4 m)                             { return _mm_movemask_ps(m); }
+
+#else
+
+struct SimdFloat4 { float v[4]; };
+struct SimdMask4  { int v[4]; };
+
+static inline SimdFloat4 simdLoad(float const *p) {
+    SimdFloat4 r;
+    memcpy(r.v, p, sizeof(r.v));
+    return r;
+}
+static inline SimdFloat4 simdSplat(float x)                         { return SimdFloat4{ { x, x, x, x } }; }
+static inline SimdFloat4 simdAdd(SimdFloat4 a, SimdFloat4 b) {
+    for (int k = 0; k < 4; k++) a.v[k] += b.v[k];
+    return a;
+}
+static inline SimdFloat4 simdMul(SimdFloat4 a, SimdFloat4 b) {
+    for (int k = 0; k < 4; k++) a.v[k] *= b.v[k];
+    return a;
+}
+static inline SimdFloat4 simdNeg(SimdFloat4 a) {
+    for (int k = 0; k < 4; k++) a.v[k] = -a.v[k];
+    return a;
+}
+static inline SimdMask4 simdGE(SimdFloat4 a, SimdFloat4 b) {
+    SimdMask4 m;
+    for (int k = 0; k < 4; k++) m.v[k] = a.v[k] >= b.v[k] ? -1 : 0;
+    return m;
+}
+static inline SimdMask4 simdGT(SimdFloat4 a, SimdFloat4 b) {
+    SimdMask4 m;
+    for (int k = 0; k < 4; k++) m.v[k] = a.v[k] > b.v[k] ? -1 : 0;
+    return m;
+}
+static inline SimdMask4 simdAnd(SimdMask4 a, SimdMask4 b) {
+    for (int k = 0; k < 4; k++) a.v[k] &= b.v[k];
+    return a;
+}
+static inline SimdMask4 simdAllTrue()                               { return SimdMask4{ { -1, -1, -1, -1 } }; }
+static inline int simdBits(SimdMask4 m) {
+    return (m.v[0] & 1) | (m.v[1] & 1) << 1 | (m.v[2] & 1) << 2 | (m.v[3] & 1) << 3;
+}
+
+#endif
+
+
+#endif /* simd4_hpp */
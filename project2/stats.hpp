@@ -0,0 +1,105 @@
+//
+//  stats.hpp
+//  project2
+//
+//  Per-frame counters (what got drawn, what got skipped, ...) added up
+//    over a second or so and printed as averages per frame.
+//
+
+#ifndef stats_hpp
+#define stats_hpp
+
+#include <stdio.h>
+
+
+// seconds between reports:
+const float STATS_REPORT_SECONDS = 1.f;
+
+
+enum StatCounter {
+    STAT_OBJECTS_DRAWN,
+    STAT_OBJECTS_CULLED,
+    STAT_INSTANCES_DRAWN,
+    STAT_INSTANCES_CULLED,
+    STAT_INSTANCES_OCCLUDED,
+    STAT_LAYER_REDRAWS,
+    STAT_RESOLUTION_PERCENT,
+    STAT_GL_STATE_ISSUED,
+    STAT_GL_STATE_ELIDED,
+    STAT_STREAM_BYTES,
+    STAT_STREAM_WAITS,
+    STAT_STREAM_OVERFLOWS,
+    STAT_INPUT_EVENTS,
+    STAT_INPUT_UPDATES,
+#ifdef GL_TRACE
+    STAT_GL_CALLS,
+    STAT_GL_DRAW_CALLS,
+    STAT_GL_VERTICES,
+    STAT_GL_STATE_CHANGES,
+    STAT_GL_BUFFER_BYTES,
+#endif
+    STAT_NCOUNTERS
+};
+
+const char *STAT_NAMES[] = {
+    "objects drawn",
+    "objects culled",
+    "instances drawn",
+    "instances culled",
+    "instances occluded",
+    "static layer redraws",
+    "resolution %",
+    "GL state calls issued",
+    "GL state calls elided",
+    "stream ring bytes",
+    "stream ring waits",
+    "stream ring overflows",
+    "input events",
+    "input updates applied",
+#ifdef GL_TRACE
+    "GL calls",
+    "GL draw calls",
+    "GL vertices",
+    "GL state changes",
+    "GL buffer bytes",
+#endif
+};
+
+
+struct Stats
+{
+    long    counts[STAT_NCOUNTERS];
+    int     frames;             // since the last report
+    float   start;              // time of the last report
+};
+
+
+void statsAdd(Stats &s, int counter, long n) {
+    s.counts[counter] += n;
+}
+
+
+// call once per frame; prints and starts over every STATS_REPORT_SECONDS,
+//    and returns true when it does
+
+bool statsEndFrame(Stats &s, float now, bool print) {
+    s.frames++;
+    float elapsed = now - s.start;
+    if (elapsed < STATS_REPORT_SECONDS)
+        return false;
+
+    if (print) {
+        fprintf(stderr, "Stats: %d frames, %.2f ms/frame", s.frames, 1000.f * elapsed / s.frames);
+        for (int i = 0; i < STAT_NCOUNTERS; i++)
+            fprintf(stderr, ", %s %.1f", STAT_NAMES[i], (double)s.counts[i] / s.frames);
+        fprintf(stderr, "\n");
+    }
+    for (int i = 0; i < STAT_NCOUNTERS; i++)
+        s.counts[i] = 0;
+    s.frames = 0;
+    s.start = now;
+    return true;
+}
+
+
+#endif /* stats_hpp */
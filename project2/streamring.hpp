@@ -0,0 +1,176 @@
+//
+//  streamring.hpp
+//  project2
+//
+//  One buffer for everything that is uploaded fresh each frame.  It is cut
+//    into STREAM_RING_FRAMES regions; each frame takes the next region and
+//    bump-allocates from it, once the fence set the last time that region
+//    was used has passed, so nothing the GPU may still be reading is ever
+//    overwritten and the driver never has to stall or rename the buffer.
+//    The bytes get there by
+//    - a persistent, coherent mapping (ARB_buffer_storage): an upload is
+//      a memcpy;
+//    - or, without that, glMapBufferRange() of just the piece, unsynchronized;
+//    - or glBufferSubData() while a capture is running, since a replay sees
+//      neither writes through a mapping nor fences.
+//
+
+#ifndef streamring_hpp
+#define streamring_hpp
+
+#include <stdio.h>
+#include <string.h>
+
+#include "glproc.hpp"
+
+
+// frames the GPU may be behind us, each with a region of its own:
+const int STREAM_RING_FRAMES = 3;
+
+// bytes in each region:
+const GLsizeiptr STREAM_RING_REGION = 4 << 20;
+
+// how long each wait for a region to come free lasts, in ns, before
+//    waiting again (and saying so):
+const GLuint64 STREAM_RING_TIMEOUT = 1000000000;
+
+
+enum StreamRingMode {
+    STREAM_PERSISTENT,
+    STREAM_MAP_RANGE,
+    STREAM_SUB_DATA
+};
+
+const char *STREAM_RING_MODE_NAMES[] = {
+    "persistent mapping",
+    "glMapBufferRange",
+    "glBufferSubData"
+};
+
+
+struct StreamRing
+{
+    bool    ready;
+    int     mode;                           // one of the StreamRingModes
+    GLuint  buffer;
+    char   *mapped;                         // the whole buffer, if STREAM_PERSISTENT
+    GLsizeiptr regionSize;
+    int     region;                         // the one this frame allocates from
+    GLsizeiptr used;                        // ... and how much of it is gone
+    GLsync  fences[STREAM_RING_FRAMES];     // set when each region was last used
+    long    bytes, waits, overflows;        // this frame: uploaded, regions not yet free, uploads that did not fit
+};
+
+
+bool initStreamRing(StreamRing &ring, GLsizeiptr regionSize) {
+    ring = StreamRing{};
+    if (GL.GenBuffers == NULL || GL.BufferSubData == NULL || !glVersionAtLeast(3, 1))
+        return false;
+
+    bool fences = GL.FenceSync != NULL && GL.ClientWaitSync != NULL && GL.DeleteSync != NULL;
+    if (glCapturing() || !fences)
+        ring.mode = STREAM_SUB_DATA;
+    else if (GL.BufferStorage != NULL && GL.MapBufferRange != NULL &&
+             (glVersionAtLeast(4, 4) || hasGLExtension("GL_ARB_buffer_storage")))
+        ring.mode = STREAM_PERSISTENT;
+    else if (GL.MapBufferRange != NULL && GL.UnmapBuffer != NULL)
+        ring.mode = STREAM_MAP_RANGE;
+    else
+        ring.mode = STREAM_SUB_DATA;
+
+    ring.regionSize = regionSize;
+    GLsizeiptr size = regionSize * STREAM_RING_FRAMES;
+    GL.GenBuffers(1, &ring.buffer);
+    GL.BindBuffer(GL_COPY_WRITE_BUFFER, ring.buffer);
+    if (ring.mode == STREAM_PERSISTENT) {
+        GLbitfield flags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+        GL.BufferStorage(GL_COPY_WRITE_BUFFER, size, NULL, flags);
+        ring.mapped = (char *)GL.MapBufferRange(GL_COPY_WRITE_BUFFER, 0, size, flags);
+        if (ring.mapped == NULL) {
+            // storage is immutable, so start over with a buffer we can map piecewise
+            GL.DeleteBuffers(1, &ring.buffer);
+            GL.GenBuffers(1, &ring.buffer);
+            GL.BindBuffer(GL_COPY_WRITE_BUFFER, ring.buffer);
+            ring.mode = GL.UnmapBuffer != NULL ? STREAM_MAP_RANGE : STREAM_SUB_DATA;
+        }
+    }
+    if (ring.mode != STREAM_PERSISTENT)
+        GL.BufferData(GL_COPY_WRITE_BUFFER, size, NULL, GL_STREAM_DRAW);
+    GL.BindBuffer(GL_COPY_WRITE_BUFFER, 0);
+
+    ring.region = STREAM_RING_FRAMES - 1;   // so the first frame gets region 0
+    ring.ready = true;
+    fprintf(stderr, "Stream ring: %d x %ld KB through %s\n", STREAM_RING_FRAMES, (long)(regionSize >> 10),
+            STREAM_RING_MODE_NAMES[ring.mode]);
+    return true;
+}
+
+
+// move on to the next region, waiting (and counting it) if the GPU is not done
+//    with it; however long that takes, since the region is about to be written:
+void streamBeginFrame(StreamRing &ring) {
+    ring.region = (ring.region + 1) % STREAM_RING_FRAMES;
+    ring.used = 0;
+    ring.bytes = ring.waits = ring.overflows = 0;
+    GLsync &fence = ring.fences[ring.region];
+    if (fence == NULL)
+        return;
+    if (GL.ClientWaitSync(fence, 0, 0) == GL_TIMEOUT_EXPIRED) {
+        ring.waits++;
+        while (GL.ClientWaitSync(fence, GL_SYNC_FLUSH_COMMANDS_BIT, STREAM_RING_TIMEOUT) == GL_TIMEOUT_EXPIRED)
+            fprintf(stderr, "Stream ring: still waiting for region %d\n", ring.region);
+    }
+    GL.DeleteSync(fence);
+    fence = NULL;
+}
+
+// after the last draw that reads this frame's region:
+void streamEndFrame(StreamRing &ring) {
+    if (ring.mode != STREAM_SUB_DATA)
+        ring.fences[ring.region] = GL.FenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+}
+
+
+// copy size bytes in at a multiple of align; returns where in the buffer
+//    they went, or -1 if this frame's region is full
+
+GLintptr streamUpload(StreamRing &ring, void const *data, GLsizeiptr size, GLsizeiptr align) {
+    GLintptr offset = (ring.used + align - 1) / align * align;
+    if (offset + size > ring.regionSize) {
+        ring.overflows++;
+        return -1;
+    }
+    ring.used = offset + size;
+    ring.bytes += size;
+    offset += ring.region * ring.regionSize;
+    if (size == 0)
+        return offset;
+
+    switch (ring.mode) {
+        case STREAM_PERSISTENT:
+            memcpy(ring.mapped + offset, data, size);
+            break;
+
+        case STREAM_MAP_RANGE: {
+            GL.BindBuffer(GL_COPY_WRITE_BUFFER, ring.buffer);
+            void *p = GL.MapBufferRange(GL_COPY_WRITE_BUFFER, offset, size,
+                                        GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_RANGE_BIT | GL_MAP_UNSYNCHRONIZED_BIT);
+            if (p == NULL) {
+                // the driver would not map it: the region is still ours, so copy it the slow way
+                GL.BufferSubData(GL_COPY_WRITE_BUFFER, offset, size, data);
+                break;
+            }
+            memcpy(p, data, size);
+            GL.UnmapBuffer(GL_COPY_WRITE_BUFFER);
+            break;
+        }
+
+        default:
+            GL.BindBuffer(GL_COPY_WRITE_BUFFER, ring.buffer);
+            GL.BufferSubData(GL_COPY_WRITE_BUFFER, offset, size, data);
+    }
+    return offset;
+}
+
+
+#endif /* streamring_hpp */
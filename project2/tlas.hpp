@@ -0,0 +1,249 @@
+//
+//  tlas.hpp
+//  project2
+//
+//  Top-level tree over the fleet: one box per aircraft instance, each
+//    pointing at the shared aircraft BVH.  Every frame the instance boxes
+//    are recomputed from the moved transforms (in parallel) and the nodes
+//    are refit bottom-up; when refitting has let the tree get much worse
+//    than it was when built (by its surface-area cost) it is rebuilt.
+//
+
+#ifndef tlas_hpp
+#define tlas_hpp
+
+#include <stdio.h>
+
+#include <algorithm>
+#include <chrono>
+#include <vector>
+
+#include "asynclog.hpp"
+#include "bvh.hpp"
+#include "fleet.hpp"
+#include "jobs.hpp"
+
+
+// rebuild when the refit tree's cost grows past this many times its cost when built:
+const float TLAS_REBUILD_RATIO = 1.5f;
+
+// fewest instances per job when recomputing the instance boxes:
+const int TLAS_PARALLEL_GRAIN = 256;
+
+
+struct TLAS
+{
+    BVH     bvh;                // BVH_BOX primitives, id = instance
+    float   builtCost;          // tlasCost() right after the last build
+    int     rebuilds;           // builds after the first
+    double  buildMs;            // last build
+    double  refitMs;            // last refit (including the instance boxes)
+};
+
+
+// world box of a model-space box under a column-major affine transform (Arvo):
+
+static BVHBounds tlasTransformBounds(BVHBounds const &b, float const m[16]) {
+    BVHBounds w;
+    for (int i = 0; i < 3; i++) {
+        w.lo[i] = w.hi[i] = m[12 + i];
+        for (int j = 0; j < 3; j++) {
+            float e = m[4*j + i] * b.lo[j], f = m[4*j + i] * b.hi[j];
+            w.lo[i] += std::min(e, f);
+            w.hi[i] += std::max(e, f);
+        }
+    }
+    return w;
+}
+
+
+// surface-area cost relative to the root: every inner child costs its area,
+//    every leaf its area times its primitive count
+
+float tlasCost(BVH const &bvh) {
+    float root = bvh.bounds.area();
+    if (bvh.nodes.empty() || root <= 0.f)
+        return 0.f;
+    float cost = 0.f;
+    for (BVH4Node const &n : bvh.nodes) {
+        for (int i = 0; i < 4; i++) {
+            if (n.child[i] == BVH_EMPTY)
+                continue;
+            BVHBounds b = { { n.minX[i], n.minY[i], n.minZ[i] }, { n.maxX[i], n.maxY[i], n.maxZ[i] } };
+            cost += b.area() * (n.child[i] >= 0 ? 1 : n.count[i]);
+        }
+    }
+    return cost / root;
+}
+
+
+void buildTLAS(TLAS &tlas, Fleet const &fleet, BVH const &blas) {
+    auto start = std::chrono::steady_clock::now();
+
+    int n = (int)fleet.instances.size();
+    std::vector<BVHPrimitive> prims(n);
+    parallelFor(0, n, TLAS_PARALLEL_GRAIN, [&](int first, int last) {
+        for (int i = first; i < last; i++) {
+            BVHBounds w = tlasTransformBounds(blas.bounds, fleet.instances[i].m);
+            prims[i].type = BVH_BOX;
+            prims[i].id = i;
+            std::copy(w.lo, w.lo + 3, prims[i].a);
+            std::copy(w.hi, w.hi + 3, prims[i].b);
+        }
+    });
+    if (!tlas.bvh.nodes.empty())
+        tlas.rebuilds++;
+    tlas.bvh = buildBVH(prims);
+    tlas.builtCost = tlasCost(tlas.bvh);
+
+    auto stop = std::chrono::steady_clock::now();
+    tlas.buildMs = std::chrono::duration<double, std::milli>(stop - start).count();
+}
+
+
+// move the instance boxes to where the fleet is now and refit the nodes;
+//    returns true if the tree had degraded enough that it was rebuilt instead
+
+bool refitTLAS(TLAS &tlas, Fleet const &fleet, BVH const &blas) {
+    if (tlas.bvh.prims.size() != fleet.instances.size()) {
+        buildTLAS(tlas, fleet, blas);
+        return true;
+    }
+
+    auto start = std::chrono::steady_clock::now();
+
+    std::vector<BVHPrimitive> &prims = tlas.bvh.prims;
+    parallelFor(0, (int)prims.size(), TLAS_PARALLEL_GRAIN, [&](int first, int last) {
+        for (int p = first; p < last; p++) {
+            BVHBounds w = tlasTransformBounds(blas.bounds, fleet.instances[prims[p].id].m);
+            std::copy(w.lo, w.lo + 3, prims[p].a);
+            std::copy(w.hi, w.hi + 3, prims[p].b);
+        }
+    });
+
+    // children always come after their parent, so walking backwards refits bottom-up:
+    std::vector<BVH4Node> &nodes = tlas.bvh.nodes;
+    for (int index = (int)nodes.size() - 1; index >= 0; index--) {
+        BVH4Node &n = nodes[index];
+        for (int i = 0; i < 4; i++) {
+            if (n.child[i] == BVH_EMPTY)
+                continue;
+            BVHBounds b;
+            b.reset();
+            if (n.child[i] >= 0) {
+                BVH4Node const &c = nodes[n.child[i]];
+                for (int j = 0; j < 4; j++) {
+                    if (c.child[j] == BVH_EMPTY)
+                        continue;
+                    b.grow(BVHBounds{ { c.minX[j], c.minY[j], c.minZ[j] }, { c.maxX[j], c.maxY[j], c.maxZ[j] } });
+                }
+            } else {
+                int first = -n.child[i] - 1;
+                for (int p = first; p < first + n.count[i]; p++) {
+                    b.grow(prims[p].a);
+                    b.grow(prims[p].b);
+                }
+            }
+            n.minX[i] = b.lo[0]; n.minY[i] = b.lo[1]; n.minZ[i] = b.lo[2];
+            n.maxX[i] = b.hi[0]; n.maxY[i] = b.hi[1]; n.maxZ[i] = b.hi[2];
+        }
+    }
+    BVH4Node const &root = nodes[0];
+    tlas.bvh.bounds.reset();
+    for (int i = 0; i < 4; i++) {
+        if (root.child[i] != BVH_EMPTY)
+            tlas.bvh.bounds.grow(BVHBounds{ { root.minX[i], root.minY[i], root.minZ[i] },
+                                            { root.maxX[i], root.maxY[i], root.maxZ[i] } });
+    }
+
+    auto stop = std::chrono::steady_clock::now();
+    tlas.refitMs = std::chrono::duration<double, std::milli>(stop - start).count();
+
+    if (tlasCost(tlas.bvh) > TLAS_REBUILD_RATIO * tlas.builtCost) {
+        buildTLAS(tlas, fleet, blas);
+        return true;
+    }
+    return false;
+}
+
+
+// nearest hit on any instance: the ray goes into each instance's model space
+//    (the transforms are affine, so t means the same thing there); *instance
+//    gets which one was hit, -1 if none
+
+BVHHit intersectTLAS(TLAS const &tlas, Fleet const &fleet, BVH const &blas,
+                     float const origin[3], float const dir[3], int *instance) {
+    BVHHit hit = { FLT_MAX, -1, -1 };
+    *instance = -1;
+    traverseBVH(tlas.bvh, origin, dir, hit, [&](BVHPrimitive const &prim, BVHHit &h) {
+        float const *inv = fleet.instances[prim.id].inv;
+        float o[3], d[3];
+        for (int k = 0; k < 3; k++) {
+            o[k] = inv[k]*origin[0] + inv[4 + k]*origin[1] + inv[8 + k]*origin[2] + inv[12 + k];
+            d[k] = inv[k]*dir[0]    + inv[4 + k]*dir[1]    + inv[8 + k]*dir[2];
+        }
+        BVHHit local = intersectBVH(blas, o, d);
+        if (local.id >= 0 && local.t < h.t) {
+            h = local;
+            *instance = prim.id;
+        }
+    });
+    return hit;
+}
+
+
+void reportTLAS(TLAS const &tlas) {
+    logPrint("TLAS: %zu instances, %zu nodes, cost %.2f (%.2f when built), "
+             "build %.3f ms, refit %.3f ms, %d rebuilds\n",
+             tlas.bvh.prims.size(), tlas.bvh.nodes.size(), tlasCost(tlas.bvh), tlas.builtCost,
+             tlas.buildMs, tlas.refitMs, tlas.rebuilds);
+}
+
+
+// build, refit and ray-query timings for fleets of growing size:
+
+void benchmarkTLAS(BVH const &blas) {
+    const int sizes[] = { 16, 256, 1024, 4096 };
+    const int ticks = 100, rays = 1000;
+
+    fprintf(stderr, "%-24s %10s %10s %10s %10s\n", "fleet size", "build ms", "refit ms", "rebuilds", "ray ns");
+    for (int n : sizes) {
+        Fleet fleet;
+        TLAS tlas = {};
+        resizeFleet(fleet, n);
+        updateFleet(fleet, 0.f);
+        buildTLAS(tlas, fleet, blas);
+        double buildMs = tlas.buildMs;
+
+        double refitMs = 0.;
+        for (int t = 1; t <= ticks; t++) {
+            updateFleet(fleet, t / 30.f);
+            refitTLAS(tlas, fleet, blas);
+            refitMs += tlas.refitMs;
+        }
+
+        // straight down onto random spots over the fleet:
+        BVHBounds const &b = tlas.bvh.bounds;
+        unsigned seed = 1;
+        auto start = std::chrono::steady_clock::now();
+        for (int r = 0; r < rays; r++) {
+            seed = seed * 1664525u + 1013904223u;
+            float u = (seed >> 8) / 16777216.f;
+            seed = seed * 1664525u + 1013904223u;
+            float v = (seed >> 8) / 16777216.f;
+            float origin[3] = { b.lo[0] + u*(b.hi[0] - b.lo[0]), b.hi[1] + 1.f, b.lo[2] + v*(b.hi[2] - b.lo[2]) };
+            float dir[3] = { 0.f, -1.f, 0.f };
+            int instance;
+            intersectTLAS(tlas, fleet, blas, origin, dir, &instance);
+        }
+        auto stop = std::chrono::steady_clock::now();
+        double rayNs = std::chrono::duration<double, std::nano>(stop - start).count() / rays;
+
+        char name[32];
+        snprintf(name, sizeof(name), "%d", n);
+        fprintf(stderr, "%-24s %10.3f %10.3f %10d %10.0f\n", name, buildMs, refitMs / ticks, tlas.rebuilds, rayNs);
+    }
+}
+
+
+#endif /* tlas_hpp */